@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto_wallet {
+
+// CRC32C (Castagnoli). Pass a previous result as crc to continue it over
+// more data, or 0 to start; uses SSE4.2 when the CPU has it.
+uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t size);
+
+} // namespace crypto_wallet
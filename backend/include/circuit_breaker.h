@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto_wallet {
+
+struct CircuitBreakerOptions {
+    size_t window = 20;                // Most recent calls considered
+    size_t min_calls = 10;             // Before the rates mean anything
+    double failure_threshold = 0.5;    // Failed share of the window that opens it
+    double slow_threshold = 0.8;       // Slow share of the window that opens it
+    std::chrono::milliseconds slow_call{4000};
+    std::chrono::milliseconds open_for{10000};  // Before a probe is let through
+};
+
+enum class BreakerState { Closed, Open, HalfOpen };
+
+// Failure- and latency-based circuit breaker for one upstream. Closed, it
+// lets calls through and watches the last `window` outcomes; when too many
+// failed or were slow it opens and rejects calls outright. After open_for
+// one probe call is admitted: if it succeeds quickly the breaker closes,
+// otherwise it opens again. Not synchronized; callers hold their own lock.
+class CircuitBreaker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit CircuitBreaker(const CircuitBreakerOptions& options = CircuitBreakerOptions());
+
+    // Whether a call may go ahead now. probe is set when it is the one
+    // half-open trial, which must end in record() or abandon().
+    bool try_acquire(Clock::time_point now, bool& probe);
+
+    void record(bool failed, std::chrono::milliseconds latency, Clock::time_point now);
+
+    // A probe that ended without an outcome, e.g. it was cancelled
+    void abandon();
+
+    BreakerState state(Clock::time_point now) const;
+
+private:
+    CircuitBreakerOptions options_;
+    BreakerState state_;
+    Clock::time_point opened_at_;
+    bool probe_in_flight_;
+
+    // Ring of recent outcomes
+    std::vector<uint8_t> outcomes_;
+    size_t next_;
+    size_t count_;
+    size_t failures_;
+    size_t slow_;
+
+    void open(Clock::time_point now);
+    void reset_window();
+};
+
+} // namespace crypto_wallet
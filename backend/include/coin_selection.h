@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "error.h"
+
+namespace crypto_wallet {
+
+// A spendable output as coin selection sees it. Amounts are satoshis.
+struct CoinCandidate {
+    uint64_t value;
+    uint64_t fee;            // Spending it at the current fee rate
+    uint64_t long_term_fee;  // Spending it later at the long-term rate
+
+    int64_t effective_value() const { return static_cast<int64_t>(value) - static_cast<int64_t>(fee); }
+};
+
+struct CoinSelectionParams {
+    uint64_t target;          // Payouts plus the fee of everything but the inputs
+    uint64_t change_fee;      // Adding a change output now
+    uint64_t cost_of_change;  // change_fee plus spending the change later
+    uint64_t min_change;      // Smallest change output worth creating
+    size_t max_tries = 100000;
+    size_t knapsack_iterations = 1000;
+};
+
+enum class SelectionAlgorithm { BranchAndBound, Knapsack };
+
+struct CoinSelection {
+    std::vector<size_t> selected;  // Indexes into the candidates
+    uint64_t value;                // Sum of the selected values
+    uint64_t fee;                  // Sum of their input fees
+    SelectionAlgorithm algorithm;
+    bool change;                   // Leaves enough over for a change output
+};
+
+// Branch and bound over effective values (value minus input fee), largest
+// first, for a subset landing in [target, target + cost_of_change], which
+// needs no change output. Among those found within max_tries the one with
+// least waste wins: the excess plus what the inputs cost now over what they
+// would cost at the long-term rate. False if none was found.
+bool select_coins_bnb(const std::vector<CoinCandidate>& coins, const CoinSelectionParams& params,
+                      CoinSelection& result);
+
+// Randomized knapsack: the smallest subset found reaching target plus
+// change_fee and min_change, or the single smallest coin that does if
+// that is closer. False if the coins cannot cover the target at all.
+bool select_coins_knapsack(const std::vector<CoinCandidate>& coins, const CoinSelectionParams& params,
+                           CoinSelection& result);
+
+// Branch and bound, then knapsack. Coins costing more to spend than they
+// are worth are never selected. Throws WalletError::insufficient_funds.
+CoinSelection select_coins(const std::vector<CoinCandidate>& coins, const CoinSelectionParams& params);
+
+} // namespace crypto_wallet
@@ -6,15 +6,108 @@
 #include <memory>
 #include "error.h"
 
+// OpenSSL digest context (EVP_MD_CTX)
+struct evp_md_ctx_st;
+
 namespace crypto_wallet {
 
+enum class SignatureScheme {
+    ECDSA,
+    SCHNORR
+};
+
+// One signature to check in a batch. Fixed-size fields keep a batch in a
+// single contiguous allocation.
+struct VerifyItem {
+    SignatureScheme scheme;
+    std::array<uint8_t, 32> hash;        // ECDSA digest or BIP340 message
+    std::array<uint8_t, 64> signature;   // Compact r || s
+    std::array<uint8_t, 33> public_key;  // Compressed key; Schnorr uses the first 32 bytes (x-only)
+};
+
+// Implementations behind Crypto::sha256_many
+enum class Sha256Kernel {
+    AUTO,    // Best one the CPU supports
+    SCALAR,  // One OpenSSL call per message
+    AVX2,    // Eight messages per pass
+    SHA_NI   // x86 SHA extensions
+};
+
+// Checksum variant of a bech32 string (BIP173 / BIP350)
+enum class Bech32Encoding {
+    BECH32,   // Witness version 0
+    BECH32M   // Witness versions 1 to 16 (Taproot is 1)
+};
+
+// Incremental SHA256. The EVP context is allocated once and reused across
+// init() calls, so hashing in a loop does not touch the heap.
+class Sha256Ctx {
+public:
+    Sha256Ctx();
+    ~Sha256Ctx();
+    
+    Sha256Ctx(const Sha256Ctx&) = delete;
+    Sha256Ctx& operator=(const Sha256Ctx&) = delete;
+    
+    void init();
+    void update(const uint8_t* data, size_t size);
+    void final(uint8_t* out);
+    std::array<uint8_t, 32> final();
+    
+private:
+    evp_md_ctx_st* ctx_;
+};
+
+// BIP32 extended private key
+struct ExtendedKey {
+    static constexpr uint32_t HARDENED = 0x80000000;
+    
+    std::array<uint8_t, 32> secret_key;
+    std::array<uint8_t, 32> chain_code;
+    std::array<uint8_t, 33> public_key;  // Compressed
+    uint8_t depth;
+    uint32_t parent_fingerprint;
+    uint32_t child_number;
+    
+    // Master node for a seed
+    static ExtendedKey from_seed(const uint8_t* seed, size_t size);
+    
+    // CKDpriv; indexes with the HARDENED bit set derive hardened children
+    ExtendedKey derive_child(uint32_t index) const;
+    
+    // Walk a path such as "m/44'/0'/0'/0" down from this node
+    ExtendedKey derive_path(const std::string& path) const;
+    
+    // First 4 bytes of HASH160(public_key), as stored in child nodes
+    uint32_t fingerprint() const;
+};
+
+// Bit i is set when item i verified
+struct BatchVerifyResult {
+    std::vector<uint64_t> bitmap;
+    size_t count;
+
+    bool valid(size_t i) const { return (bitmap[i / 64] >> (i % 64)) & 1; }
+    bool all_valid() const;
+};
+
 class Crypto {
 public:
-    // Generate a new mnemonic seed phrase
+    // Generate a new 12-word BIP39 mnemonic from 128 bits of entropy
     static std::string generate_mnemonic();
     
-    // Convert mnemonic to seed
-    static std::array<uint8_t, 64> mnemonic_to_seed(const std::string& mnemonic);
+    // BIP39 mnemonic for 16, 20, 24, 28 or 32 bytes of entropy
+    static std::string entropy_to_mnemonic(const uint8_t* entropy, size_t size);
+    
+    // True if every word is in the wordlist and the checksum matches
+    static bool validate_mnemonic(const std::string& mnemonic);
+    
+    // BIP39 seed: PBKDF2-HMAC-SHA512 over the mnemonic, 2048 iterations.
+    // Throws WalletError::invalid_seed_phrase for an invalid mnemonic.
+    static std::array<uint8_t, 64> mnemonic_to_seed(
+        const std::string& mnemonic,
+        const std::string& passphrase = ""
+    );
     
     // Derive key from seed using derivation path
     static std::array<uint8_t, 32> derive_key_from_seed(
@@ -22,52 +115,156 @@ public:
         const std::string& derivation_path
     );
     
+    // BIP32 node at `path` for `seed`. Recently used nodes are kept in a
+    // process-wide LRU cache, so addresses under one account or chain node
+    // cost a single child derivation each.
+    static ExtendedKey derive_node_cached(
+        const std::array<uint8_t, 64>& seed,
+        const std::string& path
+    );
+    
     // Convert public key to Bitcoin address
     static std::string public_key_to_address(
         const std::vector<uint8_t>& public_key_bytes, 
         const std::string& network
     );
     
+    // P2PKH addresses for many compressed keys; the SHA256 steps of HASH160
+    // and of the base58check checksum run through sha256_many
+    static std::vector<std::string> public_keys_to_addresses(
+        const std::array<uint8_t, 33>* public_keys,
+        size_t count,
+        const std::string& network
+    );
+    
     // Hash a message
     static std::array<uint8_t, 32> hash_message(const std::vector<uint8_t>& message);
     
-    // Generate a new keypair
+    // Generate a new keypair (secret key, 33-byte compressed public key)
     static std::pair<std::array<uint8_t, 32>, std::vector<uint8_t>> generate_keypair();
     
-    // Sign a message
+    // Derive the 33-byte compressed public key for a secret key
+    static std::vector<uint8_t> derive_public_key(const std::array<uint8_t, 32>& secret_key);
+    
+    // Sign SHA256(message) with ECDSA, returns a 64-byte compact low-S signature
     static std::vector<uint8_t> sign_message(
         const std::vector<uint8_t>& message, 
         const std::array<uint8_t, 32>& secret_key
     );
     
-    // Verify a signature
+    // Verify an ECDSA signature from sign_message
     static bool verify_signature(
         const std::vector<uint8_t>& message,
         const std::vector<uint8_t>& signature,
         const std::vector<uint8_t>& public_key
     );
     
+    // ECDSA over a precomputed 32-byte digest (RFC6979 nonces, low-S)
+    static std::array<uint8_t, 64> sign_hash(
+        const std::array<uint8_t, 32>& hash,
+        const std::array<uint8_t, 32>& secret_key
+    );
+    static bool verify_hash(
+        const std::array<uint8_t, 32>& hash,
+        const std::array<uint8_t, 64>& signature,
+        const std::vector<uint8_t>& public_key
+    );
+    
+    // BIP340 Schnorr signatures over a 32-byte message with x-only public keys
+    static std::array<uint8_t, 32> schnorr_public_key(const std::array<uint8_t, 32>& secret_key);
+    static std::array<uint8_t, 64> schnorr_sign(
+        const std::array<uint8_t, 32>& message,
+        const std::array<uint8_t, 32>& secret_key
+    );
+    static bool schnorr_verify(
+        const std::array<uint8_t, 32>& message,
+        const std::array<uint8_t, 64>& signature,
+        const std::array<uint8_t, 32>& public_key
+    );
+    
+    // Verify many signatures at once. Schnorr items are batch-verified where
+    // the backend supports it; everything runs across the shared thread pool.
+    static BatchVerifyResult verify_batch(const VerifyItem* items, size_t count);
+    static BatchVerifyResult verify_batch(const std::vector<VerifyItem>& items) {
+        return verify_batch(items.data(), items.size());
+    }
+    
     // Generate Bitcoin address with proper checksum
     static std::string public_key_to_bitcoin_address(
         const std::vector<uint8_t>& public_key,
         const std::string& network
     );
     
-    // Validate Bitcoin address
+    // Native SegWit (P2WPKH, bech32) address for a compressed public key
+    static std::string public_key_to_segwit_address(
+        const std::vector<uint8_t>& public_key,
+        const std::string& network
+    );
+    
+    // Validate a Bitcoin address: base58 P2PKH/P2SH or bech32/bech32m
+    // SegWit, chosen by prefix
     static bool is_valid_address(const std::string& address);
     
+    // Bech32 over 5-bit values. Decoding writes the lowercase HRP and the
+    // data part without its checksum; it returns false on any format or
+    // checksum error or if data is too small.
+    static constexpr size_t BECH32_MAX_LENGTH = 90;
+    static std::string bech32_encode(const std::string& hrp, const uint8_t* data, size_t size,
+                                     Bech32Encoding encoding);
+    static bool bech32_decode(const std::string& encoded, std::string& hrp, uint8_t* data,
+                              size_t data_size, size_t& written, Bech32Encoding& encoding);
+    
+    // SegWit addresses: HRP "bc" or "tb", witness version and program.
+    // Decoding enforces the BIP173/BIP350 version, length and checksum rules.
+    static std::string segwit_address_encode(const std::string& hrp, int witness_version,
+                                             const uint8_t* program, size_t size);
+    static bool segwit_address_decode(const std::string& address, const std::string& hrp,
+                                      int& witness_version, uint8_t* program,
+                                      size_t program_size, size_t& written);
+    
     // Base58 encoding/decoding
     static std::string base58_encode(const std::vector<uint8_t>& data);
     static std::vector<uint8_t> base58_decode(const std::string& encoded);
     
+    // Base58 on caller-provided buffers. Encoding returns the number of
+    // characters written and throws if out is too small; decoding returns
+    // false on an invalid character or if out is too small.
+    static constexpr size_t base58_max_encoded_size(size_t size) { return size * 138 / 100 + 1; }
+    static size_t base58_encode(const uint8_t* data, size_t size, char* out, size_t out_size);
+    static bool base58_decode(const char* encoded, size_t length,
+                              uint8_t* out, size_t out_size, size_t& written);
+    
+    // Base58Check: payload followed by the first 4 bytes of its double SHA256.
+    // Decoding verifies the checksum and writes only the payload.
+    static std::string base58check_encode(const uint8_t* payload, size_t size);
+    static bool base58check_decode(const std::string& encoded, uint8_t* payload,
+                                   size_t payload_size, size_t& written);
+    
     // SHA256 hashing
     static std::array<uint8_t, 32> sha256(const std::vector<uint8_t>& data);
+    static std::array<uint8_t, 32> sha256(const uint8_t* data, size_t size);
     
     // RIPEMD160 hashing
     static std::array<uint8_t, 20> ripemd160(const std::vector<uint8_t>& data);
+    static std::array<uint8_t, 20> ripemd160(const uint8_t* data, size_t size);
     
     // Double SHA256 (used for Bitcoin checksums)
     static std::array<uint8_t, 32> double_sha256(const std::vector<uint8_t>& data);
+    static std::array<uint8_t, 32> double_sha256(const uint8_t* data, size_t size);
+    
+    // SHA256 of many independent messages, digest i going to out[i]. AUTO
+    // hashes single-block messages (up to 55 bytes) with SHA extensions or
+    // AVX2 and two-block ones with SHA extensions only; longer messages, and
+    // two-block ones on AVX2-only CPUs, take the scalar path, where the SIMD
+    // kernels don't beat OpenSSL.
+    static void sha256_many(const uint8_t* const* data, const size_t* sizes, size_t count,
+                            std::array<uint8_t, 32>* out, Sha256Kernel kernel = Sha256Kernel::AUTO);
+    static std::vector<std::array<uint8_t, 32>> sha256_many(const std::vector<std::vector<uint8_t>>& messages);
+    static bool sha256_kernel_supported(Sha256Kernel kernel);
+    static Sha256Kernel sha256_best_kernel();
+    
+    // RIPEMD160(SHA256(data)), the public key hash inside P2PKH addresses
+    static std::array<uint8_t, 20> hash160(const uint8_t* data, size_t size);
 };
 
 } // namespace crypto_wallet
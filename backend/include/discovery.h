@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "wallet.h"
+#include "network.h"
+
+namespace crypto_wallet {
+
+struct DiscoveryOptions {
+    uint32_t gap_limit = 20;   // Consecutive unused addresses that end a chain
+    uint32_t batch_size = 20;  // Addresses derived and looked up per round
+    size_t concurrency = 8;    // Lookups in flight per chain
+    uint32_t max_addresses = 10000;  // Per chain, in case an upstream reports nearly everything used
+};
+
+struct ChainDiscovery {
+    std::vector<std::string> addresses;  // Index 0 through the last used one
+    uint32_t used_count = 0;
+    uint32_t scanned = 0;
+    double balance = 0.0;
+    bool truncated = false;  // Reached max_addresses before a gap
+};
+
+struct DiscoveryResult {
+    ChainDiscovery receive;
+    ChainDiscovery change;
+};
+
+// BIP44 account discovery. Each chain is derived in batches on the shared
+// thread pool and each batch is looked up concurrently; a chain ends after
+// gap_limit unused addresses in a row, or at max_addresses. The receive and
+// change chains are scanned at the same time.
+class AddressDiscovery {
+public:
+    AddressDiscovery(const Wallet& wallet, const NetworkClient& client,
+                     DiscoveryOptions options = DiscoveryOptions());
+
+    DiscoveryResult run() const;
+
+    // Look up many addresses with up to `concurrency` requests in flight.
+    // Throws the first lookup error, since a missed address could end a
+    // chain early.
+    static std::vector<AddressStats> lookup(const NetworkClient& client,
+                                            const std::vector<std::string>& addresses,
+                                            size_t concurrency);
+
+private:
+    const Wallet& wallet_;
+    const NetworkClient& client_;
+    DiscoveryOptions options_;
+
+    ChainDiscovery scan_chain(bool change) const;
+};
+
+} // namespace crypto_wallet
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto_wallet {
+
+// Replace path with data so that after a crash it holds either the old or
+// the new contents: write a temp file beside it, fsync, rename over the
+// target, fsync the directory. Throws WalletError::storage.
+void atomic_write_file(const std::filesystem::path& path, const uint8_t* data, size_t size);
+
+// Group-commit writer. Work queued from any thread within one window is
+// done together on a background thread: replacements are written and
+// fsynced, renamed, and each directory involved is fsynced once; queued
+// syncs run once per path however often they were requested.
+class DurableWriter {
+public:
+    struct Stats {
+        uint64_t batches;
+        uint64_t replaces;           // Calls to replace()
+        uint64_t files_written;      // After coalescing
+        uint64_t syncs_requested;    // Calls to schedule_sync()
+        uint64_t syncs_run;          // After coalescing
+        uint64_t directory_syncs;
+    };
+
+    explicit DurableWriter(std::chrono::milliseconds window = std::chrono::milliseconds(5));
+    ~DurableWriter();
+
+    DurableWriter(const DurableWriter&) = delete;
+    DurableWriter& operator=(const DurableWriter&) = delete;
+
+    // Process-wide writer; drains on exit
+    static DurableWriter& shared();
+
+    // Atomically replace path and block until it is durable. A newer
+    // replace of the same path supersedes a queued one; both callers
+    // return once the newer contents are on disk. If rename_lock is given,
+    // the writer thread holds it just around the rename, so code changing
+    // the file in place under the same mutex never straddles the swap.
+    // Throws WalletError::storage if the write failed.
+    void replace(const std::filesystem::path& path, std::vector<uint8_t> contents,
+                 std::mutex* rename_lock = nullptr);
+
+    // Queue an in-place sync of path and return immediately. `sync` runs
+    // on the writer thread in the next batch; requests for a path already
+    // queued are merged into one.
+    void schedule_sync(const std::filesystem::path& path, std::function<void()> sync);
+
+    // Block until everything queued before the call has been done
+    void flush();
+
+    Stats stats() const;
+
+private:
+    struct Ticket;
+    struct PendingReplace {
+        std::vector<uint8_t> contents;
+        std::shared_ptr<Ticket> ticket;
+        std::mutex* rename_lock = nullptr;
+    };
+
+    std::chrono::milliseconds window_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable batch_done_;
+    std::unordered_map<std::string, PendingReplace> replaces_;
+    std::unordered_map<std::string, std::function<void()>> syncs_;
+    uint64_t queued_batch_;     // Batch that currently queued work will go into
+    uint64_t completed_batch_;
+    bool flush_requested_;
+    bool stopping_;
+    Stats stats_;
+    std::thread worker_;
+
+    void worker_loop();
+    void run_batch(std::unordered_map<std::string, PendingReplace>& replaces,
+                   std::unordered_map<std::string, std::function<void()>>& syncs);
+};
+
+} // namespace crypto_wallet
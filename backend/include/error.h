@@ -15,7 +15,10 @@ enum class ErrorType {
     WalletNotFound,
     Io,
     Serialization,
-    Http
+    Http,
+    WalletLocked,
+    InvalidPassword,
+    InvalidAmount
 };
 
 class WalletError : public std::runtime_error {
@@ -65,6 +68,18 @@ public:
         return WalletError("HTTP error: " + message, ErrorType::Http);
     }
 
+    static WalletError wallet_locked(const std::string& name) {
+        return WalletError("Wallet is locked: " + name, ErrorType::WalletLocked);
+    }
+
+    static WalletError invalid_password() {
+        return WalletError("Invalid password", ErrorType::InvalidPassword);
+    }
+
+    static WalletError invalid_amount(const std::string& message) {
+        return WalletError("Invalid amount: " + message, ErrorType::InvalidAmount);
+    }
+
 private:
     ErrorType type_;
 };
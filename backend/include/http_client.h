@@ -0,0 +1,190 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <deque>
+#include <list>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <curl/curl.h>
+#include "error.h"
+#include "circuit_breaker.h"
+
+namespace crypto_wallet {
+
+struct HttpClientOptions {
+    size_t max_host_connections = 6;  // Requests in flight per host
+    size_t max_idle_connections = 64; // Kept open across all hosts
+    long timeout_seconds = 30;
+    long connect_timeout_seconds = 10;
+    bool http2 = true;                // Negotiated over TLS when the server offers it
+
+    // For URLs under registered mirrors (see add_mirrors)
+    long deadline_ms = 10000;         // Whole request, across all attempts
+    size_t max_attempts = 3;          // First try, hedge and failovers together
+    bool hedge = true;
+    double hedge_percentile = 0.95;   // Of the mirror's recent latencies
+    long hedge_min_ms = 50;
+    long hedge_initial_ms = 1000;     // Until enough latencies are known
+    double hedge_budget = 0.1;        // Hedges allowed per request started
+    CircuitBreakerOptions breaker;
+};
+
+struct HttpClientStats {
+    uint64_t requests;
+    uint64_t connections_opened;  // Requests that could not reuse a connection
+    uint64_t handles_created;
+    size_t idle_handles;
+    uint64_t hedges;              // Duplicate attempts started
+    uint64_t hedge_wins;          // Requests answered by the duplicate
+    uint64_t failovers;           // Attempts retried after an upstream failure
+    uint64_t rejected;            // Failed fast with every breaker open
+};
+
+struct UpstreamStats {
+    std::string base_url;
+    BreakerState state;
+    double p95_ms;
+    uint64_t attempts;
+    uint64_t failures;
+};
+
+// Called once per URL of a batch with the body, or with a non-empty error
+using HttpBatchHandler = std::function<void(size_t index, std::string&& body, const std::string& error)>;
+
+// Called with each piece of a response body as it arrives. An exception
+// thrown here aborts the transfer and is reported as its error.
+using HttpStreamHandler = std::function<void(const char* data, size_t size)>;
+using HttpChunkHandler = std::function<void(size_t index, const char* data, size_t size)>;
+
+// Process-wide HTTP client. Easy handles are pooled and reset between
+// requests instead of being created per call, and all handles share one
+// CURLSH holding the DNS cache, TLS sessions and connection cache, so a
+// request to a host already talked to skips resolution and both handshakes.
+// Requests per host are capped; callers over the cap wait for a slot.
+//
+// Batches run on a single event-loop thread driving a curl multi handle,
+// which multiplexes them over HTTP/2 where the server allows. The multi
+// handle keeps its own caches, so its connections stay warm between
+// batches as well.
+//
+// GETs under registered mirrors also run on the loop, so a slow upstream
+// cannot hold a caller past deadline_ms. Each mirror has a circuit breaker;
+// an attempt goes to the first mirror whose breaker admits it, a request
+// still unanswered after that mirror's p95 latency gets one duplicate
+// attempt, and an upstream failure is retried on the next mirror. With
+// every breaker open a request fails at once.
+class HttpClient {
+public:
+    explicit HttpClient(const HttpClientOptions& options = HttpClientOptions());
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    static HttpClient& shared();
+
+    // Response body; throws WalletError::http on transport errors
+    std::string get(const std::string& url);
+    std::string post(const std::string& url, const std::string& data);
+
+    // Hand the body to on_data as it arrives instead of collecting it
+    void get(const std::string& url, const HttpStreamHandler& on_data);
+
+    // GET every URL through the event loop, keeping at most `concurrency`
+    // of them in flight, and call handler on the loop thread as each one
+    // completes. Blocks until all have completed and rethrows the first
+    // exception the handler threw, after which no further URLs are started.
+    // The handler must not start another batch.
+    void get_many(const std::vector<std::string>& urls, size_t concurrency, const HttpBatchHandler& handler);
+
+    // As above, but bodies go to on_data as they arrive, also on the loop
+    // thread, and handler gets an empty body. Chunks of different URLs
+    // interleave.
+    void get_many(const std::vector<std::string>& urls, size_t concurrency, const HttpChunkHandler& on_data,
+                  const HttpBatchHandler& handler);
+
+    // Base URLs serving the same API, preferred first. Registering a group
+    // whose first URL is already known does nothing.
+    void add_mirrors(const std::vector<std::string>& base_urls);
+
+    HttpClientStats stats() const;
+    std::vector<UpstreamStats> upstream_stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Batch;
+    struct Request;
+    struct Transfer;
+    struct StreamTarget;
+    struct Mirror;
+
+    HttpClientOptions options_;
+    CURLSH* share_;
+    std::mutex share_locks_[CURL_LOCK_DATA_LAST];
+
+    mutable std::mutex pool_mutex_;
+    std::vector<CURL*> idle_;
+
+    std::mutex hosts_mutex_;
+    std::condition_variable host_available_;
+    std::map<std::string, size_t> in_flight_;
+
+    CURLM* multi_;
+    std::once_flag loop_started_;
+    std::thread loop_;
+    std::mutex loop_mutex_;
+    std::deque<Batch*> submitted_;
+    bool stopping_;
+
+    mutable std::mutex mirrors_mutex_;
+    std::deque<Mirror> mirrors_;                // Stable addresses
+    std::vector<std::vector<Mirror*>> groups_;
+
+    std::atomic<uint64_t> requests_;
+    std::atomic<uint64_t> connections_opened_;
+    std::atomic<uint64_t> handles_created_;
+    std::atomic<uint64_t> started_;
+    std::atomic<uint64_t> hedges_;
+    std::atomic<uint64_t> hedge_wins_;
+    std::atomic<uint64_t> failovers_;
+    std::atomic<uint64_t> rejected_;
+
+    static void lock_share(CURL* handle, curl_lock_data data, curl_lock_access access, void* client);
+    static void unlock_share(CURL* handle, curl_lock_data data, void* client);
+    static size_t write_stream(void* contents, size_t size, size_t nmemb, void* target);
+
+    CURL* acquire_handle();
+    void release_handle(CURL* handle);
+
+    void acquire_host(const std::string& host);
+    void release_host(const std::string& host);
+
+    // Writes go to body, or to stream when one is given
+    void configure(CURL* handle, const std::string& url, const std::string* post_data, std::string* body,
+                   StreamTarget* stream = nullptr);
+    void count_request(CURL* handle);
+    std::string perform(const std::string& url, const std::string* post_data, StreamTarget* stream = nullptr);
+    void run_batch(Batch& batch);
+    bool mirrored(const std::string& url) const;
+
+    // Loop thread only
+    void event_loop();
+    void start_requests(Batch& batch);
+    bool launch(Request& request, bool hedge);
+    Clock::time_point check_hedges(Batch& batch, Clock::time_point now);
+    void finish_transfer(Transfer* transfer, CURLcode result);
+    void cancel(Transfer* transfer);
+    void complete(Request& request, std::string&& body, const std::string& error);
+};
+
+} // namespace crypto_wallet
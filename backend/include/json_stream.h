@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "error.h"
+
+namespace crypto_wallet {
+
+enum class JsonType { String, Number, Bool, Null };
+
+// Events from a JsonStreamParser. Depth counts containers from the root,
+// which is at depth 1, so the elements of a top-level array are at depth 2.
+// key is the member name a value or container sits under, empty inside
+// arrays. Scalars arrive as text: strings unescaped, numbers as written,
+// bools as "true" or "false".
+class JsonStreamHandler {
+public:
+    virtual ~JsonStreamHandler() = default;
+
+    virtual void begin(size_t /*depth*/, const std::string& /*key*/, bool /*array*/) {}
+    virtual void end(size_t /*depth*/, bool /*array*/) {}
+    virtual void scalar(size_t /*depth*/, const std::string& /*key*/, JsonType /*type*/,
+                        const std::string& /*text*/) {}
+};
+
+// Push parser: feed() takes the document in chunks of any size, as they
+// come off the wire, and reports each value as soon as it is complete.
+// Nothing is kept beyond the open containers and the token being read, so
+// memory stays bounded by the largest single string rather than the whole
+// document. Throws WalletError::serialization on malformed input.
+class JsonStreamParser {
+public:
+    static constexpr size_t MAX_DEPTH = 256;
+    static constexpr size_t MAX_TOKEN_SIZE = 16 * 1024 * 1024;
+
+    explicit JsonStreamParser(JsonStreamHandler& handler);
+
+    void feed(const char* data, size_t size);
+    void feed(const std::string& data) { feed(data.data(), data.size()); }
+
+    // End of input; throws unless exactly one complete value was read
+    void finish();
+
+private:
+    enum class Lex { None, String, Escape, Unicode, Number, Literal };
+    enum class Expect { Value, ValueOrEnd, Key, KeyOrEnd, Colon, CommaOrEnd, Done };
+
+    struct Frame {
+        bool array;
+        std::string key;  // Current member name in an object
+    };
+
+    JsonStreamHandler& handler_;
+    std::vector<Frame> stack_;
+    Expect expect_;
+    Lex lex_;
+    bool token_is_key_;
+    std::string token_;
+    uint32_t unicode_;         // \u escape being read
+    int unicode_digits_;
+    uint32_t high_surrogate_;  // Waiting for its pair
+    uint64_t offset_;          // Bytes consumed, for error messages
+
+    [[noreturn]] void fail(const std::string& reason) const;
+
+    const std::string& current_key() const;
+    void start_value();
+    void after_value();
+    void open(bool array);
+    void close(bool array);
+    void string_char(char c);
+    void escape_char(char c);
+    void unicode_char(char c);
+    void append_code_point(uint32_t code_point);
+    void flush_surrogate();
+    void finish_string();
+    void finish_number();
+    void finish_literal();
+};
+
+} // namespace crypto_wallet
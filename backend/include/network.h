@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <cstdint>
+#include <cstddef>
 #include "error.h"
 
 namespace crypto_wallet {
@@ -20,24 +22,112 @@ struct Transaction {
         : hash(h), from(f), to(t), amount(a), timestamp(ts) {}
 };
 
+// On-chain activity of one address, confirmed plus mempool
+struct AddressStats {
+    uint64_t tx_count;
+    double balance;  // BTC
+    uint64_t mempool_tx_count;
+    int64_t confirmed_satoshis;  // Funded minus spent, chain only
+    
+    bool used() const { return tx_count > 0; }
+    uint64_t confirmed_tx_count() const { return tx_count - mempool_tx_count; }
+};
+
+struct TxInput {
+    std::string prev_txid;
+    uint32_t prev_vout;
+    std::string prev_address;  // Empty for coinbase and non-standard scripts
+    uint64_t prev_value;       // Satoshis
+};
+
+struct TxOutput {
+    std::string address;  // Empty for non-standard scripts
+    uint64_t value;       // Satoshis
+};
+
+// A transaction as Esplora reports it, with the inputs' previous outputs
+struct ChainTransaction {
+    std::string txid;
+    bool confirmed;
+    uint32_t block_height;
+    int64_t block_time;
+    std::vector<TxInput> inputs;
+    std::vector<TxOutput> outputs;
+};
+
+// One page of an address's transactions from a batch lookup
+struct TransactionPage {
+    std::vector<ChainTransaction> transactions;
+    std::string error;
+    
+    bool ok() const { return error.empty(); }
+};
+
+// Balance of one address from a batch lookup; error is set if it failed
+struct AddressBalance {
+    double balance;  // BTC
+    std::string error;
+    
+    bool ok() const { return error.empty(); }
+};
+
 class NetworkClient {
 public:
-    // Create network client for specific network
+    // Requests a batch keeps in flight unless told otherwise
+    static constexpr size_t DEFAULT_BATCH_CONCURRENCY = 32;
+    
+    // Environment variable that replaces the Esplora base URLs of every
+    // network: a comma-separated list of mirrors, preferred first
+    static constexpr const char* BASE_URL_ENV = "CRYPTO_WALLET_ESPLORA_URL";
+    
+    // Lowest fee rate nodes relay, in sat/vB
+    static constexpr double MIN_FEE_RATE = 1.0;
+    
+    // Where the "mock" network expects tools/mock_esplora
+    static constexpr const char* MOCK_BASE_URL = "http://127.0.0.1:3002";
+    
+    // Create network client for "mainnet", "testnet" or "mock"
     static std::unique_ptr<NetworkClient> create(const std::string& network);
     
     // Get balance for address
     double get_balance(const std::string& address) const;
     
-    // Send transaction
-    std::string send_transaction(
-        const std::string& from_address,
-        const std::string& to_address,
-        double amount
-    ) const;
+    // Broadcast a signed transaction given as hex; returns its txid
+    std::string send_transaction(const std::string& raw_hex) const;
+    
+    // Fee rate in sat/vB to confirm within about confirmation_target blocks
+    double estimate_fee_rate(uint32_t confirmation_target) const;
+    
+    // Drop cached responses for an address whose outputs were just spent
+    void forget_address(const std::string& address) const;
     
     // Get transaction history
     std::vector<Transaction> get_transaction_history(const std::string& address) const;
     
+    // Transaction count and balance in a single request
+    AddressStats get_address_stats(const std::string& address) const;
+    
+    // Batch forms of the lookups above. All requests are issued at once on
+    // the shared HTTP event loop, at most `concurrency` in flight, and
+    // results are collected as they complete, in the order given.
+    std::vector<AddressBalance> get_balances(const std::vector<std::string>& addresses,
+                                             size_t concurrency = DEFAULT_BATCH_CONCURRENCY) const;
+    
+    // Throws the first failure
+    std::vector<AddressStats> get_address_stats(const std::vector<std::string>& addresses,
+                                                size_t concurrency = DEFAULT_BATCH_CONCURRENCY) const;
+    
+    // Confirmed transactions Esplora returns per page
+    static constexpr size_t TRANSACTION_PAGE_SIZE = 25;
+    
+    // Transaction pages, newest first. With an empty after_txid this is the
+    // mempool plus the newest confirmed page, otherwise the confirmed page
+    // following after_txid. Never served from the response cache, since
+    // callers ask exactly when they know the history changed.
+    std::vector<TransactionPage> get_transaction_pages(const std::vector<std::string>& addresses,
+                                                       const std::vector<std::string>& after_txids,
+                                                       size_t concurrency = DEFAULT_BATCH_CONCURRENCY) const;
+    
     // Constructor (public for make_unique)
     NetworkClient(const std::string& base_url);
     
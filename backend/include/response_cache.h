@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "http_client.h"
+
+namespace crypto_wallet {
+
+// Esplora endpoints, which go stale at different rates
+enum class Endpoint {
+    Utxo,          // /address/<addr>/utxo
+    Transactions,  // /address/<addr>/txs
+    Address,       // /address/<addr>
+    Other
+};
+
+struct CachePolicy {
+    std::chrono::milliseconds ttl;        // Served as is
+    std::chrono::milliseconds stale_for;  // After that, served while a refresh runs
+};
+
+struct ResponseCacheStats {
+    uint64_t hits;
+    uint64_t stale_hits;
+    uint64_t misses;
+    uint64_t coalesced;   // Waited on a request already in flight
+    uint64_t refreshes;   // Background revalidations
+    uint64_t errors;
+    size_t size;
+
+    double hit_rate() const {
+        uint64_t total = hits + stale_hits + misses + coalesced;
+        return total ? double(hits + stale_hits + coalesced) / total : 0.0;
+    }
+};
+
+// GET responses by URL in front of an HttpClient. Fresh entries are served
+// from memory; stale ones are served while one background refresh
+// replaces them; concurrent misses for a URL share a single upstream
+// request. Errors are never cached. Least recently used entries beyond
+// `capacity` are dropped.
+class ResponseCache {
+public:
+    explicit ResponseCache(HttpClient& client, size_t capacity = 4096);
+    ~ResponseCache();
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    // Over HttpClient::shared()
+    static ResponseCache& shared();
+
+    static Endpoint classify(const std::string& url);
+    void set_policy(Endpoint endpoint, CachePolicy policy);
+
+    // Throws WalletError::http like HttpClient::get
+    std::string get(const std::string& url);
+
+    // HttpClient::get_many through the cache. Cached URLs are answered
+    // without a request; handler calls never overlap.
+    void get_many(const std::vector<std::string>& urls, size_t concurrency, const HttpBatchHandler& handler);
+
+    // Drop cached bodies. Requests already in flight still answer their
+    // waiters, but their responses are no longer stored.
+    void invalidate(const std::string& url);
+    void clear();
+
+    ResponseCacheStats stats() const;
+
+private:
+    using Flight = std::shared_future<std::string>;
+
+    struct Entry {
+        std::string body;
+        bool has_body = false;
+        std::chrono::steady_clock::time_point fetched;
+        Flight flight;  // Valid while a request for the URL is in flight
+        uint64_t generation = 0;  // Changes on invalidation; a flight only stores into its own
+        std::list<std::string>::iterator lru;
+    };
+
+    struct Refresh {
+        std::string url;
+        std::shared_ptr<std::promise<std::string>> promise;
+        uint64_t generation;
+    };
+
+    enum class Lookup { Fresh, Stale, InFlight, Miss };
+
+    HttpClient& client_;
+    size_t capacity_;
+    CachePolicy policies_[4];
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;  // Most recent first
+    uint64_t next_generation_;    // Unique across entries, so a re-created one never matches an old flight
+
+    std::condition_variable refresh_ready_;
+    std::vector<Refresh> refresh_queue_;
+    std::thread refresher_;
+    bool stopping_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> stale_hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> coalesced_;
+    std::atomic<uint64_t> refreshes_;
+    std::atomic<uint64_t> errors_;
+
+    // These expect mutex_ held. lookup() starts a refresh for stale
+    // entries and, on a miss, registers the caller's flight along with the
+    // generation it belongs to.
+    Lookup lookup(const std::string& url, std::string& body, Flight& flight,
+                  std::shared_ptr<std::promise<std::string>>& promise, uint64_t& generation);
+    Entry& touch(const std::string& url);
+    void evict();
+    void drop(Entry& entry);
+
+    void complete(const std::string& url, uint64_t generation, std::promise<std::string>& promise,
+                  std::string body);
+    void fail(const std::string& url, uint64_t generation, std::promise<std::string>& promise,
+              const std::string& error);
+
+    void refresh_loop();
+};
+
+} // namespace crypto_wallet
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include "trading.h"
+
+namespace crypto_wallet {
+
+enum class RiskRejectReason {
+    NONE,
+    UNKNOWN_PAIR,
+    PAIR_INACTIVE,
+    BELOW_MIN_AMOUNT,
+    ABOVE_MAX_AMOUNT,
+    INSUFFICIENT_BALANCE,
+    EXPOSURE_LIMIT,
+    RATE_LIMIT
+};
+
+struct RiskCheckResult {
+    RiskRejectReason reason;
+    double limit;   // Limit that was breached
+    double actual;  // Value that breached it
+
+    bool ok() const { return reason == RiskRejectReason::NONE; }
+
+    // Formats as "<REASON>: <detail>" for Order::error_message
+    std::string to_error_message() const;
+};
+
+struct WalletLimits {
+    double max_open_notional;      // Quote-asset value of resting orders
+    double max_orders_per_second;  // Token bucket refill rate
+    double max_order_burst;        // Token bucket capacity
+};
+
+class RiskEngine {
+public:
+    RiskEngine();
+
+    // Limit table maintenance (insert or update in place)
+    void set_trading_pair(const TradingPair& pair);
+    void set_default_limits(const WalletLimits& limits);
+    void set_wallet_limits(const std::string& wallet_name, const WalletLimits& limits);
+    void set_default_balances(const std::map<std::string, double>& balances);
+
+    // Pre-trade check; every checked order consumes one rate-limit token
+    RiskCheckResult check_order(const Order& order, double reference_price);
+
+    // Incremental state updates from the matching engine
+    void on_order_resting(const Order& order);
+    void on_order_released(const Order& order);
+    void on_order_filled(const Order& order);
+
+    // Cached balances for portfolio queries; never creates a wallet row
+    std::map<std::string, double> get_balances(const std::string& wallet_name) const;
+
+    static const char* reason_to_string(RiskRejectReason reason);
+
+private:
+    struct PairLimits {
+        double min_amount;
+        double max_amount;
+        bool is_active;
+        uint32_t base_asset;
+        uint32_t quote_asset;
+    };
+
+    struct WalletState {
+        WalletLimits limits;
+        std::vector<double> balances;  // Indexed by asset id
+        std::vector<double> reserved;  // Held by resting orders
+        double open_notional;
+        double tokens;
+        std::chrono::steady_clock::time_point last_refill;
+    };
+
+    std::vector<PairLimits> pairs_;
+    std::unordered_map<std::string, uint32_t> pair_ids_;
+    std::vector<std::string> assets_;
+    std::unordered_map<std::string, uint32_t> asset_ids_;
+    std::vector<double> default_balances_;
+    WalletLimits default_limits_;
+    std::vector<WalletState> wallets_;
+    std::unordered_map<std::string, uint32_t> wallet_ids_;
+
+    uint32_t asset_id(const std::string& asset);
+    WalletState& wallet_state(const std::string& wallet_name);
+    const PairLimits* find_pair(const std::string& pair) const;
+    void apply_reservation(const Order& order, double sign);
+};
+
+} // namespace crypto_wallet
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crypto_wallet {
+
+// Page-aligned buffer for key material. The pages are locked in RAM where
+// the process limits allow (so they never reach swap), excluded from core
+// dumps, and wiped before they are released.
+class LockedBuffer {
+public:
+    explicit LockedBuffer(size_t size);
+    ~LockedBuffer();
+
+    LockedBuffer(const LockedBuffer&) = delete;
+    LockedBuffer& operator=(const LockedBuffer&) = delete;
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // False when mlock was refused (e.g. RLIMIT_MEMLOCK); the buffer still
+    // works and is still wiped
+    bool locked() const { return locked_; }
+
+private:
+    uint8_t* data_;
+    size_t size_;
+    size_t mapped_size_;
+    bool locked_;
+};
+
+} // namespace crypto_wallet
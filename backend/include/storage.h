@@ -3,7 +3,10 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
 #include "wallet.h"
+#include "wallet_file.h"
+#include "wallet_catalog.h"
 #include "error.h"
 
 namespace crypto_wallet {
@@ -16,15 +19,55 @@ public:
     // Get wallet file path
     static std::filesystem::path get_wallet_path(const std::string& name);
     
-    // Save wallet to file
+    // Path of a pre-binary JSON wallet
+    static std::filesystem::path get_legacy_wallet_path(const std::string& name);
+    
+    // Save wallet to file; atomic, and durable when this returns
     static void save(const Wallet& wallet);
     
-    // Load wallet from file
+    // Load wallet from file, converting a legacy JSON wallet on first use
     static Wallet load(const std::string& name);
     
-    // List all wallets
+    // Append one address to a saved wallet without rewriting the file.
+    // Durable within one DurableWriter window. Throws WalletError::storage
+    // if the file already holds the address.
+    static void append_address(const std::string& name, WalletFile::Chain chain,
+                               const std::string& address);
+    
+    // Append derive(n) for the chain's next index n, counted in the file
+    // itself, so callers holding stale snapshots of the wallet still each
+    // get a new address. Returns the address.
+    static std::string append_next_address(const std::string& name, WalletFile::Chain chain,
+                                           const std::function<std::string(uint32_t)>& derive);
+    
+    // Derive the wallet's key and keep it in WalletKeyring, so loads and
+    // saves of an encrypted wallet work until it is locked or the key
+    // idles out. Throws WalletError::invalid_password on a wrong password;
+    // a plaintext wallet needs no unlocking.
+    static void unlock(const std::string& name, const std::string& password);
+    
+    // Forget the wallet's key and drop it from the wallet cache
+    static void lock(const std::string& name);
+    
+    // Encrypt the wallet under a new password from its next save on. The
+    // wallet stays unlocked.
+    static void set_password(Wallet& wallet, const std::string& password);
+    
+    // Rewrite a legacy JSON wallet in the binary format. The JSON file is
+    // kept as <name>.json.bak. Returns false if there was nothing to convert.
+    static bool convert_legacy(const std::string& name);
+    
+    // List all wallets, in name order, from the catalog
     static std::vector<std::string> list_wallets();
     
+    // Catalog entries whose name starts with prefix, one page at a time
+    static std::vector<CatalogEntry> find_wallets(const std::string& prefix = "", size_t offset = 0,
+                                                  size_t limit = SIZE_MAX);
+    static size_t count_wallets(const std::string& prefix = "");
+    
+    // Rebuild the catalog by scanning the wallet directory
+    static void rebuild_catalog();
+    
     // Delete wallet
     static void delete_wallet(const std::string& name);
     
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <cstddef>
+
+namespace crypto_wallet {
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool sized to the hardware
+    static ThreadPool& shared();
+
+    size_t size() const { return workers_.size(); }
+
+    // Queue a task for a worker thread
+    std::future<void> submit(std::function<void()> task);
+
+    // Run fn(begin, end) over [0, count) in blocks of `grain` items and wait
+    // for all of them. The calling thread works too, so this is safe to call
+    // from inside a pool task. The first exception thrown is rethrown here.
+    void parallel_for(size_t count, size_t grain,
+                      const std::function<void(size_t, size_t)>& fn);
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::packaged_task<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+
+    void worker_loop();
+};
+
+} // namespace crypto_wallet
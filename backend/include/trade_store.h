@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto_wallet {
+
+// One trade as stored in the columnar store. Strings are dictionary-encoded.
+struct TradeRow {
+    int64_t timestamp;     // system_clock ticks since epoch
+    uint32_t wallet_id;
+    uint32_t order_index;  // Index into the engine's order log
+    uint16_t pair_id;
+    uint8_t side;          // OrderSide as integer
+    double price;
+    double amount;
+    double fee;
+};
+
+struct TradeStats {
+    size_t trade_count;
+    double volume;    // Base asset
+    double notional;  // Quote asset
+    double vwap;
+    double high;
+    double low;
+};
+
+// Append-only trade history in fixed-size column chunks. Each chunk keeps a
+// min/max timestamp zone map so range queries skip chunks they cannot match,
+// and sealed chunks can be spilled to memory-mapped files.
+class TradeStore {
+public:
+    explicit TradeStore(size_t chunk_rows = 4096);
+    ~TradeStore();
+
+    TradeStore(const TradeStore&) = delete;
+    TradeStore& operator=(const TradeStore&) = delete;
+
+    // Spill sealed chunks into this directory (created if missing)
+    void enable_spill(const std::filesystem::path& directory);
+
+    // Dictionary encoding
+    uint32_t intern_wallet(const std::string& wallet_name);
+    uint16_t intern_pair(const std::string& pair);
+    const std::string& pair_name(uint16_t pair_id) const;
+
+    void append(const TradeRow& row);
+
+    // Rows for one wallet with from <= timestamp <= to
+    std::vector<TradeRow> query_wallet(const std::string& wallet_name,
+                                       int64_t from, int64_t to) const;
+
+    // Aggregates over one pair with from <= timestamp <= to
+    TradeStats aggregate_pair(const std::string& pair, int64_t from, int64_t to) const;
+
+    size_t size() const { return total_rows_; }
+    size_t chunk_count() const { return chunks_.size(); }
+    size_t memory_bytes() const;
+
+private:
+    struct Chunk;
+
+    size_t chunk_rows_;
+    size_t total_rows_;
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    std::filesystem::path spill_dir_;
+    bool spill_enabled_;
+
+    std::unordered_map<std::string, uint32_t> wallet_ids_;
+    std::unordered_map<std::string, uint16_t> pair_ids_;
+    std::vector<std::string> pair_names_;
+
+    void seal(Chunk& chunk, size_t chunk_number);
+};
+
+} // namespace crypto_wallet
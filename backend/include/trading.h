@@ -4,6 +4,9 @@
 #include <vector>
 #include <chrono>
 #include <map>
+#include <memory>
+#include <mutex>
+#include "trade_store.h"
 
 namespace crypto_wallet {
 
@@ -88,6 +91,8 @@ struct Trade {
     std::chrono::system_clock::time_point timestamp;
 };
 
+class RiskEngine;
+
 class TradingEngine {
 public:
     TradingEngine();
@@ -106,23 +111,41 @@ public:
     
     // Trade history
     std::vector<Trade> get_trades(const std::string& wallet_name);
+    std::vector<Trade> get_trades(
+        const std::string& wallet_name,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to
+    );
+    
+    // Trade analytics over a time range
+    TradeStats get_trade_stats(
+        const std::string& pair,
+        std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point to
+    );
     
     // Portfolio
     std::map<std::string, double> get_portfolio_balances(const std::string& wallet_name);
     double get_portfolio_value(const std::string& wallet_name);
     
 private:
+    std::mutex mutex_;
     std::vector<Order> orders_;
-    std::vector<Trade> trades_;
+    TradeStore trade_store_;
     std::map<std::string, TradingPair> trading_pairs_;
     std::map<std::string, MarketData> market_data_;
+    std::unique_ptr<RiskEngine> risk_engine_;
     
     // Order ID generation
     std::string generate_order_id();
     
+    // Price used for risk checks (limit price, or last price for market orders)
+    double reference_price(const Order& order) const;
+    
     // Order matching engine
     void process_order(Order& order);
     void match_orders(const std::string& pair);
+    void record_trade(const Order& order);
     
     // Market data updates
     void update_market_data();
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include "crypto.h"
+#include "secure_memory.h"
+#include "error.h"
+
+namespace crypto_wallet {
+
+// One recipient of a transaction, in satoshis
+struct Payout {
+    std::string address;
+    uint64_t amount;
+};
+
+struct SignedTransaction {
+    std::vector<uint8_t> raw;
+    std::string txid;   // Hex, in the byte order explorers show
+    uint64_t fee;       // Satoshis
+    size_t size;        // Bytes, equal to vbytes without witnesses
+
+    std::string hex() const;
+};
+
+// Builds and signs a version 2 transaction spending the wallet's P2PKH
+// outputs (BIP44 addresses are P2PKH) to any standard output type. Inputs
+// signal replace-by-fee so a stuck payout can be bumped.
+//
+// The serialized size is known before signing, since only the signature
+// lengths vary, so the raw transaction is written into a buffer allocated
+// once at its upper bound. Each input's legacy SIGHASH_ALL digest is
+// streamed through SHA256 from pieces serialized once, without building
+// the per-input copies of the transaction, and inputs are signed across
+// the shared thread pool.
+class TransactionBuilder {
+public:
+    // Serialized sizes used for fee estimates
+    static constexpr size_t TX_OVERHEAD_SIZE = 10;    // Version, locktime and counts up to 252
+    static constexpr size_t P2PKH_INPUT_SIZE = 148;   // With the longest low-S signature
+    static constexpr size_t P2PKH_OUTPUT_SIZE = 34;
+
+    // Below this an output costs more to spend than it holds
+    static constexpr uint64_t DUST_LIMIT = 546;
+
+    // scriptPubKey for a base58 P2PKH/P2SH or bech32 SegWit address of the
+    // network: tb/m/n/2 on testnet, bc/1/3 anywhere else (mainnet, mock).
+    // Throws WalletError::invalid_address, also for another network's.
+    static std::vector<uint8_t> output_script(const std::string& address, const std::string& network);
+
+    // Bytes an output paying to script adds to a transaction
+    static size_t output_size(const std::vector<uint8_t>& script);
+
+    // txid is hex as shown by explorers; public_key the compressed key the
+    // output is locked to
+    void add_input(const std::string& txid, uint32_t vout, uint64_t value,
+                   const std::array<uint8_t, 33>& public_key);
+    void add_output(std::vector<uint8_t> script, uint64_t value);
+
+    size_t input_count() const { return inputs_.size(); }
+    size_t output_count() const { return outputs_.size(); }
+    uint64_t input_value() const;
+    uint64_t output_value() const;
+
+    // Upper bound on the signed size
+    size_t max_size() const;
+
+    // Sign input i with the 32-byte secret key at keys.data() + 32 * i and
+    // serialize. Throws WalletError::crypto if a key does not match its
+    // input or the outputs exceed the inputs.
+    SignedTransaction sign(const LockedBuffer& keys) const;
+
+private:
+    struct Input {
+        std::array<uint8_t, 36> outpoint;  // txid in internal byte order, then vout
+        uint64_t value;
+        std::array<uint8_t, 25> script_code;  // The P2PKH scriptPubKey being spent
+        std::array<uint8_t, 33> public_key;
+    };
+
+    struct Output {
+        std::vector<uint8_t> script;
+        uint64_t value;
+    };
+
+    std::vector<Input> inputs_;
+    std::vector<Output> outputs_;
+};
+
+} // namespace crypto_wallet
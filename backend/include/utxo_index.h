@@ -0,0 +1,145 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include "network.h"
+#include "error.h"
+
+namespace crypto_wallet {
+
+struct IndexedUtxo {
+    std::string txid;
+    uint32_t vout;
+    uint64_t value;         // Satoshis
+    uint32_t block_height;  // 0 while unconfirmed
+};
+
+struct IndexedTransaction {
+    std::string txid;
+    uint32_t block_height;  // 0 while unconfirmed
+    int64_t block_time;
+    int64_t amount;         // Satoshis received minus spent by the address
+};
+
+struct UtxoIndexStats {
+    size_t addresses;
+    uint64_t syncs;
+    uint64_t addresses_checked;
+    uint64_t addresses_fetched;  // Had changed and needed transaction pages
+    uint64_t pages_fetched;
+    uint64_t rebuilds;           // Lost their place, e.g. after a reorg
+    uint64_t compactions;        // Log folded back into the snapshot
+};
+
+// Per-address UTXO set and transaction history, persisted per network beside
+// the wallets as a snapshot plus a log of the entries each sync changed. The
+// log is replayed over the snapshot on load and folded into a new snapshot
+// once it outgrows it. sync() asks Esplora only for address stats,
+// which the response cache absorbs, and fetches transaction pages just for
+// addresses whose counts or confirmed balance moved, newest first, back to
+// the newest transaction already indexed. Balances are then read from memory.
+//
+// Confirmed state is kept across syncs; mempool transactions are replaced
+// on each sync of the address. If the last indexed transaction is no longer
+// in the history the address is rebuilt from what was fetched.
+//
+// Syncs of disjoint address sets run concurrently; a sync waits only for
+// one already working on some of the same addresses.
+class UtxoIndex {
+public:
+    explicit UtxoIndex(const std::filesystem::path& path);
+    ~UtxoIndex();
+
+    UtxoIndex(const UtxoIndex&) = delete;
+    UtxoIndex& operator=(const UtxoIndex&) = delete;
+
+    // One index per network, in the wallet directory
+    static UtxoIndex& for_network(const std::string& network);
+
+    // Bring the addresses up to date. An address whose pages fail keeps
+    // its previous state; throws only if the stats lookup fails. Changed
+    // entries are appended to the log, which is synced in the background:
+    // anything lost to a crash is fetched again.
+    void sync(const NetworkClient& client, const std::vector<std::string>& addresses);
+
+    // Satoshis, mempool included; 0 for an address never synced
+    int64_t balance(const std::string& address) const;
+
+    // Spendable outputs, mempool included, minus outputs the mempool spends
+    std::vector<IndexedUtxo> utxos(const std::string& address) const;
+
+    // An output this process just spent, hidden from utxos() and balance()
+    // until a sync of the address shows the spend, in the mempool or
+    // confirmed. Kept in memory only; upstream catches up within seconds.
+    void mark_spent(const std::string& address, const std::string& txid, uint32_t vout);
+
+    // Newest first, mempool transactions first of all
+    std::vector<IndexedTransaction> transactions(const std::string& address) const;
+
+    UtxoIndexStats stats() const;
+
+private:
+    struct Outpoint {
+        std::string txid;
+        uint32_t vout;
+    };
+
+    struct Entry {
+        std::string tip_txid;                   // Newest confirmed transaction
+        std::vector<IndexedTransaction> history; // Confirmed, oldest first
+        std::vector<IndexedUtxo> utxos;          // Confirmed
+        int64_t confirmed_balance = 0;
+
+        std::vector<IndexedTransaction> pending;  // Mempool, newest first
+        std::vector<IndexedUtxo> pending_utxos;
+        std::vector<Outpoint> pending_spent;      // By mempool transactions
+        int64_t pending_balance = 0;
+
+        std::vector<IndexedUtxo> local_spent;     // mark_spent() not yet seen upstream
+    };
+
+    std::filesystem::path path_;
+    std::filesystem::path log_path_;
+    int log_fd_;
+    mutable std::mutex mutex_;     // Guards entries_, syncing_ and the counters
+    std::condition_variable sync_done_;
+    std::unordered_set<std::string> syncing_;  // Addresses a sync has claimed
+    std::unordered_map<std::string, Entry> entries_;
+    std::mutex file_mutex_;        // Guards the log and the sizes below
+    size_t snapshot_size_ = 0;
+    size_t log_size_ = 0;
+    uint64_t syncs_ = 0;
+    uint64_t addresses_checked_ = 0;
+    uint64_t addresses_fetched_ = 0;
+    uint64_t pages_fetched_ = 0;
+    uint64_t rebuilds_ = 0;
+    uint64_t compactions_ = 0;
+
+    static void apply_confirmed(Entry& entry, const std::string& address, const ChainTransaction& tx);
+    static void set_pending(Entry& entry, const std::string& address,
+                            const std::vector<ChainTransaction>& mempool);
+    static bool is_spent(const Entry& entry, const std::string& txid, uint32_t vout);
+    static void drop_seen_local_spends(Entry& entry);
+
+    // The serialized form shared by the snapshot and the log; local_spent
+    // is not written
+    static void put_entry(std::vector<uint8_t>& out, const std::string& address, const Entry& entry);
+    template <typename Reader>
+    static bool get_entry(Reader& reader, std::string& address, Entry& entry);
+
+    bool read_file();
+    void write_file();
+
+    // Expects file_mutex_ held
+    void open_log();
+    void append_log(const std::vector<uint8_t>& records);
+};
+
+} // namespace crypto_wallet
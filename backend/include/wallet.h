@@ -5,21 +5,28 @@
 #include <chrono>
 #include <memory>
 #include "crypto.h"
+#include "secure_memory.h"
+#include "transaction_builder.h"
 #include "error.h"
 
 namespace crypto_wallet {
 
+class UtxoIndex;
+
 struct Wallet {
     std::string name;
     std::string seed_phrase;
-    std::vector<std::string> addresses;
+    std::vector<std::string> addresses;         // Receive chain
+    std::vector<std::string> change_addresses;  // Change chain
     std::chrono::system_clock::time_point created_at;
+    bool encrypted = false;  // Saved sealed with the key held by WalletKeyring
     
-    // Create a new wallet
-    static Wallet create_new(const std::string& name);
+    // Create a new wallet; encrypted and left unlocked if a password is given
+    static Wallet create_new(const std::string& name, const std::string& password = "");
     
     // Import wallet from seed phrase
-    static Wallet from_seed_phrase(const std::string& seed_phrase, const std::string& name);
+    static Wallet from_seed_phrase(const std::string& seed_phrase, const std::string& name,
+                                   const std::string& password = "");
     
     // Load existing wallet
     static Wallet load(const std::string& name);
@@ -30,6 +37,13 @@ struct Wallet {
     // Generate a new address
     std::string generate_address(uint32_t index) const;
     
+    // Addresses first .. first + count - 1 of the receive (or change) chain
+    std::vector<std::string> generate_addresses(uint32_t first, uint32_t count, bool change = false) const;
+    
+    // Scan both chains for used addresses up to the gap limit, then store
+    // what was found and save once. Returns the total balance seen.
+    double discover_addresses(const std::string& network);
+    
     // Get all addresses
     const std::vector<std::string>& get_addresses() const { return addresses; }
     
@@ -39,21 +53,54 @@ struct Wallet {
     // Get seed phrase
     const std::string& get_seed_phrase() const { return seed_phrase; }
     
+    // BIP39 seed for seed_phrase. The KDF runs on first use; the result is
+    // kept in locked memory and shared by copies of this wallet.
+    const std::array<uint8_t, 64>& seed() const;
+    
     // Get wallet balance
     double get_balance(const std::string& network) const;
     
-    // Send transaction
+    // Blocks a payout should confirm within unless told otherwise
+    static constexpr uint32_t DEFAULT_CONFIRMATION_TARGET = 6;
+    
+    // Send amount BTC; returns the txid
     std::string send_transaction(
         const std::string& to_address, 
         double amount, 
-        const std::string& network
+        const std::string& network,
+        uint32_t confirmation_target = DEFAULT_CONFIRMATION_TARGET
+    ) const;
+    
+    // Pay every recipient from a single transaction, so a batch shares one
+    // set of inputs, one change output and one signature per input. Coins
+    // come from the UTXO index and are chosen by branch and bound, falling
+    // back to knapsack, at the estimated fee rate. Returns the txid.
+    std::string send_payouts(
+        const std::vector<Payout>& payouts,
+        const std::string& network,
+        uint32_t confirmation_target = DEFAULT_CONFIRMATION_TARGET
     ) const;
     
     // Validate address format
     bool is_valid_address(const std::string& address) const;
     
+    // Addresses are derived for mainnet (BIP44 coin type 0) only, so the
+    // wallet can be used on mainnet and on the mock upstream, which serves
+    // any address. Testnet would need coin type 1 and its own address set.
+    static bool supports_network(const std::string& network);
+    
+    // Receive addresses, then change addresses
+    std::vector<std::string> all_addresses() const;
+    
     // Default constructor (public for storage)
     Wallet() = default;
+    
+private:
+    mutable std::shared_ptr<LockedBuffer> seed_cache_;
+    
+    // First change address without history, or the next one appended to the
+    // wallet file
+    std::string change_address(const UtxoIndex& index) const;
 };
 
 } // namespace crypto_wallet
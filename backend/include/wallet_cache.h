@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <filesystem>
+#include <cstdint>
+#include <cstddef>
+#include "wallet.h"
+
+namespace crypto_wallet {
+
+struct WalletCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t invalidations;
+    size_t size;
+    size_t capacity;
+
+    double hit_rate() const {
+        uint64_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+};
+
+// Loaded wallets keyed by name, split into independently locked LRU shards.
+// Entries are immutable snapshots; anything that changes a wallet on disk
+// replaces or drops its entry, either directly (WalletStorage writes
+// through) or via an inotify watch on the wallet directory for changes made
+// by other processes.
+class WalletCache {
+public:
+    explicit WalletCache(size_t capacity = 256, size_t shards = 16);
+    ~WalletCache();
+
+    WalletCache(const WalletCache&) = delete;
+    WalletCache& operator=(const WalletCache&) = delete;
+
+    static WalletCache& shared();
+
+    // Cached wallet, loading it on a miss. An encrypted wallet whose key
+    // has left WalletKeyring is dropped and reloaded, which throws
+    // WalletError::wallet_locked. Otherwise throws what Wallet::load throws.
+    std::shared_ptr<const Wallet> get(const std::string& name);
+
+    // Replace the entry for wallet.name if it is cached
+    void refresh(const Wallet& wallet);
+
+    void invalidate(const std::string& name);
+    void clear();
+
+    // Invalidate entries whose files change under `directory`. Linux only;
+    // returns false if the watch could not be set up.
+    bool watch(const std::filesystem::path& directory);
+    void stop_watching();
+
+    WalletCacheStats stats() const;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used at the front
+        std::list<std::pair<std::string, std::shared_ptr<const Wallet>>> entries;
+        std::unordered_map<std::string, decltype(entries)::iterator> index;
+        // Bumped by every invalidation, so a load that raced one is not cached
+        uint64_t generation = 0;
+    };
+
+    size_t shard_capacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> invalidations_;
+
+    int inotify_fd_;
+    int wake_fd_;
+    std::thread watcher_;
+
+    Shard& shard_for(const std::string& name);
+    void insert_locked(Shard& shard, const std::string& name, std::shared_ptr<const Wallet> wallet);
+    void watch_loop();
+};
+
+} // namespace crypto_wallet
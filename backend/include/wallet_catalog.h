@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <filesystem>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace crypto_wallet {
+
+struct CatalogEntry {
+    std::string name;
+    std::string file;          // File name inside the wallet directory
+    int64_t created_at;        // Seconds since epoch
+    uint32_t address_count;    // Receive and change
+    int64_t modified_at;       // Seconds since epoch
+};
+
+// Index of the wallets in a directory, kept in catalog.idx beside them and
+// sorted by name. Changes are read-modify-write under an flock on
+// catalog.lock, so several processes can share it; each process keeps a
+// copy in memory and rereads the file only when its inode, size or mtime
+// changed. If the file is missing or corrupt it is rebuilt with `scan`.
+class WalletCatalog {
+public:
+    using Scanner = std::function<std::vector<CatalogEntry>()>;
+
+    WalletCatalog(const std::filesystem::path& directory, Scanner scan);
+    ~WalletCatalog();
+
+    WalletCatalog(const WalletCatalog&) = delete;
+    WalletCatalog& operator=(const WalletCatalog&) = delete;
+
+    // Insert or replace an entry without waiting for the disk. Lookups see
+    // it at once; it is written in the next DurableWriter batch together
+    // with every other queued change. A crash before then leaves the wallet
+    // unlisted until rebuild().
+    void upsert(const CatalogEntry& entry);
+
+    // Durable when this returns; false if the name was not listed
+    bool remove(const std::string& name);
+
+    // Record a new address count without waiting for the disk. Counts are
+    // written in the next DurableWriter batch, one catalog write per batch.
+    void set_address_count(const std::string& name, uint32_t count);
+
+    // Entries whose name starts with prefix, in name order, skipping the
+    // first `offset` matches
+    std::vector<CatalogEntry> find(const std::string& prefix = "", size_t offset = 0,
+                                   size_t limit = SIZE_MAX);
+    size_t count(const std::string& prefix = "");
+
+    // Discard the catalog and rebuild it from a scan
+    void rebuild();
+
+private:
+    struct FileStamp {
+        ino_t inode = 0;
+        off_t size = -1;
+        int64_t mtime_ns = 0;
+
+        bool operator==(const FileStamp& other) const {
+            return inode == other.inode && size == other.size && mtime_ns == other.mtime_ns;
+        }
+    };
+
+    std::filesystem::path path_;
+    std::filesystem::path lock_path_;
+    int lock_fd_;
+    Scanner scan_;
+    std::mutex mutex_;
+    std::vector<CatalogEntry> entries_;  // Sorted by name
+    FileStamp stamp_;
+    bool loaded_;
+    std::unordered_map<std::string, uint32_t> pending_counts_;
+    std::unordered_map<std::string, CatalogEntry> pending_upserts_;
+
+    static FileStamp stamp_of(const struct stat& st);
+
+    // These expect mutex_ and the file lock held
+    void refresh();
+    void apply_pending_upserts();
+    bool read_file();
+    void write_file();
+    std::vector<CatalogEntry>::iterator lower_bound(const std::string& name);
+
+    // Runs on the DurableWriter thread
+    void persist_pending();
+
+    // Runs fn with mutex_ and the cross-process lock held, on fresh entries
+    template <typename Fn>
+    auto transaction(Fn fn) -> decltype(fn());
+};
+
+} // namespace crypto_wallet
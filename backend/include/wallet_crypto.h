@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "secure_memory.h"
+#include "error.h"
+
+namespace crypto_wallet {
+
+constexpr size_t WALLET_KEY_SIZE = 32;  // AES-256
+constexpr size_t GCM_NONCE_SIZE = 12;
+constexpr size_t GCM_TAG_SIZE = 16;
+constexpr size_t GCM_OVERHEAD = GCM_NONCE_SIZE + GCM_TAG_SIZE;
+
+// scrypt parameters stored in an encrypted wallet
+struct KdfParams {
+    std::array<uint8_t, 16> salt;
+    uint8_t log2_n;  // Cost N = 2^log2_n
+    uint8_t r;
+    uint8_t p;
+
+    // Fresh random salt and the default cost (N = 2^15, r = 8, p = 1)
+    static KdfParams generate();
+};
+
+// Derived key for one wallet together with the parameters it came from
+struct WalletKey {
+    KdfParams params;
+    std::shared_ptr<LockedBuffer> key;  // WALLET_KEY_SIZE bytes
+};
+
+// Run scrypt over the password. Deliberately slow; see WalletKeyring.
+WalletKey derive_wallet_key(const std::string& password, const KdfParams& params);
+
+// AES-256-GCM with a random nonce. out receives nonce | ciphertext | tag,
+// size + GCM_OVERHEAD bytes.
+void aead_seal(const uint8_t* key, const uint8_t* aad, size_t aad_size,
+               const uint8_t* plaintext, size_t size, uint8_t* out);
+
+// Reverse of aead_seal; false if authentication fails. plaintext receives
+// sealed_size - GCM_OVERHEAD bytes.
+bool aead_open(const uint8_t* key, const uint8_t* aad, size_t aad_size,
+               const uint8_t* sealed, size_t sealed_size, uint8_t* plaintext);
+
+// Keys of unlocked wallets, so the KDF runs once per session rather than
+// once per load. A key is dropped after `idle_timeout` without use or when
+// its wallet is locked.
+class WalletKeyring {
+public:
+    explicit WalletKeyring(std::chrono::seconds idle_timeout = std::chrono::minutes(15));
+
+    static WalletKeyring& shared();
+
+    void store(const std::string& name, WalletKey key);
+
+    // Key for the wallet if it is unlocked with these KDF parameters
+    std::shared_ptr<const WalletKey> get(const std::string& name, const KdfParams& params);
+
+    // Key for the wallet whatever its parameters, used when saving
+    std::shared_ptr<const WalletKey> get(const std::string& name);
+
+    void lock(const std::string& name);
+    void lock_all();
+
+private:
+    struct Entry {
+        std::shared_ptr<const WalletKey> key;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    std::chrono::seconds idle_timeout_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace crypto_wallet
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "wallet.h"
+#include "wallet_crypto.h"
+#include "error.h"
+
+namespace crypto_wallet {
+
+// Binary wallet file, memory-mapped while open. Layout:
+//
+//   header (64 bytes) | name | seed phrase | address records ...
+//
+// Each address record is a chain byte, a length byte and the address
+// characters. Records are appended in place; the header holds the committed
+// length of the record section and a CRC32C over it, and is only updated
+// after the record is written. It also remembers the record length as of the
+// last sync(); if a crash leaves the header ahead of the records, open()
+// rolls back to that point.
+//
+// An encrypted file (version 2) keeps the name, counts and dates in the
+// clear. The seed phrase is replaced by the scrypt parameters and the
+// AES-256-GCM sealed phrase, and the records are sealed in frames of up to
+// 64 KiB, each with its own nonce and tag, so an append seals one new frame
+// instead of re-encrypting the file. A frame's offset is authenticated
+// with it, so frames cannot be reordered.
+class WalletFile {
+public:
+    static constexpr uint16_t VERSION = 2;
+
+    enum Flags : uint16_t {
+        FLAG_ENCRYPTED = 1
+    };
+
+    enum Chain : uint8_t {
+        RECEIVE = 0,
+        CHANGE = 1
+    };
+
+    // On-disk header, defined in wallet_file.cpp
+    struct Header;
+
+    // Serialize a whole wallet, encrypted if a key is given, with room for
+    // `spare_records` bytes of future appends before the file has to grow
+    static std::vector<uint8_t> encode(const Wallet& wallet, const WalletKey* key = nullptr,
+                                       size_t spare_records = 4096);
+
+    // Write a complete file, atomically replacing any existing one
+    static void write(const std::filesystem::path& path, const Wallet& wallet,
+                      const WalletKey* key = nullptr);
+
+    // True if the file starts with the wallet file magic
+    static bool is_wallet_file(const std::filesystem::path& path);
+
+    enum Mode {
+        READ,    // Private view, never written back
+        APPEND   // Shared writable mapping
+    };
+
+    // Map an existing file, checking every CRC and rolling records a crash
+    // left unwritten back to the last sync. Throws WalletError::storage on
+    // a missing, truncated or corrupt file.
+    static WalletFile open(const std::filesystem::path& path, Mode mode = READ);
+
+    WalletFile(WalletFile&& other) noexcept;
+    WalletFile& operator=(WalletFile&& other) noexcept;
+    ~WalletFile();
+
+    WalletFile(const WalletFile&) = delete;
+    WalletFile& operator=(const WalletFile&) = delete;
+
+    // Encrypted files need the wallet's key; throws
+    // WalletError::wallet_locked without one
+    Wallet to_wallet(const WalletKey* key = nullptr) const;
+
+    // Walks the records where they lie, without building a Wallet. Sealed
+    // frames are still opened one at a time, so an encrypted file needs
+    // its key; throws WalletError::wallet_locked without one.
+    bool contains_address(const std::string& address, const WalletKey* key = nullptr) const;
+
+    // O(1) append; grows and remaps the file when the spare space runs out.
+    // Not durable until the next sync().
+    void append_address(Chain chain, const std::string& address, const WalletKey* key = nullptr);
+
+    // Flush appended records to disk and checkpoint them in the header
+    void sync();
+
+    size_t address_count(Chain chain) const;
+    std::string name() const;
+    std::chrono::system_clock::time_point created_at() const;
+
+    bool encrypted() const;
+    KdfParams kdf_params() const;
+
+    // True if the key opens the sealed seed phrase; used to check a password
+    bool opens_with(const WalletKey& key) const;
+
+private:
+    WalletFile(int fd, uint8_t* data, size_t size);
+
+    int fd_;
+    uint8_t* data_;
+    size_t size_;
+
+    Header& header() const;
+    void seal_header();
+    void reserve_records(size_t extra);
+    bool open_seed(const WalletKey& key, std::string& seed_phrase) const;
+    // Hands each span of plaintext records to visit, opening sealed frames
+    // one at a time; stops early when visit returns false
+    template <typename Visit>
+    void visit_records(const WalletKey* key, Visit visit) const;
+    void truncate_records(uint64_t size, uint32_t crc);
+    void close();
+};
+
+} // namespace crypto_wallet
@@ -31,6 +31,7 @@ public:
 private:
     int port_;
     std::atomic<bool> running_;
+    std::atomic<int> active_connections_;
     std::unique_ptr<std::thread> server_thread_;
     std::unique_ptr<TradingEngine> trading_engine_;
     
@@ -39,9 +40,14 @@ private:
     
     // HTTP handlers
     std::string handle_get_balance(const std::string& wallet_name, const std::string& network);
-    std::string handle_send_transaction(const std::string& wallet_name, const std::string& to_address, double amount);
+    std::string handle_send_transaction(const std::string& request_body);
     std::string handle_get_addresses(const std::string& wallet_name);
-    std::string handle_get_transaction_history(const std::string& wallet_name);
+    std::string handle_get_transaction_history(const std::string& wallet_name, const std::string& network);
+    std::string handle_get_wallet_cache_stats();
+    std::string handle_get_network_cache_stats();
+    std::string handle_get_network_upstreams();
+    std::string handle_unlock_wallet(const std::string& request_body);
+    std::string handle_lock_wallet(const std::string& request_body);
     
     // Trading handlers
     std::string handle_place_order(const std::string& request_body);
@@ -90,6 +96,11 @@ private:
     std::string create_error_response(const std::string& error);
     std::string parse_json_request(const std::string& request_body);
     std::string extract_request_body(const std::string& request);
+    // Next complete request (headers plus Content-Length bytes of body) on
+    // the connection; bytes past it stay in pending for the next call.
+    // False once the client closes, sends more than the limits allow, idles
+    // between requests or takes too long to finish one.
+    bool read_request(int client_socket, std::string& pending, std::string& request);
     void handle_client(int client_socket);
 };
 
@@ -0,0 +1,312 @@
+#include "crypto.h"
+#include <cstring>
+
+namespace crypto_wallet {
+
+namespace {
+
+constexpr char BECH32_CHARSET[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+constexpr uint32_t BECH32_CONST = 1;
+constexpr uint32_t BECH32M_CONST = 0x2bc830a3;
+
+// Shortest string with a one-character HRP and an empty data part
+constexpr size_t BECH32_MIN_LENGTH = 8;
+
+// SegWit address lengths for a two-character HRP ("bc", "tb"): a 2-byte
+// program at the short end, a 40-byte one at the long end
+constexpr size_t SEGWIT_MIN_LENGTH = 14;
+constexpr size_t SEGWIT_MAX_LENGTH = 74;
+
+constexpr size_t WITNESS_PROGRAM_MAX = 40;
+
+// ASCII to 5-bit value, -1 for characters outside the charset. Upper case
+// maps like lower case; mixed case is rejected separately.
+struct CharsetTable {
+    int8_t values[128];
+
+    constexpr CharsetTable() : values() {
+        for (auto& value : values) {
+            value = -1;
+        }
+        for (int i = 0; i < 32; ++i) {
+            char c = BECH32_CHARSET[i];
+            values[static_cast<uint8_t>(c)] = static_cast<int8_t>(i);
+            if (c >= 'a' && c <= 'z') {
+                values[static_cast<uint8_t>(c - 'a' + 'A')] = static_cast<int8_t>(i);
+            }
+        }
+    }
+};
+
+constexpr CharsetTable CHARSET_TABLE;
+
+// XOR of the BCH generator terms selected by each 5-bit value shifted out
+// of the checksum, so a polymod step is one lookup instead of five branches
+struct PolymodTable {
+    uint32_t values[32];
+
+    constexpr PolymodTable() : values() {
+        constexpr uint32_t generator[5] = {
+            0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3};
+        for (uint32_t top = 0; top < 32; ++top) {
+            uint32_t value = 0;
+            for (int bit = 0; bit < 5; ++bit) {
+                if ((top >> bit) & 1) {
+                    value ^= generator[bit];
+                }
+            }
+            values[top] = value;
+        }
+    }
+};
+
+constexpr PolymodTable POLYMOD_TABLE;
+
+inline uint32_t polymod_step(uint32_t checksum, uint8_t value) {
+    uint32_t top = checksum >> 25;
+    return ((checksum & 0x1ffffff) << 5) ^ value ^ POLYMOD_TABLE.values[top];
+}
+
+inline char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Checksum over the expanded HRP: high bits, a zero, then low bits
+uint32_t hrp_polymod(const char* hrp, size_t length) {
+    uint32_t checksum = 1;
+    for (size_t i = 0; i < length; ++i) {
+        checksum = polymod_step(checksum, static_cast<uint8_t>(to_lower(hrp[i])) >> 5);
+    }
+    checksum = polymod_step(checksum, 0);
+    for (size_t i = 0; i < length; ++i) {
+        checksum = polymod_step(checksum, static_cast<uint8_t>(to_lower(hrp[i])) & 31);
+    }
+    return checksum;
+}
+
+uint32_t encoding_constant(Bech32Encoding encoding) {
+    return encoding == Bech32Encoding::BECH32M ? BECH32M_CONST : BECH32_CONST;
+}
+
+// Decode without allocating. On success hrp_length is the length of the
+// HRP at the start of `encoded` and data holds the 5-bit data part.
+bool decode_raw(const char* encoded, size_t length, size_t& hrp_length,
+                uint8_t* data, size_t data_size, size_t& written, Bech32Encoding& encoding) {
+    if (length < BECH32_MIN_LENGTH || length > Crypto::BECH32_MAX_LENGTH) {
+        return false;
+    }
+
+    // Cheap checks first: separator position and the case of every
+    // character, before any checksum work
+    size_t separator = length;
+    bool lower = false;
+    bool upper = false;
+    for (size_t i = 0; i < length; ++i) {
+        char c = encoded[i];
+        if (c < 33 || c > 126) {
+            return false;
+        }
+        lower |= (c >= 'a' && c <= 'z');
+        upper |= (c >= 'A' && c <= 'Z');
+        if (c == '1') {
+            separator = i;
+        }
+    }
+    if ((lower && upper) || separator == length || separator == 0 || length - separator - 1 < 6) {
+        return false;
+    }
+
+    size_t values = length - separator - 1;
+    if (values - 6 > data_size) {
+        return false;
+    }
+
+    uint32_t checksum = hrp_polymod(encoded, separator);
+    for (size_t i = 0; i < values; ++i) {
+        int8_t value = CHARSET_TABLE.values[static_cast<uint8_t>(encoded[separator + 1 + i])];
+        if (value < 0) {
+            return false;
+        }
+        checksum = polymod_step(checksum, static_cast<uint8_t>(value));
+        if (i < values - 6) {
+            data[i] = static_cast<uint8_t>(value);
+        }
+    }
+
+    if (checksum == BECH32_CONST) {
+        encoding = Bech32Encoding::BECH32;
+    } else if (checksum == BECH32M_CONST) {
+        encoding = Bech32Encoding::BECH32M;
+    } else {
+        return false;
+    }
+
+    hrp_length = separator;
+    written = values - 6;
+    return true;
+}
+
+// Regroup 5-bit values into bytes; leftover bits must be zero padding
+bool from_5bit(const uint8_t* values, size_t count, uint8_t* out, size_t out_size, size_t& written) {
+    uint32_t accumulator = 0;
+    int bits = 0;
+    written = 0;
+    for (size_t i = 0; i < count; ++i) {
+        accumulator = ((accumulator << 5) | values[i]) & 0xfff;
+        bits += 5;
+        if (bits >= 8) {
+            bits -= 8;
+            if (written == out_size) {
+                return false;
+            }
+            out[written++] = static_cast<uint8_t>(accumulator >> bits);
+        }
+    }
+    return bits < 5 && (accumulator & ((1u << bits) - 1)) == 0;
+}
+
+bool segwit_decode_raw(const char* address, size_t length, const char* hrp, size_t hrp_size,
+                       int& witness_version, uint8_t* program, size_t program_size,
+                       size_t& written) {
+    if (length < SEGWIT_MIN_LENGTH - 2 + hrp_size || length > SEGWIT_MAX_LENGTH - 2 + hrp_size) {
+        return false;
+    }
+
+    uint8_t values[Crypto::BECH32_MAX_LENGTH];
+    size_t count = 0;
+    size_t hrp_length = 0;
+    Bech32Encoding encoding;
+    if (!decode_raw(address, length, hrp_length, values, sizeof(values), count, encoding)) {
+        return false;
+    }
+    if (hrp_length != hrp_size || count == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < hrp_size; ++i) {
+        if (to_lower(address[i]) != hrp[i]) {
+            return false;
+        }
+    }
+
+    int version = values[0];
+    if (version > 16) {
+        return false;
+    }
+    if ((version == 0) != (encoding == Bech32Encoding::BECH32)) {
+        return false;
+    }
+
+    uint8_t decoded[WITNESS_PROGRAM_MAX];
+    size_t decoded_size = 0;
+    if (!from_5bit(values + 1, count - 1, decoded, sizeof(decoded), decoded_size)) {
+        return false;
+    }
+    if (decoded_size < 2 || (version == 0 && decoded_size != 20 && decoded_size != 32)) {
+        return false;
+    }
+    if (decoded_size > program_size) {
+        return false;
+    }
+
+    std::memcpy(program, decoded, decoded_size);
+    witness_version = version;
+    written = decoded_size;
+    return true;
+}
+
+} // namespace
+
+std::string Crypto::bech32_encode(const std::string& hrp, const uint8_t* data, size_t size,
+                                  Bech32Encoding encoding) {
+    if (hrp.empty() || hrp.size() + 1 + size + 6 > BECH32_MAX_LENGTH) {
+        throw WalletError::crypto("Bech32 string too long");
+    }
+
+    std::string result;
+    result.reserve(hrp.size() + 1 + size + 6);
+    for (char c : hrp) {
+        result += to_lower(c);
+    }
+    result += '1';
+
+    uint32_t checksum = hrp_polymod(hrp.data(), hrp.size());
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] > 31) {
+            throw WalletError::crypto("Bech32 data value out of range");
+        }
+        checksum = polymod_step(checksum, data[i]);
+        result += BECH32_CHARSET[data[i]];
+    }
+    for (int i = 0; i < 6; ++i) {
+        checksum = polymod_step(checksum, 0);
+    }
+
+    checksum ^= encoding_constant(encoding);
+    for (int i = 0; i < 6; ++i) {
+        result += BECH32_CHARSET[(checksum >> (5 * (5 - i))) & 31];
+    }
+    return result;
+}
+
+bool Crypto::bech32_decode(const std::string& encoded, std::string& hrp, uint8_t* data,
+                           size_t data_size, size_t& written, Bech32Encoding& encoding) {
+    size_t hrp_length = 0;
+    if (!decode_raw(encoded.data(), encoded.size(), hrp_length, data, data_size, written, encoding)) {
+        return false;
+    }
+    hrp.assign(encoded, 0, hrp_length);
+    for (auto& c : hrp) {
+        c = to_lower(c);
+    }
+    return true;
+}
+
+std::string Crypto::segwit_address_encode(const std::string& hrp, int witness_version,
+                                          const uint8_t* program, size_t size) {
+    if (witness_version < 0 || witness_version > 16 || size < 2 || size > WITNESS_PROGRAM_MAX ||
+        (witness_version == 0 && size != 20 && size != 32)) {
+        throw WalletError::crypto("Invalid witness program");
+    }
+
+    // Version, then the program regrouped into 5-bit values with padding
+    uint8_t values[1 + (WITNESS_PROGRAM_MAX * 8 + 4) / 5];
+    size_t count = 0;
+    values[count++] = static_cast<uint8_t>(witness_version);
+    uint32_t accumulator = 0;
+    int bits = 0;
+    for (size_t i = 0; i < size; ++i) {
+        accumulator = ((accumulator << 8) | program[i]) & 0xfff;
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            values[count++] = (accumulator >> bits) & 31;
+        }
+    }
+    if (bits > 0) {
+        values[count++] = (accumulator << (5 - bits)) & 31;
+    }
+
+    auto encoding = witness_version == 0 ? Bech32Encoding::BECH32 : Bech32Encoding::BECH32M;
+    return bech32_encode(hrp, values, count, encoding);
+}
+
+bool Crypto::segwit_address_decode(const std::string& address, const std::string& hrp,
+                                   int& witness_version, uint8_t* program,
+                                   size_t program_size, size_t& written) {
+    return segwit_decode_raw(address.data(), address.size(), hrp.data(), hrp.size(),
+                             witness_version, program, program_size, written);
+}
+
+std::string Crypto::public_key_to_segwit_address(
+    const std::vector<uint8_t>& public_key,
+    const std::string& network
+) {
+    if (public_key.size() != 33) {
+        throw WalletError::crypto("SegWit addresses need a compressed public key");
+    }
+    auto program = hash160(public_key.data(), public_key.size());
+    return segwit_address_encode(network == "mainnet" ? "bc" : "tb", 0, program.data(), program.size());
+}
+
+} // namespace crypto_wallet
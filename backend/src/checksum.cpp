@@ -0,0 +1,67 @@
+#include "checksum.h"
+#include <cstring>
+
+#if defined(__x86_64__)
+#define CRYPTO_WALLET_CRC32C_X86 1
+#include <immintrin.h>
+#endif
+
+namespace crypto_wallet {
+
+struct Crc32cTable {
+    uint32_t values[256];
+
+    constexpr Crc32cTable() : values() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82f63b78 & (0u - (crc & 1)));
+            }
+            values[i] = crc;
+        }
+    }
+};
+
+static constexpr Crc32cTable CRC32C_TABLE;
+
+static uint32_t crc32c_portable(uint32_t crc, const uint8_t* data, size_t size) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = CRC32C_TABLE.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#ifdef CRYPTO_WALLET_CRC32C_X86
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t size) {
+    uint64_t state = ~crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        state = _mm_crc32_u64(state, word);
+        data += 8;
+        size -= 8;
+    }
+    uint32_t tail = static_cast<uint32_t>(state);
+    while (size > 0) {
+        tail = _mm_crc32_u8(tail, *data++);
+        --size;
+    }
+    return ~tail;
+}
+
+#endif
+
+uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t size) {
+#ifdef CRYPTO_WALLET_CRC32C_X86
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware) {
+        return crc32c_sse42(crc, data, size);
+    }
+#endif
+    return crc32c_portable(crc, data, size);
+}
+
+} // namespace crypto_wallet
@@ -0,0 +1,104 @@
+#include "circuit_breaker.h"
+#include <algorithm>
+
+namespace crypto_wallet {
+
+static constexpr uint8_t OUTCOME_FAILED = 1;
+static constexpr uint8_t OUTCOME_SLOW = 2;
+
+CircuitBreaker::CircuitBreaker(const CircuitBreakerOptions& options)
+    : options_(options),
+      state_(BreakerState::Closed),
+      probe_in_flight_(false),
+      outcomes_(std::max<size_t>(options.window, 1), 0),
+      next_(0),
+      count_(0),
+      failures_(0),
+      slow_(0) {}
+
+bool CircuitBreaker::try_acquire(Clock::time_point now, bool& probe) {
+    probe = false;
+    switch (state_) {
+    case BreakerState::Closed:
+        return true;
+    case BreakerState::Open:
+        if (now - opened_at_ < options_.open_for) {
+            return false;
+        }
+        state_ = BreakerState::HalfOpen;
+        probe_in_flight_ = false;
+        break;
+    case BreakerState::HalfOpen:
+        break;
+    }
+    if (probe_in_flight_) {
+        return false;
+    }
+    probe_in_flight_ = true;
+    probe = true;
+    return true;
+}
+
+void CircuitBreaker::record(bool failed, std::chrono::milliseconds latency, Clock::time_point now) {
+    bool slow = latency >= options_.slow_call;
+
+    if (state_ == BreakerState::HalfOpen) {
+        probe_in_flight_ = false;
+        if (failed || slow) {
+            open(now);
+        } else {
+            state_ = BreakerState::Closed;
+            reset_window();
+        }
+        return;
+    }
+    if (state_ == BreakerState::Open) {
+        // A call admitted before the breaker opened
+        return;
+    }
+
+    uint8_t& slot = outcomes_[next_];
+    if (count_ == outcomes_.size()) {
+        failures_ -= (slot & OUTCOME_FAILED) ? 1 : 0;
+        slow_ -= (slot & OUTCOME_SLOW) ? 1 : 0;
+    } else {
+        ++count_;
+    }
+    slot = (failed ? OUTCOME_FAILED : 0) | (slow ? OUTCOME_SLOW : 0);
+    failures_ += failed ? 1 : 0;
+    slow_ += slow ? 1 : 0;
+    next_ = (next_ + 1) % outcomes_.size();
+
+    if (count_ >= options_.min_calls &&
+        (failures_ >= options_.failure_threshold * count_ || slow_ >= options_.slow_threshold * count_)) {
+        open(now);
+    }
+}
+
+void CircuitBreaker::abandon() {
+    probe_in_flight_ = false;
+}
+
+BreakerState CircuitBreaker::state(Clock::time_point now) const {
+    if (state_ == BreakerState::Open && now - opened_at_ >= options_.open_for) {
+        return BreakerState::HalfOpen;
+    }
+    return state_;
+}
+
+void CircuitBreaker::open(Clock::time_point now) {
+    state_ = BreakerState::Open;
+    opened_at_ = now;
+    probe_in_flight_ = false;
+    reset_window();
+}
+
+void CircuitBreaker::reset_window() {
+    std::fill(outcomes_.begin(), outcomes_.end(), 0);
+    next_ = 0;
+    count_ = 0;
+    failures_ = 0;
+    slow_ = 0;
+}
+
+} // namespace crypto_wallet
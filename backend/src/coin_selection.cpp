@@ -0,0 +1,223 @@
+#include "coin_selection.h"
+#include <algorithm>
+#include <random>
+#include <limits>
+
+namespace crypto_wallet {
+
+// Indexes of the coins worth spending, largest effective value first
+static std::vector<size_t> spendable_by_value(const std::vector<CoinCandidate>& coins) {
+    std::vector<size_t> order;
+    order.reserve(coins.size());
+    for (size_t i = 0; i < coins.size(); ++i) {
+        if (coins[i].effective_value() > 0) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&coins](size_t a, size_t b) {
+        return coins[a].effective_value() > coins[b].effective_value();
+    });
+    return order;
+}
+
+static void fill_result(const std::vector<CoinCandidate>& coins, std::vector<size_t> selected,
+                        SelectionAlgorithm algorithm, bool change, CoinSelection& result) {
+    std::sort(selected.begin(), selected.end());
+    result.selected = std::move(selected);
+    result.value = 0;
+    result.fee = 0;
+    for (size_t i : result.selected) {
+        result.value += coins[i].value;
+        result.fee += coins[i].fee;
+    }
+    result.algorithm = algorithm;
+    result.change = change;
+}
+
+bool select_coins_bnb(const std::vector<CoinCandidate>& coins, const CoinSelectionParams& params,
+                      CoinSelection& result) {
+    std::vector<size_t> order = spendable_by_value(coins);
+    auto amount = [&](size_t position) { return static_cast<uint64_t>(coins[order[position]].effective_value()); };
+    auto waste_of = [&](size_t position) {
+        const CoinCandidate& coin = coins[order[position]];
+        return static_cast<int64_t>(coin.fee) - static_cast<int64_t>(coin.long_term_fee);
+    };
+
+    uint64_t available = 0;
+    for (size_t position = 0; position < order.size(); ++position) {
+        available += amount(position);
+    }
+    if (available < params.target) {
+        return false;
+    }
+
+    // Depth-first over include/exclude decisions in `order`, inclusion
+    // first. `current` holds the included positions.
+    std::vector<size_t> current;
+    std::vector<size_t> best;
+    uint64_t value = 0;
+    int64_t waste = 0;
+    int64_t best_waste = std::numeric_limits<int64_t>::max();
+    // With fees above the long-term rate every extra input adds waste, so
+    // a branch already worse than the best cannot recover
+    bool fees_high = !order.empty() && waste_of(0) > 0;
+
+    size_t position = 0;
+    for (size_t tries = 0; tries < params.max_tries; ++tries, ++position) {
+        bool backtrack = false;
+        if (value + available < params.target || value > params.target + params.cost_of_change ||
+            (fees_high && waste > best_waste)) {
+            backtrack = true;
+        } else if (value >= params.target) {
+            int64_t total_waste = waste + static_cast<int64_t>(value - params.target);
+            if (total_waste <= best_waste) {
+                best = current;
+                best_waste = total_waste;
+            }
+            backtrack = true;
+        }
+
+        if (backtrack) {
+            if (current.empty()) {
+                break;  // Searched everything
+            }
+            // Give back the coins skipped since the last inclusion, then
+            // try that branch without it
+            for (--position; position > current.back(); --position) {
+                available += amount(position);
+            }
+            value -= amount(position);
+            waste -= waste_of(position);
+            current.pop_back();
+        } else {
+            available -= amount(position);
+            // Excluding a coin equal to the one just excluded reaches the
+            // same subsets again, so only include it if that one was kept
+            if (current.empty() || position - 1 == current.back() || amount(position) != amount(position - 1) ||
+                waste_of(position) != waste_of(position - 1)) {
+                current.push_back(position);
+                value += amount(position);
+                waste += waste_of(position);
+            }
+        }
+    }
+
+    if (best.empty()) {
+        return false;
+    }
+    std::vector<size_t> selected;
+    for (size_t chosen : best) {
+        selected.push_back(order[chosen]);
+    }
+    fill_result(coins, std::move(selected), SelectionAlgorithm::BranchAndBound, false, result);
+    return true;
+}
+
+// Random subsets of `values` (largest first) reaching `goal`, keeping the
+// smallest total; each pass adds coins at random, then the rest in order
+static uint64_t approximate_best_subset(const std::vector<uint64_t>& values, uint64_t total, uint64_t goal,
+                                        size_t iterations, std::mt19937_64& rng, std::vector<bool>& best) {
+    best.assign(values.size(), true);
+    uint64_t best_total = total;
+    std::vector<bool> included;
+    std::bernoulli_distribution coin_flip(0.5);
+
+    for (size_t rep = 0; rep < iterations && best_total != goal; ++rep) {
+        included.assign(values.size(), false);
+        uint64_t sum = 0;
+        bool reached = false;
+        for (int pass = 0; pass < 2 && !reached; ++pass) {
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (pass == 0 ? !coin_flip(rng) : included[i]) {
+                    continue;
+                }
+                sum += values[i];
+                included[i] = true;
+                if (sum >= goal) {
+                    reached = true;
+                    if (sum < best_total) {
+                        best_total = sum;
+                        best = included;
+                    }
+                    // Look for a smaller coin to finish with instead
+                    sum -= values[i];
+                    included[i] = false;
+                }
+            }
+        }
+    }
+    return best_total;
+}
+
+bool select_coins_knapsack(const std::vector<CoinCandidate>& coins, const CoinSelectionParams& params,
+                           CoinSelection& result) {
+    std::vector<size_t> order = spendable_by_value(coins);
+    uint64_t target = params.target;
+    uint64_t goal = target + params.change_fee + params.min_change;
+    auto amount = [&coins](size_t i) { return static_cast<uint64_t>(coins[i].effective_value()); };
+
+    std::vector<size_t> smaller;
+    std::vector<uint64_t> smaller_values;
+    uint64_t total_lower = 0;
+    size_t lowest_larger = coins.size();
+    for (size_t i : order) {
+        if (amount(i) == target) {
+            fill_result(coins, {i}, SelectionAlgorithm::Knapsack, false, result);
+            return true;
+        }
+        if (amount(i) < goal) {
+            smaller.push_back(i);
+            smaller_values.push_back(amount(i));
+            total_lower += amount(i);
+        } else {
+            lowest_larger = i;  // order is descending
+        }
+    }
+    bool has_larger = lowest_larger != coins.size();
+
+    if (total_lower == target) {
+        fill_result(coins, smaller, SelectionAlgorithm::Knapsack, false, result);
+        return true;
+    }
+    if (total_lower < target) {
+        if (!has_larger) {
+            return false;
+        }
+        fill_result(coins, {lowest_larger}, SelectionAlgorithm::Knapsack, true, result);
+        return true;
+    }
+
+    std::random_device seed;
+    std::mt19937_64 rng(seed());
+    std::vector<bool> best;
+    uint64_t best_total =
+        approximate_best_subset(smaller_values, total_lower, target, params.knapsack_iterations, rng, best);
+    if (best_total != target && total_lower >= goal) {
+        best_total = approximate_best_subset(smaller_values, total_lower, goal, params.knapsack_iterations, rng, best);
+    }
+
+    // One larger coin beats a subset that misses the change goal or is no
+    // smaller than it
+    if (has_larger && ((best_total != target && best_total < goal) || amount(lowest_larger) <= best_total)) {
+        fill_result(coins, {lowest_larger}, SelectionAlgorithm::Knapsack, true, result);
+        return true;
+    }
+    std::vector<size_t> selected;
+    for (size_t i = 0; i < smaller.size(); ++i) {
+        if (best[i]) {
+            selected.push_back(smaller[i]);
+        }
+    }
+    fill_result(coins, std::move(selected), SelectionAlgorithm::Knapsack, best_total >= goal, result);
+    return true;
+}
+
+CoinSelection select_coins(const std::vector<CoinCandidate>& coins, const CoinSelectionParams& params) {
+    CoinSelection result;
+    if (select_coins_bnb(coins, params, result) || select_coins_knapsack(coins, params, result)) {
+        return result;
+    }
+    throw WalletError::insufficient_funds();
+}
+
+} // namespace crypto_wallet
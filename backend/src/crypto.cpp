@@ -1,63 +1,582 @@
 #include "crypto.h"
-#include <openssl/sha.h>
-#include <openssl/ripemd.h>
+#include "thread_pool.h"
+#include "bip39_english.h"
 #include <openssl/ec.h>
 #include <openssl/ecdsa.h>
 #include <openssl/obj_mac.h>
 #include <openssl/rand.h>
 #include <openssl/bn.h>
 #include <openssl/evp.h>
-#include <random>
+#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+#ifdef HAVE_SECP256K1
+#include <secp256k1.h>
+#include <secp256k1_extrakeys.h>
+#include <secp256k1_schnorrsig.h>
+#endif
 #include <sstream>
+#include <cstdlib>
 #include <iomanip>
 #include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 namespace crypto_wallet {
 
 // Base58 alphabet
-const std::string BASE58_ALPHABET = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+static constexpr char BASE58_ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// Character -> digit, -1 for characters outside the alphabet
+struct Base58DecodeTable {
+    int8_t digits[256];
+
+    constexpr Base58DecodeTable() : digits() {
+        for (int i = 0; i < 256; ++i) {
+            digits[i] = -1;
+        }
+        for (int i = 0; i < 58; ++i) {
+            digits[static_cast<uint8_t>(BASE58_ALPHABET[i])] = static_cast<int8_t>(i);
+        }
+    }
+};
+
+static constexpr Base58DecodeTable BASE58_DECODE{};
+
+// The codec works on 32-bit binary limbs and base 58^5 limbs, so each inner
+// step converts four bytes or five digits at once
+static constexpr uint32_t BASE58_POW5 = 58u * 58u * 58u * 58u * 58u;
+static constexpr uint32_t BASE58_POWERS[6] = {1, 58, 58 * 58, 58 * 58 * 58, 58u * 58u * 58u * 58u, BASE58_POW5};
+
+// Limb scratch space lives on the stack for anything address sized
+static constexpr size_t BASE58_STACK_LIMBS = 64;
+
+#ifdef HAVE_SECP256K1
+
+// One context for the whole process. Creating it sets up the generator
+// multiplication tables and randomizing it enables scalar blinding; after
+// that it is only read, so every thread can sign and verify through it.
+static const secp256k1_context* secp_context() {
+    static secp256k1_context* context = [] {
+        secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+        std::array<uint8_t, 32> seed{};
+        if (RAND_bytes(seed.data(), 32) == 1) {
+            secp256k1_context_randomize(ctx, seed.data());
+        }
+        OPENSSL_cleanse(seed.data(), seed.size());
+        return ctx;
+    }();
+    return context;
+}
+
+static bool is_valid_secret_key(const std::array<uint8_t, 32>& secret_key) {
+    return secp256k1_ec_seckey_verify(secp_context(), secret_key.data()) == 1;
+}
+
+#else
+
+// Fallback when libsecp256k1 is unavailable: the same algorithms (RFC6979
+// ECDSA with low-S, BIP340 Schnorr) on OpenSSL's secp256k1 group, so both
+// builds produce interchangeable keys and signatures.
+
+using BnPtr = std::unique_ptr<BIGNUM, decltype(&BN_clear_free)>;
+using BnCtxPtr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
+using PointPtr = std::unique_ptr<EC_POINT, decltype(&EC_POINT_free)>;
+
+struct Secp256k1Curve {
+    EC_GROUP* group;
+    BIGNUM* order;
+    BIGNUM* half_order;
+    BIGNUM* field;
+};
+
+// Built once and then shared read-only by all threads
+static const Secp256k1Curve& curve() {
+    static const Secp256k1Curve instance = [] {
+        Secp256k1Curve c{};
+        c.group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+        c.order = BN_new();
+        c.half_order = BN_new();
+        c.field = BN_new();
+        EC_GROUP_get_order(c.group, c.order, nullptr);
+        EC_GROUP_get_curve(c.group, c.field, nullptr, nullptr, nullptr);
+        BN_rshift1(c.half_order, c.order);
+        return c;
+    }();
+    return instance;
+}
+
+static BnPtr new_bn(const uint8_t* bytes = nullptr) {
+    BIGNUM* bn = bytes ? BN_bin2bn(bytes, 32, nullptr) : BN_new();
+    if (!bn) {
+        throw WalletError::crypto("Failed to allocate big number");
+    }
+    return BnPtr(bn, BN_clear_free);
+}
+
+static BnCtxPtr new_bn_ctx() {
+    BN_CTX* ctx = BN_CTX_new();
+    if (!ctx) {
+        throw WalletError::crypto("Failed to allocate big number context");
+    }
+    return BnCtxPtr(ctx, BN_CTX_free);
+}
+
+static PointPtr new_point() {
+    EC_POINT* point = EC_POINT_new(curve().group);
+    if (!point) {
+        throw WalletError::crypto("Failed to allocate curve point");
+    }
+    return PointPtr(point, EC_POINT_free);
+}
+
+static bool in_scalar_range(const BIGNUM* k) {
+    return !BN_is_zero(k) && BN_cmp(k, curve().order) < 0;
+}
+
+static bool is_valid_secret_key(const std::array<uint8_t, 32>& secret_key) {
+    auto d = new_bn(secret_key.data());
+    return in_scalar_range(d.get());
+}
+
+static BnPtr secret_scalar(const std::array<uint8_t, 32>& secret_key) {
+    auto d = new_bn(secret_key.data());
+    if (!in_scalar_range(d.get())) {
+        throw WalletError::crypto("Invalid secret key");
+    }
+    return d;
+}
+
+static PointPtr generator_mul(const BIGNUM* k, BN_CTX* ctx) {
+    auto point = new_point();
+    if (EC_POINT_mul(curve().group, point.get(), k, nullptr, nullptr, ctx) != 1) {
+        throw WalletError::crypto("Curve multiplication failed");
+    }
+    return point;
+}
+
+// Affine x as 32 bytes; returns whether y is even
+static bool point_x_bytes(const EC_POINT* point, uint8_t* x_out, BN_CTX* ctx) {
+    auto x = new_bn();
+    auto y = new_bn();
+    if (EC_POINT_get_affine_coordinates(curve().group, point, x.get(), y.get(), ctx) != 1) {
+        throw WalletError::crypto("Failed to read curve point");
+    }
+    BN_bn2binpad(x.get(), x_out, 32);
+    return !BN_is_odd(y.get());
+}
+
+static std::array<uint8_t, 32> hmac_sha256(const std::array<uint8_t, 32>& key,
+                                           const std::vector<uint8_t>& data) {
+    std::array<uint8_t, 32> out{};
+    unsigned int out_len = 0;
+    HMAC(EVP_sha256(), key.data(), 32, data.data(), data.size(), out.data(), &out_len);
+    return out;
+}
+
+// RFC6979 HMAC-DRBG seeded with (secret, hash mod n), as libsecp256k1 does
+class Rfc6979Nonce {
+public:
+    Rfc6979Nonce(const std::array<uint8_t, 32>& secret_key, const std::array<uint8_t, 32>& hash) {
+        v_.fill(0x01);
+        k_.fill(0x00);
+        for (uint8_t round = 0; round < 2; ++round) {
+            std::vector<uint8_t> data(v_.begin(), v_.end());
+            data.push_back(round);
+            data.insert(data.end(), secret_key.begin(), secret_key.end());
+            data.insert(data.end(), hash.begin(), hash.end());
+            k_ = hmac_sha256(k_, data);
+            v_ = hmac_sha256(k_, std::vector<uint8_t>(v_.begin(), v_.end()));
+            OPENSSL_cleanse(data.data(), data.size());
+        }
+    }
+
+    ~Rfc6979Nonce() {
+        OPENSSL_cleanse(k_.data(), k_.size());
+        OPENSSL_cleanse(v_.data(), v_.size());
+    }
+
+    std::array<uint8_t, 32> next() {
+        if (retry_) {
+            std::vector<uint8_t> data(v_.begin(), v_.end());
+            data.push_back(0x00);
+            k_ = hmac_sha256(k_, data);
+            v_ = hmac_sha256(k_, std::vector<uint8_t>(v_.begin(), v_.end()));
+        }
+        retry_ = true;
+        v_ = hmac_sha256(k_, std::vector<uint8_t>(v_.begin(), v_.end()));
+        return v_;
+    }
+
+private:
+    std::array<uint8_t, 32> k_;
+    std::array<uint8_t, 32> v_;
+    bool retry_ = false;
+};
+
+static std::array<uint8_t, 32> tagged_hash(const std::string& tag, const std::vector<uint8_t>& data) {
+    auto tag_hash = Crypto::sha256(reinterpret_cast<const uint8_t*>(tag.data()), tag.size());
+    Sha256Ctx hasher;
+    hasher.update(tag_hash.data(), tag_hash.size());
+    hasher.update(tag_hash.data(), tag_hash.size());
+    hasher.update(data.data(), data.size());
+    return hasher.final();
+}
+
+// tagged_hash("BIP0340/challenge", r_x || p_x || message) without building
+// the preimage; verification runs this for every signature
+static std::array<uint8_t, 32> challenge_hash(const uint8_t* r_x, const uint8_t* p_x,
+                                              const uint8_t* message) {
+    static const std::string tag = "BIP0340/challenge";
+    static const auto tag_hash = Crypto::sha256(reinterpret_cast<const uint8_t*>(tag.data()), tag.size());
+    
+    thread_local Sha256Ctx hasher;
+    hasher.init();
+    hasher.update(tag_hash.data(), tag_hash.size());
+    hasher.update(tag_hash.data(), tag_hash.size());
+    hasher.update(r_x, 32);
+    hasher.update(p_x, 32);
+    hasher.update(message, 32);
+    return hasher.final();
+}
+
+static BnPtr challenge_scalar(const uint8_t* r_x, const uint8_t* p_x,
+                              const uint8_t* message, BN_CTX* ctx) {
+    auto e_bytes = challenge_hash(r_x, p_x, message);
+    auto e = new_bn(e_bytes.data());
+    BN_nnmod(e.get(), e.get(), curve().order, ctx);
+    return e;
+}
+
+#endif
+
+// Split a mnemonic into word indexes, tolerating repeated whitespace.
+// Returns false on an unknown word.
+static bool mnemonic_word_indexes(const std::string& mnemonic, std::vector<uint16_t>& indexes) {
+    std::istringstream words(mnemonic);
+    std::string word;
+    while (words >> word) {
+        auto it = std::lower_bound(std::begin(BIP39_ENGLISH), std::end(BIP39_ENGLISH), word,
+                                   [](const char* entry, const std::string& value) { return value.compare(entry) > 0; });
+        if (it == std::end(BIP39_ENGLISH) || word != *it) {
+            return false;
+        }
+        indexes.push_back(static_cast<uint16_t>(it - std::begin(BIP39_ENGLISH)));
+    }
+    return true;
+}
 
 std::string Crypto::generate_mnemonic() {
     // Generate 128 bits of entropy
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
+    uint8_t entropy[16];
+    if (RAND_bytes(entropy, sizeof(entropy)) != 1) {
+        throw WalletError::crypto("Failed to generate mnemonic entropy");
+    }
+    
+    auto mnemonic = entropy_to_mnemonic(entropy, sizeof(entropy));
+    OPENSSL_cleanse(entropy, sizeof(entropy));
+    return mnemonic;
+}
+
+std::string Crypto::entropy_to_mnemonic(const uint8_t* entropy, size_t size) {
+    if (size < 16 || size > 32 || size % 4 != 0) {
+        throw WalletError::crypto("Mnemonic entropy must be 16-32 bytes in steps of 4");
+    }
+    
+    // Entropy followed by its checksum: the first size / 4 bits of SHA256
+    uint8_t bits[33];
+    std::copy(entropy, entropy + size, bits);
+    bits[size] = sha256(entropy, size)[0];
+    
+    size_t word_count = (size * 8 + size / 4) / 11;
+    std::string mnemonic;
+    for (size_t w = 0; w < word_count; ++w) {
+        uint32_t index = 0;
+        for (size_t b = w * 11; b < w * 11 + 11; ++b) {
+            index = (index << 1) | ((bits[b / 8] >> (7 - b % 8)) & 1);
+        }
+        if (w > 0) {
+            mnemonic += ' ';
+        }
+        mnemonic += BIP39_ENGLISH[index];
+    }
+    
+    OPENSSL_cleanse(bits, sizeof(bits));
+    return mnemonic;
+}
+
+bool Crypto::validate_mnemonic(const std::string& mnemonic) {
+    std::vector<uint16_t> indexes;
+    if (!mnemonic_word_indexes(mnemonic, indexes)) {
+        return false;
+    }
+    
+    size_t word_count = indexes.size();
+    if (word_count < 12 || word_count > 24 || word_count % 3 != 0) {
+        return false;
+    }
     
-    std::vector<uint8_t> entropy(16);
-    for (auto& byte : entropy) {
-        byte = dis(gen);
+    uint8_t bits[33] = {};
+    for (size_t w = 0; w < word_count; ++w) {
+        for (size_t k = 0; k < 11; ++k) {
+            size_t b = w * 11 + k;
+            if ((indexes[w] >> (10 - k)) & 1) {
+                bits[b / 8] |= static_cast<uint8_t>(0x80 >> (b % 8));
+            }
+        }
     }
     
-    // For simplicity, return a mock mnemonic
-    // In a real implementation, you'd use BIP39 wordlist
-    return "abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon abandon about";
+    size_t checksum_bits = word_count / 3;
+    size_t entropy_size = (word_count * 11 - checksum_bits) / 8;
+    uint8_t expected = sha256(bits, entropy_size)[0] >> (8 - checksum_bits);
+    uint8_t actual = bits[entropy_size] >> (8 - checksum_bits);
+    OPENSSL_cleanse(bits, sizeof(bits));
+    return expected == actual;
 }
 
-std::array<uint8_t, 64> Crypto::mnemonic_to_seed(const std::string& mnemonic) {
-    // Simplified implementation - in reality you'd use PBKDF2 with BIP39
-    std::array<uint8_t, 64> seed{};
+std::array<uint8_t, 64> Crypto::mnemonic_to_seed(
+    const std::string& mnemonic,
+    const std::string& passphrase
+) {
+    if (!validate_mnemonic(mnemonic)) {
+        throw WalletError::invalid_seed_phrase();
+    }
+    
+    // The KDF input is the words joined by single spaces, however the
+    // phrase was typed
+    std::istringstream words(mnemonic);
+    std::string word;
+    std::string normalized;
+    while (words >> word) {
+        if (!normalized.empty()) {
+            normalized += ' ';
+        }
+        normalized += word;
+    }
+    std::string salt = "mnemonic" + passphrase;
     
-    // Use SHA256 of mnemonic as seed (simplified)
-    auto hash = sha256(std::vector<uint8_t>(mnemonic.begin(), mnemonic.end()));
-    std::copy(hash.begin(), hash.end(), seed.begin());
-    std::copy(hash.begin(), hash.end(), seed.begin() + 32);
+    std::array<uint8_t, 64> seed{};
+    int ok = PKCS5_PBKDF2_HMAC(normalized.data(), static_cast<int>(normalized.size()),
+                               reinterpret_cast<const uint8_t*>(salt.data()), static_cast<int>(salt.size()),
+                               2048, EVP_sha512(), static_cast<int>(seed.size()), seed.data());
+    OPENSSL_cleanse(&normalized[0], normalized.size());
+    OPENSSL_cleanse(&salt[0], salt.size());
+    if (ok != 1) {
+        throw WalletError::crypto("PBKDF2 seed derivation failed");
+    }
     
     return seed;
 }
 
+static void hmac_sha512(const uint8_t* key, size_t key_size, const uint8_t* data, size_t size, uint8_t* out) {
+    unsigned int out_len = 0;
+    if (!HMAC(EVP_sha512(), key, static_cast<int>(key_size), data, size, out, &out_len)) {
+        throw WalletError::crypto("HMAC-SHA512 failed");
+    }
+}
+
+// out = (secret + tweak) mod n; false if tweak >= n or the sum is zero
+static bool add_secret_keys(const std::array<uint8_t, 32>& secret, const uint8_t* tweak, uint8_t* out) {
+#ifdef HAVE_SECP256K1
+    std::copy(secret.begin(), secret.end(), out);
+    return secp256k1_ec_seckey_tweak_add(secp_context(), out, tweak) == 1;
+#else
+    const auto& c = curve();
+    auto t = new_bn(tweak);
+    if (BN_cmp(t.get(), c.order) >= 0) {
+        return false;
+    }
+    auto ctx = new_bn_ctx();
+    auto k = new_bn(secret.data());
+    if (BN_mod_add(k.get(), k.get(), t.get(), c.order, ctx.get()) != 1 || BN_is_zero(k.get())) {
+        return false;
+    }
+    BN_bn2binpad(k.get(), out, 32);
+    return true;
+#endif
+}
+
+ExtendedKey ExtendedKey::from_seed(const uint8_t* seed, size_t size) {
+    static const char BIP32_KEY[] = "Bitcoin seed";
+    uint8_t i[64];
+    hmac_sha512(reinterpret_cast<const uint8_t*>(BIP32_KEY), sizeof(BIP32_KEY) - 1, seed, size, i);
+    
+    ExtendedKey master;
+    std::copy(i, i + 32, master.secret_key.begin());
+    std::copy(i + 32, i + 64, master.chain_code.begin());
+    OPENSSL_cleanse(i, sizeof(i));
+    if (!is_valid_secret_key(master.secret_key)) {
+        throw WalletError::crypto("Seed produces an invalid master key");
+    }
+    
+    auto public_key = Crypto::derive_public_key(master.secret_key);
+    std::copy(public_key.begin(), public_key.end(), master.public_key.begin());
+    master.depth = 0;
+    master.parent_fingerprint = 0;
+    master.child_number = 0;
+    return master;
+}
+
+ExtendedKey ExtendedKey::derive_child(uint32_t index) const {
+    ExtendedKey child;
+    uint8_t data[37];
+    uint8_t i[64];
+    
+    // An out-of-range tweak (probability ~2^-127) skips to the next index
+    while (true) {
+        if (index & HARDENED) {
+            data[0] = 0x00;
+            std::copy(secret_key.begin(), secret_key.end(), data + 1);
+        } else {
+            std::copy(public_key.begin(), public_key.end(), data);
+        }
+        data[33] = static_cast<uint8_t>(index >> 24);
+        data[34] = static_cast<uint8_t>(index >> 16);
+        data[35] = static_cast<uint8_t>(index >> 8);
+        data[36] = static_cast<uint8_t>(index);
+        
+        hmac_sha512(chain_code.data(), chain_code.size(), data, sizeof(data), i);
+        bool valid = add_secret_keys(secret_key, i, child.secret_key.data());
+        if (valid || (index & ~HARDENED) == ~HARDENED) {
+            if (!valid) {
+                throw WalletError::crypto("No valid child key left to derive");
+            }
+            break;
+        }
+        ++index;
+    }
+    
+    std::copy(i + 32, i + 64, child.chain_code.begin());
+    OPENSSL_cleanse(data, sizeof(data));
+    OPENSSL_cleanse(i, sizeof(i));
+    
+    auto child_public_key = Crypto::derive_public_key(child.secret_key);
+    std::copy(child_public_key.begin(), child_public_key.end(), child.public_key.begin());
+    child.depth = static_cast<uint8_t>(depth + 1);
+    child.parent_fingerprint = fingerprint();
+    child.child_number = index;
+    return child;
+}
+
+ExtendedKey ExtendedKey::derive_path(const std::string& path) const {
+    if (path.empty() || path[0] != 'm') {
+        throw WalletError::crypto("Invalid derivation path: " + path);
+    }
+    
+    ExtendedKey node = *this;
+    size_t pos = 1;
+    while (pos < path.size()) {
+        if (path[pos] != '/') {
+            throw WalletError::crypto("Invalid derivation path: " + path);
+        }
+        ++pos;
+        
+        uint64_t index = 0;
+        size_t digits = 0;
+        while (pos < path.size() && path[pos] >= '0' && path[pos] <= '9') {
+            index = index * 10 + static_cast<uint64_t>(path[pos] - '0');
+            if (index >= HARDENED) {
+                throw WalletError::crypto("Derivation index out of range: " + path);
+            }
+            ++pos;
+            ++digits;
+        }
+        if (digits == 0) {
+            throw WalletError::crypto("Invalid derivation path: " + path);
+        }
+        
+        bool hardened = pos < path.size() && (path[pos] == '\'' || path[pos] == 'h' || path[pos] == 'H');
+        if (hardened) {
+            ++pos;
+        }
+        node = node.derive_child(static_cast<uint32_t>(index) | (hardened ? HARDENED : 0));
+    }
+    
+    return node;
+}
+
+uint32_t ExtendedKey::fingerprint() const {
+    auto id = Crypto::hash160(public_key.data(), public_key.size());
+    return (static_cast<uint32_t>(id[0]) << 24) | (static_cast<uint32_t>(id[1]) << 16) |
+           (static_cast<uint32_t>(id[2]) << 8) | static_cast<uint32_t>(id[3]);
+}
+
+// LRU of derived nodes keyed by SHA256(seed || path), so seeds never sit in
+// the key set. Evicted entries are wiped.
+class NodeCache {
+public:
+    explicit NodeCache(size_t capacity) : capacity_(capacity) {}
+    
+    bool get(const std::string& key, ExtendedKey& node) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return false;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        node = it->second->second;
+        return true;
+    }
+    
+    void put(const std::string& key, const ExtendedKey& node) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        entries_.emplace_front(key, node);
+        index_[key] = entries_.begin();
+        if (entries_.size() > capacity_) {
+            auto& oldest = entries_.back();
+            OPENSSL_cleanse(oldest.second.secret_key.data(), oldest.second.secret_key.size());
+            OPENSSL_cleanse(oldest.second.chain_code.data(), oldest.second.chain_code.size());
+            index_.erase(oldest.first);
+            entries_.pop_back();
+        }
+    }
+    
+private:
+    std::mutex mutex_;
+    size_t capacity_;
+    std::list<std::pair<std::string, ExtendedKey>> entries_;
+    std::unordered_map<std::string, std::list<std::pair<std::string, ExtendedKey>>::iterator> index_;
+};
+
+ExtendedKey Crypto::derive_node_cached(
+    const std::array<uint8_t, 64>& seed,
+    const std::string& path
+) {
+    static NodeCache cache(256);
+    
+    Sha256Ctx hasher;
+    hasher.update(seed.data(), seed.size());
+    hasher.update(reinterpret_cast<const uint8_t*>(path.data()), path.size());
+    auto digest = hasher.final();
+    std::string key(reinterpret_cast<const char*>(digest.data()), digest.size());
+    
+    ExtendedKey node;
+    if (cache.get(key, node)) {
+        return node;
+    }
+    
+    node = ExtendedKey::from_seed(seed.data(), seed.size()).derive_path(path);
+    cache.put(key, node);
+    return node;
+}
+
 std::array<uint8_t, 32> Crypto::derive_key_from_seed(
     const std::array<uint8_t, 64>& seed, 
     const std::string& derivation_path
 ) {
-    // Simplified key derivation
-    std::vector<uint8_t> data(seed.begin(), seed.end());
-    data.insert(data.end(), derivation_path.begin(), derivation_path.end());
-    
-    auto hash = sha256(data);
-    std::array<uint8_t, 32> key{};
-    std::copy(hash.begin(), hash.end(), key.begin());
+    // The parent comes from the cache, leaving one derivation for the leaf
+    auto slash = derivation_path.rfind('/');
+    if (slash == std::string::npos) {
+        return derive_node_cached(seed, derivation_path).secret_key;
+    }
     
-    return key;
+    auto parent = derive_node_cached(seed, derivation_path.substr(0, slash));
+    return parent.derive_path("m" + derivation_path.substr(slash)).secret_key;
 }
 
 std::string Crypto::public_key_to_address(
@@ -65,51 +584,185 @@ std::string Crypto::public_key_to_address(
     const std::string& network
 ) {
     // Hash the public key
-    auto hash = sha256(public_key_bytes);
-    std::vector<uint8_t> hash_vec(hash.begin(), hash.end());
-    auto ripemd_hash = ripemd160(hash_vec);
+    auto ripemd_hash = hash160(public_key_bytes.data(), public_key_bytes.size());
     
     // Add network prefix
-    uint8_t version_byte = (network == "mainnet") ? 0x00 : 0x6f;
+    uint8_t payload[21];
+    payload[0] = (network == "mainnet") ? 0x00 : 0x6f;
+    std::copy(ripemd_hash.begin(), ripemd_hash.end(), payload + 1);
+    
+    return base58check_encode(payload, sizeof(payload));
+}
+
+std::vector<std::string> Crypto::public_keys_to_addresses(
+    const std::array<uint8_t, 33>* public_keys,
+    size_t count,
+    const std::string& network
+) {
+    std::vector<const uint8_t*> data(count);
+    std::vector<size_t> sizes(count);
+    std::vector<std::array<uint8_t, 32>> first(count);
+    std::vector<std::array<uint8_t, 32>> second(count);
+    
+    // HASH160: SHA256 of every key, then RIPEMD160 one by one
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = public_keys[i].data();
+        sizes[i] = public_keys[i].size();
+    }
+    sha256_many(data.data(), sizes.data(), count, first.data());
     
-    std::vector<uint8_t> address_bytes;
-    address_bytes.push_back(version_byte);
-    address_bytes.insert(address_bytes.end(), ripemd_hash.begin(), ripemd_hash.end());
+    // Version byte || key hash || checksum
+    std::vector<std::array<uint8_t, 25>> payloads(count);
+    uint8_t version = (network == "mainnet") ? 0x00 : 0x6f;
+    for (size_t i = 0; i < count; ++i) {
+        auto id = ripemd160(first[i].data(), first[i].size());
+        payloads[i][0] = version;
+        std::copy(id.begin(), id.end(), payloads[i].begin() + 1);
+        data[i] = payloads[i].data();
+        sizes[i] = 21;
+    }
     
-    // Calculate checksum
-    auto checksum = double_sha256(address_bytes);
-    address_bytes.insert(address_bytes.end(), checksum.begin(), checksum.begin() + 4);
+    // Checksum: first four bytes of SHA256(SHA256(payload))
+    sha256_many(data.data(), sizes.data(), count, first.data());
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = first[i].data();
+        sizes[i] = first[i].size();
+    }
+    sha256_many(data.data(), sizes.data(), count, second.data());
     
-    return base58_encode(address_bytes);
+    std::vector<std::string> addresses(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::copy(second[i].begin(), second[i].begin() + 4, payloads[i].begin() + 21);
+        std::string& address = addresses[i];
+        address.assign(base58_max_encoded_size(payloads[i].size()), '\0');
+        address.resize(base58_encode(payloads[i].data(), payloads[i].size(), &address[0], address.size()));
+    }
+    return addresses;
 }
 
 std::array<uint8_t, 32> Crypto::hash_message(const std::vector<uint8_t>& message) {
     return sha256(message);
 }
 
+// Verification cores on raw pointers, shared by the single and batch APIs
+
+static bool verify_ecdsa(const uint8_t* hash, const uint8_t* signature,
+                         const uint8_t* public_key, size_t public_key_len) {
+#ifdef HAVE_SECP256K1
+    secp256k1_pubkey pubkey;
+    secp256k1_ecdsa_signature sig;
+    if (secp256k1_ec_pubkey_parse(secp_context(), &pubkey, public_key, public_key_len) != 1 ||
+        secp256k1_ecdsa_signature_parse_compact(secp_context(), &sig, signature) != 1) {
+        return false;
+    }
+    return secp256k1_ecdsa_verify(secp_context(), &sig, hash, &pubkey) == 1;
+#else
+    const auto& c = curve();
+    auto ctx = new_bn_ctx();
+    
+    auto q = new_point();
+    if (public_key_len == 0 ||
+        EC_POINT_oct2point(c.group, q.get(), public_key, public_key_len, ctx.get()) != 1 ||
+        EC_POINT_is_at_infinity(c.group, q.get())) {
+        return false;
+    }
+    
+    // Like libsecp256k1, only low-S signatures are accepted
+    auto r = new_bn(signature);
+    auto s = new_bn(signature + 32);
+    if (!in_scalar_range(r.get()) || BN_is_zero(s.get()) || BN_cmp(s.get(), c.half_order) > 0) {
+        return false;
+    }
+    
+    auto z = new_bn(hash);
+    BN_nnmod(z.get(), z.get(), c.order, ctx.get());
+    
+    // X = (z / s) * G + (r / s) * Q
+    auto w = new_bn();
+    auto u1 = new_bn();
+    auto u2 = new_bn();
+    BN_mod_inverse(w.get(), s.get(), c.order, ctx.get());
+    BN_mod_mul(u1.get(), z.get(), w.get(), c.order, ctx.get());
+    BN_mod_mul(u2.get(), r.get(), w.get(), c.order, ctx.get());
+    
+    auto x_point = new_point();
+    if (EC_POINT_mul(c.group, x_point.get(), u1.get(), q.get(), u2.get(), ctx.get()) != 1 ||
+        EC_POINT_is_at_infinity(c.group, x_point.get())) {
+        return false;
+    }
+    
+    uint8_t x_bytes[32];
+    point_x_bytes(x_point.get(), x_bytes, ctx.get());
+    auto x = new_bn(x_bytes);
+    BN_nnmod(x.get(), x.get(), c.order, ctx.get());
+    return BN_cmp(x.get(), r.get()) == 0;
+#endif
+}
+
+static bool verify_schnorr(const uint8_t* message, const uint8_t* signature,
+                           const uint8_t* public_key) {
+#ifdef HAVE_SECP256K1
+    secp256k1_xonly_pubkey xonly;
+    if (secp256k1_xonly_pubkey_parse(secp_context(), &xonly, public_key) != 1) {
+        return false;
+    }
+    return secp256k1_schnorrsig_verify(secp_context(), signature, message, 32, &xonly) == 1;
+#else
+    const auto& c = curve();
+    auto ctx = new_bn_ctx();
+    
+    // P = lift_x(public_key), the point with that x and even y
+    auto px = new_bn(public_key);
+    auto p = new_point();
+    if (BN_cmp(px.get(), c.field) >= 0 ||
+        EC_POINT_set_compressed_coordinates(c.group, p.get(), px.get(), 0, ctx.get()) != 1) {
+        return false;
+    }
+    
+    auto r = new_bn(signature);
+    auto s = new_bn(signature + 32);
+    if (BN_cmp(r.get(), c.field) >= 0 || BN_cmp(s.get(), c.order) >= 0) {
+        return false;
+    }
+    
+    // R = s * G - e * P must have even y and x == r
+    auto e = challenge_scalar(signature, public_key, message, ctx.get());
+    if (!BN_is_zero(e.get())) {
+        BN_sub(e.get(), c.order, e.get());
+    }
+    auto r_point = new_point();
+    if (EC_POINT_mul(c.group, r_point.get(), s.get(), p.get(), e.get(), ctx.get()) != 1 ||
+        EC_POINT_is_at_infinity(c.group, r_point.get())) {
+        return false;
+    }
+    
+    uint8_t r_x[32];
+    if (!point_x_bytes(r_point.get(), r_x, ctx.get())) {
+        return false;
+    }
+    return std::equal(r_x, r_x + 32, signature);
+#endif
+}
+
 std::pair<std::array<uint8_t, 32>, std::vector<uint8_t>> Crypto::generate_keypair() {
     std::array<uint8_t, 32> secret_key{};
-    RAND_bytes(secret_key.data(), 32);
     
-    // Generate public key from secret key (simplified)
-    std::vector<uint8_t> public_key(33);
-    public_key[0] = 0x02; // Compressed public key prefix
-    std::copy(secret_key.begin(), secret_key.end(), public_key.begin() + 1);
+    // Rejection-sample until the key lies in [1, n-1]
+    do {
+        if (RAND_bytes(secret_key.data(), 32) != 1) {
+            throw WalletError::crypto("Failed to generate random secret key");
+        }
+    } while (!is_valid_secret_key(secret_key));
     
-    return {secret_key, public_key};
+    return {secret_key, derive_public_key(secret_key)};
 }
 
 std::vector<uint8_t> Crypto::sign_message(
     const std::vector<uint8_t>& message, 
     const std::array<uint8_t, 32>& secret_key
 ) {
-    // Simplified signature - in reality you'd use ECDSA
-    auto hash = sha256(message);
-    std::vector<uint8_t> signature(64);
-    std::copy(hash.begin(), hash.end(), signature.begin());
-    std::copy(secret_key.begin(), secret_key.end(), signature.begin() + 32);
-    
-    return signature;
+    auto signature = sign_hash(sha256(message), secret_key);
+    return std::vector<uint8_t>(signature.begin(), signature.end());
 }
 
 bool Crypto::verify_signature(
@@ -117,9 +770,468 @@ bool Crypto::verify_signature(
     const std::vector<uint8_t>& signature,
     const std::vector<uint8_t>& public_key
 ) {
-    // Simplified verification
-    auto hash = sha256(message);
-    return std::equal(hash.begin(), hash.end(), signature.begin());
+    if (signature.size() != 64) {
+        return false;
+    }
+    
+    std::array<uint8_t, 64> compact{};
+    std::copy(signature.begin(), signature.end(), compact.begin());
+    return verify_hash(sha256(message), compact, public_key);
+}
+
+std::vector<uint8_t> Crypto::derive_public_key(const std::array<uint8_t, 32>& secret_key) {
+    std::vector<uint8_t> public_key(33);
+    
+#ifdef HAVE_SECP256K1
+    secp256k1_pubkey pubkey;
+    if (secp256k1_ec_pubkey_create(secp_context(), &pubkey, secret_key.data()) != 1) {
+        throw WalletError::crypto("Invalid secret key");
+    }
+    size_t length = public_key.size();
+    secp256k1_ec_pubkey_serialize(secp_context(), public_key.data(), &length, &pubkey, SECP256K1_EC_COMPRESSED);
+#else
+    auto ctx = new_bn_ctx();
+    auto d = secret_scalar(secret_key);
+    auto point = generator_mul(d.get(), ctx.get());
+    EC_POINT_point2oct(curve().group, point.get(), POINT_CONVERSION_COMPRESSED,
+                       public_key.data(), public_key.size(), ctx.get());
+#endif
+    
+    return public_key;
+}
+
+std::array<uint8_t, 64> Crypto::sign_hash(
+    const std::array<uint8_t, 32>& hash,
+    const std::array<uint8_t, 32>& secret_key
+) {
+    std::array<uint8_t, 64> signature{};
+    
+#ifdef HAVE_SECP256K1
+    secp256k1_ecdsa_signature sig;
+    if (secp256k1_ecdsa_sign(secp_context(), &sig, hash.data(), secret_key.data(), nullptr, nullptr) != 1) {
+        throw WalletError::crypto("Invalid secret key");
+    }
+    secp256k1_ecdsa_signature_serialize_compact(secp_context(), signature.data(), &sig);
+#else
+    const auto& c = curve();
+    auto ctx = new_bn_ctx();
+    auto d = secret_scalar(secret_key);
+    
+    // The digest is reduced mod n both as the message scalar and as the nonce seed
+    auto z = new_bn(hash.data());
+    BN_nnmod(z.get(), z.get(), c.order, ctx.get());
+    std::array<uint8_t, 32> z_bytes{};
+    BN_bn2binpad(z.get(), z_bytes.data(), 32);
+    
+    Rfc6979Nonce nonces(secret_key, z_bytes);
+    auto r = new_bn();
+    auto s = new_bn();
+    while (true) {
+        auto k_bytes = nonces.next();
+        auto k = new_bn(k_bytes.data());
+        OPENSSL_cleanse(k_bytes.data(), k_bytes.size());
+        if (!in_scalar_range(k.get())) {
+            continue;
+        }
+        
+        auto point = generator_mul(k.get(), ctx.get());
+        uint8_t r_bytes[32];
+        point_x_bytes(point.get(), r_bytes, ctx.get());
+        BN_bin2bn(r_bytes, 32, r.get());
+        BN_nnmod(r.get(), r.get(), c.order, ctx.get());
+        if (BN_is_zero(r.get())) {
+            continue;
+        }
+        
+        // s = k^-1 * (z + r * d) mod n
+        BN_mod_mul(s.get(), r.get(), d.get(), c.order, ctx.get());
+        BN_mod_add(s.get(), s.get(), z.get(), c.order, ctx.get());
+        BN_mod_inverse(k.get(), k.get(), c.order, ctx.get());
+        BN_mod_mul(s.get(), s.get(), k.get(), c.order, ctx.get());
+        if (!BN_is_zero(s.get())) {
+            break;
+        }
+    }
+    
+    if (BN_cmp(s.get(), c.half_order) > 0) {
+        BN_sub(s.get(), c.order, s.get());
+    }
+    BN_bn2binpad(r.get(), signature.data(), 32);
+    BN_bn2binpad(s.get(), signature.data() + 32, 32);
+#endif
+    
+    return signature;
+}
+
+bool Crypto::verify_hash(
+    const std::array<uint8_t, 32>& hash,
+    const std::array<uint8_t, 64>& signature,
+    const std::vector<uint8_t>& public_key
+) {
+    return verify_ecdsa(hash.data(), signature.data(), public_key.data(), public_key.size());
+}
+
+std::array<uint8_t, 32> Crypto::schnorr_public_key(const std::array<uint8_t, 32>& secret_key) {
+    std::array<uint8_t, 32> public_key{};
+    
+#ifdef HAVE_SECP256K1
+    secp256k1_keypair keypair;
+    secp256k1_xonly_pubkey xonly;
+    if (secp256k1_keypair_create(secp_context(), &keypair, secret_key.data()) != 1) {
+        throw WalletError::crypto("Invalid secret key");
+    }
+    secp256k1_keypair_xonly_pub(secp_context(), &xonly, nullptr, &keypair);
+    secp256k1_xonly_pubkey_serialize(secp_context(), public_key.data(), &xonly);
+    OPENSSL_cleanse(&keypair, sizeof(keypair));
+#else
+    auto ctx = new_bn_ctx();
+    auto d = secret_scalar(secret_key);
+    auto point = generator_mul(d.get(), ctx.get());
+    point_x_bytes(point.get(), public_key.data(), ctx.get());
+#endif
+    
+    return public_key;
+}
+
+std::array<uint8_t, 64> Crypto::schnorr_sign(
+    const std::array<uint8_t, 32>& message,
+    const std::array<uint8_t, 32>& secret_key
+) {
+    std::array<uint8_t, 64> signature{};
+    std::array<uint8_t, 32> aux_rand{};
+    if (RAND_bytes(aux_rand.data(), 32) != 1) {
+        throw WalletError::crypto("Failed to generate signing randomness");
+    }
+    
+#ifdef HAVE_SECP256K1
+    secp256k1_keypair keypair;
+    if (secp256k1_keypair_create(secp_context(), &keypair, secret_key.data()) != 1) {
+        throw WalletError::crypto("Invalid secret key");
+    }
+    int ok = secp256k1_schnorrsig_sign32(secp_context(), signature.data(), message.data(), &keypair, aux_rand.data());
+    OPENSSL_cleanse(&keypair, sizeof(keypair));
+    if (ok != 1) {
+        throw WalletError::crypto("Schnorr signing failed");
+    }
+#else
+    const auto& c = curve();
+    auto ctx = new_bn_ctx();
+    auto d = secret_scalar(secret_key);
+    
+    // Negate the key if needed so the public key has an even y
+    auto p = generator_mul(d.get(), ctx.get());
+    uint8_t p_x[32];
+    if (!point_x_bytes(p.get(), p_x, ctx.get())) {
+        BN_sub(d.get(), c.order, d.get());
+    }
+    
+    // t = bytes(d) xor H_aux(a); k' = H_nonce(t || P.x || m) mod n
+    std::array<uint8_t, 32> d_bytes{};
+    BN_bn2binpad(d.get(), d_bytes.data(), 32);
+    auto aux_hash = tagged_hash("BIP0340/aux", std::vector<uint8_t>(aux_rand.begin(), aux_rand.end()));
+    std::vector<uint8_t> nonce_data(64 + message.size());
+    for (size_t i = 0; i < 32; ++i) {
+        nonce_data[i] = d_bytes[i] ^ aux_hash[i];
+    }
+    std::copy(p_x, p_x + 32, nonce_data.begin() + 32);
+    std::copy(message.begin(), message.end(), nonce_data.begin() + 64);
+    auto k_bytes = tagged_hash("BIP0340/nonce", nonce_data);
+    OPENSSL_cleanse(d_bytes.data(), d_bytes.size());
+    OPENSSL_cleanse(nonce_data.data(), nonce_data.size());
+    
+    auto k = new_bn(k_bytes.data());
+    OPENSSL_cleanse(k_bytes.data(), k_bytes.size());
+    BN_nnmod(k.get(), k.get(), c.order, ctx.get());
+    if (BN_is_zero(k.get())) {
+        throw WalletError::crypto("Schnorr signing failed");
+    }
+    
+    auto r = generator_mul(k.get(), ctx.get());
+    if (!point_x_bytes(r.get(), signature.data(), ctx.get())) {
+        BN_sub(k.get(), c.order, k.get());
+    }
+    
+    // s = k + e * d mod n
+    auto e = challenge_scalar(signature.data(), p_x, message.data(), ctx.get());
+    auto s = new_bn();
+    BN_mod_mul(s.get(), e.get(), d.get(), c.order, ctx.get());
+    BN_mod_add(s.get(), s.get(), k.get(), c.order, ctx.get());
+    BN_bn2binpad(s.get(), signature.data() + 32, 32);
+#endif
+    
+    return signature;
+}
+
+bool Crypto::schnorr_verify(
+    const std::array<uint8_t, 32>& message,
+    const std::array<uint8_t, 64>& signature,
+    const std::array<uint8_t, 32>& public_key
+) {
+    return verify_schnorr(message.data(), signature.data(), public_key.data());
+}
+
+#ifndef HAVE_SECP256K1
+
+// Width-w NAF of a scalar below 2^256, least significant digit first: odd
+// digits in (-2^w, 2^w), at least w zeros after each nonzero one
+static size_t wnaf_digits(const BIGNUM* k, int w, int8_t* digits) {
+    uint8_t bytes[32];
+    BN_bn2binpad(k, bytes, 32);
+    uint64_t limbs[5] = {0, 0, 0, 0, 0};
+    for (int i = 0; i < 32; ++i) {
+        limbs[i / 8] |= static_cast<uint64_t>(bytes[31 - i]) << (8 * (i % 8));
+    }
+    
+    const int64_t window = int64_t(1) << (w + 1);
+    size_t length = 0;
+    while (limbs[0] | limbs[1] | limbs[2] | limbs[3] | limbs[4]) {
+        int64_t digit = 0;
+        if (limbs[0] & 1) {
+            digit = static_cast<int64_t>(limbs[0] & (window - 1));
+            if (digit >= window / 2) {
+                digit -= window;
+            }
+            // k -= digit; the low bits cancel, so only the carry or borrow moves
+            if (digit > 0) {
+                uint64_t borrow = static_cast<uint64_t>(digit);
+                for (int i = 0; i < 5 && borrow; ++i) {
+                    uint64_t before = limbs[i];
+                    limbs[i] -= borrow;
+                    borrow = before < borrow ? 1 : 0;
+                }
+            } else {
+                uint64_t carry = static_cast<uint64_t>(-digit);
+                for (int i = 0; i < 5 && carry; ++i) {
+                    limbs[i] += carry;
+                    carry = limbs[i] < carry ? 1 : 0;
+                }
+            }
+        }
+        digits[length++] = static_cast<int8_t>(digit);
+        for (int i = 0; i < 4; ++i) {
+            limbs[i] = (limbs[i] >> 1) | (limbs[i + 1] << 63);
+        }
+        limbs[4] >>= 1;
+    }
+    return length;
+}
+
+// One term of a multi-scalar multiplication: odd multiples P, 3P, ... of its
+// point and the wNAF digits of its scalar
+struct MsmTerm {
+    std::vector<PointPtr> table;
+    int8_t digits[258];
+    size_t length;
+};
+
+// Strauss' interleaved method: sum k_i * P_i with one shared chain of
+// doublings, so each term only pays for its table and about 256 / (w + 1)
+// additions instead of a full scalar multiplication
+static bool multi_scalar_mul(EC_POINT* result, const std::vector<const EC_POINT*>& points,
+                             const std::vector<const BIGNUM*>& scalars, BN_CTX* ctx) {
+    const auto& c = curve();
+    std::vector<MsmTerm> terms(points.size());
+    size_t length = 0;
+    
+    for (size_t i = 0; i < points.size(); ++i) {
+        MsmTerm& term = terms[i];
+        // Short scalars (the 128-bit batch weights) don't repay a wide table
+        int w = BN_num_bits(scalars[i]) <= 128 ? 4 : 5;
+        term.length = wnaf_digits(scalars[i], w, term.digits);
+        length = std::max(length, term.length);
+        
+        size_t entries = size_t(1) << (w - 1);
+        term.table.reserve(entries);
+        term.table.push_back(new_point());
+        auto twice = new_point();
+        if (EC_POINT_copy(term.table[0].get(), points[i]) != 1 ||
+            EC_POINT_dbl(c.group, twice.get(), points[i], ctx) != 1) {
+            return false;
+        }
+        for (size_t j = 1; j < entries; ++j) {
+            term.table.push_back(new_point());
+            if (EC_POINT_add(c.group, term.table[j].get(), term.table[j - 1].get(), twice.get(), ctx) != 1) {
+                return false;
+            }
+        }
+    }
+    
+    auto negated = new_point();
+    if (EC_POINT_set_to_infinity(c.group, result) != 1) {
+        return false;
+    }
+    for (size_t bit = length; bit-- > 0;) {
+        if (!EC_POINT_is_at_infinity(c.group, result) &&
+            EC_POINT_dbl(c.group, result, result, ctx) != 1) {
+            return false;
+        }
+        for (const MsmTerm& term : terms) {
+            int digit = bit < term.length ? term.digits[bit] : 0;
+            if (digit == 0) {
+                continue;
+            }
+            const EC_POINT* addend = term.table[static_cast<size_t>((std::abs(digit) - 1) / 2)].get();
+            if (digit < 0) {
+                if (EC_POINT_copy(negated.get(), addend) != 1 ||
+                    EC_POINT_invert(c.group, negated.get(), ctx) != 1) {
+                    return false;
+                }
+                addend = negated.get();
+            }
+            if (EC_POINT_add(c.group, result, result, addend, ctx) != 1) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// BIP340 batch verification. With random 128-bit weights a_i (a_0 = 1)
+// every signature is valid iff sum a_i*R_i + sum (a_i*e_i)*P_i -
+// (sum a_i*s_i)*G is the point at infinity, which a single multi-scalar
+// multiplication decides. A false result means at least one item is bad
+// (or unparsable); the caller then checks items one by one.
+static bool batch_verify_schnorr(const VerifyItem* const* items, size_t count) {
+    const auto& c = curve();
+    auto ctx = new_bn_ctx();
+    auto g_scalar = new_bn();
+    BN_zero(g_scalar.get());
+    
+    std::vector<PointPtr> owned_points;
+    std::vector<BnPtr> owned_scalars;
+    owned_points.reserve(2 * count);
+    owned_scalars.reserve(2 * count + 1);
+    
+    for (size_t i = 0; i < count; ++i) {
+        const VerifyItem& item = *items[i];
+        
+        auto px = new_bn(item.public_key.data());
+        auto rx = new_bn(item.signature.data());
+        auto s = new_bn(item.signature.data() + 32);
+        if (BN_cmp(px.get(), c.field) >= 0 || BN_cmp(rx.get(), c.field) >= 0 ||
+            BN_cmp(s.get(), c.order) >= 0) {
+            return false;
+        }
+        
+        auto p = new_point();
+        auto r = new_point();
+        if (EC_POINT_set_compressed_coordinates(c.group, p.get(), px.get(), 0, ctx.get()) != 1 ||
+            EC_POINT_set_compressed_coordinates(c.group, r.get(), rx.get(), 0, ctx.get()) != 1) {
+            return false;
+        }
+        
+        auto e = challenge_scalar(item.signature.data(), item.public_key.data(), item.hash.data(), ctx.get());
+        auto a = new_bn();
+        if (i == 0) {
+            BN_one(a.get());
+        } else {
+            uint8_t weight[16];
+            if (RAND_bytes(weight, sizeof(weight)) != 1) {
+                throw WalletError::crypto("Failed to generate batch weights");
+            }
+            BN_bin2bn(weight, sizeof(weight), a.get());
+            if (BN_is_zero(a.get())) {
+                BN_one(a.get());
+            }
+        }
+        
+        auto term = new_bn();
+        BN_mod_mul(term.get(), a.get(), s.get(), c.order, ctx.get());
+        BN_mod_add(g_scalar.get(), g_scalar.get(), term.get(), c.order, ctx.get());
+        
+        auto ae = new_bn();
+        BN_mod_mul(ae.get(), a.get(), e.get(), c.order, ctx.get());
+        
+        owned_points.push_back(std::move(r));
+        owned_scalars.push_back(std::move(a));
+        owned_points.push_back(std::move(p));
+        owned_scalars.push_back(std::move(ae));
+    }
+    
+    std::vector<const EC_POINT*> points;
+    std::vector<const BIGNUM*> scalars;
+    points.reserve(2 * count + 1);
+    scalars.reserve(2 * count + 1);
+    for (size_t i = 0; i < owned_points.size(); ++i) {
+        if (BN_is_zero(owned_scalars[i].get())) {
+            continue;
+        }
+        points.push_back(owned_points[i].get());
+        scalars.push_back(owned_scalars[i].get());
+    }
+    if (!BN_is_zero(g_scalar.get())) {
+        BN_sub(g_scalar.get(), c.order, g_scalar.get());
+        points.push_back(EC_GROUP_get0_generator(c.group));
+        scalars.push_back(g_scalar.get());
+    }
+    
+    auto sum = new_point();
+    return multi_scalar_mul(sum.get(), points, scalars, ctx.get()) &&
+           EC_POINT_is_at_infinity(c.group, sum.get());
+}
+
+#endif
+
+bool BatchVerifyResult::all_valid() const {
+    for (size_t i = 0; i < count; ++i) {
+        if (!valid(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BatchVerifyResult Crypto::verify_batch(const VerifyItem* items, size_t count) {
+    BatchVerifyResult result;
+    result.count = count;
+    result.bitmap.assign((count + 63) / 64, 0);
+    
+    // One block per pool thread so small batches still spread out. Blocks
+    // stop at 16 items: the shared doublings are mostly amortized by then,
+    // and a block holding one bad signature is re-verified item by item
+    ThreadPool& pool = ThreadPool::shared();
+    size_t threads = std::max<size_t>(pool.size(), 1);
+    size_t grain = std::min<size_t>(16, std::max<size_t>(1, (count + threads - 1) / threads));
+    std::vector<uint8_t> valid(count, 0);
+    
+    pool.parallel_for(count, grain, [&](size_t begin, size_t end) {
+        std::vector<const VerifyItem*> schnorr_items;
+        std::vector<size_t> schnorr_indexes;
+        
+        for (size_t i = begin; i < end; ++i) {
+            const VerifyItem& item = items[i];
+            if (item.scheme == SignatureScheme::SCHNORR) {
+                schnorr_items.push_back(&item);
+                schnorr_indexes.push_back(i);
+            } else if (verify_ecdsa(item.hash.data(), item.signature.data(),
+                                    item.public_key.data(), item.public_key.size())) {
+                valid[i] = 1;
+            }
+        }
+        
+#ifndef HAVE_SECP256K1
+        if (schnorr_items.size() > 1 && batch_verify_schnorr(schnorr_items.data(), schnorr_items.size())) {
+            for (size_t index : schnorr_indexes) {
+                valid[index] = 1;
+            }
+            return;
+        }
+#endif
+        
+        for (size_t j = 0; j < schnorr_items.size(); ++j) {
+            const VerifyItem& item = *schnorr_items[j];
+            if (verify_schnorr(item.hash.data(), item.signature.data(), item.public_key.data())) {
+                valid[schnorr_indexes[j]] = 1;
+            }
+        }
+    });
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (valid[i]) {
+            result.bitmap[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    return result;
 }
 
 std::string Crypto::public_key_to_bitcoin_address(
@@ -130,100 +1242,352 @@ std::string Crypto::public_key_to_bitcoin_address(
 }
 
 bool Crypto::is_valid_address(const std::string& address) {
+    // Bech32 SegWit addresses start with their HRP and separator; anything
+    // else can only be base58
+    if (address.size() > 3 && address[2] == '1') {
+        char c0 = address[0] | 0x20;
+        char c1 = address[1] | 0x20;
+        if ((c0 == 'b' && c1 == 'c') || (c0 == 't' && c1 == 'b')) {
+            static const std::string mainnet_hrp = "bc";
+            static const std::string testnet_hrp = "tb";
+            int version = 0;
+            uint8_t program[40];
+            size_t written = 0;
+            return segwit_address_decode(address, c0 == 'b' ? mainnet_hrp : testnet_hrp,
+                                         version, program, sizeof(program), written);
+        }
+    }
+    
     if (address.length() < 26 || address.length() > 35) {
         return false;
     }
     
-    try {
-        auto decoded = base58_decode(address);
-        return decoded.size() >= 25; // Minimum valid address size
-    } catch (...) {
+    // Version byte + 20-byte hash, checksum verified by the decoder
+    uint8_t payload[21];
+    size_t written = 0;
+    if (!base58check_decode(address, payload, sizeof(payload), written) || written != sizeof(payload)) {
         return false;
     }
+    
+    // P2PKH and P2SH versions for mainnet and testnet
+    return payload[0] == 0x00 || payload[0] == 0x05 || payload[0] == 0x6f || payload[0] == 0xc4;
 }
 
-std::string Crypto::base58_encode(const std::vector<uint8_t>& data) {
-    std::string result;
-    std::vector<uint8_t> digits;
+size_t Crypto::base58_encode(const uint8_t* data, size_t size, char* out, size_t out_size) {
+    size_t zeros = 0;
+    while (zeros < size && data[zeros] == 0) {
+        ++zeros;
+    }
     
-    // Convert to base58
-    for (uint8_t byte : data) {
-        int carry = byte;
-        for (size_t i = 0; i < digits.size(); ++i) {
-            carry += 256 * digits[i];
-            digits[i] = carry % 58;
-            carry /= 58;
+    // Little-endian base 58^5 limbs, each holding a little over 29 bits
+    size_t max_limbs = size * 8 / 29 + 2;
+    uint32_t stack_limbs[BASE58_STACK_LIMBS];
+    std::vector<uint32_t> heap_limbs;
+    uint32_t* limbs = stack_limbs;
+    if (max_limbs > BASE58_STACK_LIMBS) {
+        heap_limbs.resize(max_limbs);
+        limbs = heap_limbs.data();
+    }
+    
+    // Feed the big-endian input four bytes at a time, starting with the
+    // short leading word so the rest stay aligned to the end
+    const uint8_t* p = data + zeros;
+    size_t remaining = size - zeros;
+    size_t used = 0;
+    size_t word_bytes = remaining % 4 == 0 ? 4 : remaining % 4;
+    while (remaining > 0) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < word_bytes; ++i) {
+            carry = (carry << 8) | *p++;
+        }
+        remaining -= word_bytes;
+        
+        for (size_t j = 0; j < used; ++j) {
+            uint64_t t = (static_cast<uint64_t>(limbs[j]) << (8 * word_bytes)) + carry;
+            limbs[j] = static_cast<uint32_t>(t % BASE58_POW5);
+            carry = t / BASE58_POW5;
         }
         while (carry > 0) {
-            digits.push_back(carry % 58);
-            carry /= 58;
+            limbs[used++] = static_cast<uint32_t>(carry % BASE58_POW5);
+            carry /= BASE58_POW5;
         }
+        word_bytes = 4;
     }
     
-    // Handle leading zeros
-    for (size_t i = 0; i < data.size() && data[i] == 0; ++i) {
-        result += '1';
+    // The most significant limb may have leading zero digits to drop
+    size_t top_digits = 0;
+    if (used > 0) {
+        top_digits = 5;
+        while (limbs[used - 1] < BASE58_POWERS[top_digits - 1]) {
+            --top_digits;
+        }
     }
     
-    // Convert digits to string
-    for (auto it = digits.rbegin(); it != digits.rend(); ++it) {
-        result += BASE58_ALPHABET[*it];
+    size_t length = zeros + (used == 0 ? 0 : top_digits + 5 * (used - 1));
+    if (length > out_size) {
+        throw std::invalid_argument("Base58 output buffer too small");
     }
     
-    return result;
+    char* q = out;
+    for (size_t i = 0; i < zeros; ++i) {
+        *q++ = '1';
+    }
+    for (size_t j = used; j-- > 0;) {
+        uint32_t limb = limbs[j];
+        size_t digits = j == used - 1 ? top_digits : 5;
+        for (size_t k = digits; k-- > 0;) {
+            q[k] = BASE58_ALPHABET[limb % 58];
+            limb /= 58;
+        }
+        q += digits;
+    }
+    
+    return length;
 }
 
-std::vector<uint8_t> Crypto::base58_decode(const std::string& encoded) {
-    std::vector<uint8_t> result;
-    std::vector<int> digits;
+bool Crypto::base58_decode(const char* encoded, size_t length, uint8_t* out, size_t out_size, size_t& written) {
+    size_t zeros = 0;
+    while (zeros < length && encoded[zeros] == '1') {
+        ++zeros;
+    }
     
-    // Convert string to digits
-    for (char c : encoded) {
-        auto pos = BASE58_ALPHABET.find(c);
-        if (pos == std::string::npos) {
-            throw std::invalid_argument("Invalid base58 character");
-        }
-        digits.push_back(pos);
+    // Little-endian 32-bit limbs; five digits add at most 30 bits
+    size_t max_limbs = length / 5 + 2;
+    uint32_t stack_limbs[BASE58_STACK_LIMBS];
+    std::vector<uint32_t> heap_limbs;
+    uint32_t* limbs = stack_limbs;
+    if (max_limbs > BASE58_STACK_LIMBS) {
+        heap_limbs.resize(max_limbs);
+        limbs = heap_limbs.data();
     }
     
-    // Convert from base58
-    for (int digit : digits) {
-        int carry = digit;
-        for (size_t i = 0; i < result.size(); ++i) {
-            carry += 58 * result[i];
-            result[i] = carry % 256;
-            carry /= 256;
+    const char* p = encoded + zeros;
+    size_t remaining = length - zeros;
+    size_t used = 0;
+    size_t group = remaining % 5 == 0 ? 5 : remaining % 5;
+    while (remaining > 0) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < group; ++i) {
+            int8_t digit = BASE58_DECODE.digits[static_cast<uint8_t>(*p++)];
+            if (digit < 0) {
+                return false;
+            }
+            carry = carry * 58 + static_cast<uint64_t>(digit);
+        }
+        remaining -= group;
+        
+        uint64_t multiplier = BASE58_POWERS[group];
+        for (size_t j = 0; j < used; ++j) {
+            uint64_t t = limbs[j] * multiplier + carry;
+            limbs[j] = static_cast<uint32_t>(t);
+            carry = t >> 32;
         }
         while (carry > 0) {
-            result.push_back(carry % 256);
-            carry /= 256;
+            limbs[used++] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+        group = 5;
+    }
+    
+    size_t top_bytes = 0;
+    if (used > 0) {
+        uint32_t top = limbs[used - 1];
+        top_bytes = top >= (1u << 24) ? 4 : top >= (1u << 16) ? 3 : top >= (1u << 8) ? 2 : 1;
+    }
+    
+    size_t size = zeros + (used == 0 ? 0 : top_bytes + 4 * (used - 1));
+    if (size > out_size) {
+        return false;
+    }
+    
+    uint8_t* q = out;
+    std::fill(q, q + zeros, 0);
+    q += zeros;
+    for (size_t j = used; j-- > 0;) {
+        uint32_t limb = limbs[j];
+        size_t bytes = j == used - 1 ? top_bytes : 4;
+        for (size_t k = bytes; k-- > 0;) {
+            q[k] = static_cast<uint8_t>(limb);
+            limb >>= 8;
         }
+        q += bytes;
     }
     
-    // Handle leading zeros
-    for (size_t i = 0; i < encoded.size() && encoded[i] == '1'; ++i) {
-        result.push_back(0);
+    written = size;
+    return true;
+}
+
+std::string Crypto::base58_encode(const std::vector<uint8_t>& data) {
+    std::string result(base58_max_encoded_size(data.size()), '\0');
+    result.resize(base58_encode(data.data(), data.size(), &result[0], result.size()));
+    return result;
+}
+
+std::vector<uint8_t> Crypto::base58_decode(const std::string& encoded) {
+    std::vector<uint8_t> result(encoded.size());
+    size_t written = 0;
+    if (!base58_decode(encoded.data(), encoded.size(), result.data(), result.size(), written)) {
+        throw std::invalid_argument("Invalid base58 character");
+    }
+    result.resize(written);
+    return result;
+}
+
+// First four bytes of SHA256(SHA256(data))
+static void base58check_checksum(const uint8_t* data, size_t size, uint8_t* checksum) {
+    auto hash = Crypto::double_sha256(data, size);
+    std::copy(hash.begin(), hash.begin() + 4, checksum);
+}
+
+std::string Crypto::base58check_encode(const uint8_t* payload, size_t size) {
+    uint8_t stack_buffer[128];
+    std::vector<uint8_t> heap_buffer;
+    uint8_t* buffer = stack_buffer;
+    if (size + 4 > sizeof(stack_buffer)) {
+        heap_buffer.resize(size + 4);
+        buffer = heap_buffer.data();
     }
     
-    std::reverse(result.begin(), result.end());
+    std::copy(payload, payload + size, buffer);
+    base58check_checksum(payload, size, buffer + size);
+    
+    std::string result(base58_max_encoded_size(size + 4), '\0');
+    result.resize(base58_encode(buffer, size + 4, &result[0], result.size()));
     return result;
 }
 
+bool Crypto::base58check_decode(const std::string& encoded, uint8_t* payload,
+                                size_t payload_size, size_t& written) {
+    uint8_t stack_buffer[128];
+    std::vector<uint8_t> heap_buffer;
+    uint8_t* buffer = stack_buffer;
+    size_t capacity = std::min(encoded.size(), payload_size + 4);
+    if (capacity > sizeof(stack_buffer)) {
+        heap_buffer.resize(capacity);
+        buffer = heap_buffer.data();
+    }
+    
+    size_t size = 0;
+    if (!base58_decode(encoded.data(), encoded.size(), buffer, capacity, size) || size < 4) {
+        return false;
+    }
+    
+    uint8_t checksum[4];
+    base58check_checksum(buffer, size - 4, checksum);
+    if (!std::equal(checksum, checksum + 4, buffer + size - 4)) {
+        return false;
+    }
+    
+    std::copy(buffer, buffer + size - 4, payload);
+    written = size - 4;
+    return true;
+}
+
+// Digest implementations are fetched once; fetching on every call (as the
+// one-shot SHA256()/RIPEMD160() helpers do) costs more than hashing a key
+static const EVP_MD* sha256_md() {
+    static const EVP_MD* md = [] {
+        const EVP_MD* fetched = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+        return fetched ? fetched : EVP_sha256();
+    }();
+    return md;
+}
+
+static const EVP_MD* ripemd160_md() {
+    static const EVP_MD* md = [] {
+        const EVP_MD* fetched = EVP_MD_fetch(nullptr, "RIPEMD160", nullptr);
+        return fetched ? fetched : EVP_ripemd160();
+    }();
+    return md;
+}
+
+static EVP_MD_CTX* new_md_ctx() {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx) {
+        throw WalletError::crypto("Failed to allocate digest context");
+    }
+    return ctx;
+}
+
+// One digest context per thread for the one-shot hash functions
+struct ThreadDigestContext {
+    EVP_MD_CTX* ctx = new_md_ctx();
+    ~ThreadDigestContext() { EVP_MD_CTX_free(ctx); }
+};
+
+static void digest(const EVP_MD* md, const uint8_t* data, size_t size, uint8_t* out) {
+    thread_local ThreadDigestContext context;
+    if (EVP_DigestInit_ex(context.ctx, md, nullptr) != 1 ||
+        EVP_DigestUpdate(context.ctx, data, size) != 1 ||
+        EVP_DigestFinal_ex(context.ctx, out, nullptr) != 1) {
+        throw WalletError::crypto("Digest computation failed");
+    }
+}
+
+Sha256Ctx::Sha256Ctx() : ctx_(new_md_ctx()) {
+    init();
+}
+
+Sha256Ctx::~Sha256Ctx() {
+    EVP_MD_CTX_free(ctx_);
+}
+
+void Sha256Ctx::init() {
+    if (EVP_DigestInit_ex(ctx_, sha256_md(), nullptr) != 1) {
+        throw WalletError::crypto("Failed to initialize SHA256");
+    }
+}
+
+void Sha256Ctx::update(const uint8_t* data, size_t size) {
+    if (EVP_DigestUpdate(ctx_, data, size) != 1) {
+        throw WalletError::crypto("Failed to update SHA256");
+    }
+}
+
+void Sha256Ctx::final(uint8_t* out) {
+    if (EVP_DigestFinal_ex(ctx_, out, nullptr) != 1) {
+        throw WalletError::crypto("Failed to finalize SHA256");
+    }
+}
+
+std::array<uint8_t, 32> Sha256Ctx::final() {
+    std::array<uint8_t, 32> hash{};
+    final(hash.data());
+    return hash;
+}
+
 std::array<uint8_t, 32> Crypto::sha256(const std::vector<uint8_t>& data) {
+    return sha256(data.data(), data.size());
+}
+
+std::array<uint8_t, 32> Crypto::sha256(const uint8_t* data, size_t size) {
     std::array<uint8_t, 32> hash{};
-    SHA256(data.data(), data.size(), hash.data());
+    digest(sha256_md(), data, size, hash.data());
     return hash;
 }
 
 std::array<uint8_t, 20> Crypto::ripemd160(const std::vector<uint8_t>& data) {
+    return ripemd160(data.data(), data.size());
+}
+
+std::array<uint8_t, 20> Crypto::ripemd160(const uint8_t* data, size_t size) {
     std::array<uint8_t, 20> hash{};
-    RIPEMD160(data.data(), data.size(), hash.data());
+    digest(ripemd160_md(), data, size, hash.data());
     return hash;
 }
 
 std::array<uint8_t, 32> Crypto::double_sha256(const std::vector<uint8_t>& data) {
-    auto first_hash = sha256(data);
-    return sha256(std::vector<uint8_t>(first_hash.begin(), first_hash.end()));
+    return double_sha256(data.data(), data.size());
+}
+
+std::array<uint8_t, 32> Crypto::double_sha256(const uint8_t* data, size_t size) {
+    auto first_hash = sha256(data, size);
+    return sha256(first_hash.data(), first_hash.size());
+}
+
+std::array<uint8_t, 20> Crypto::hash160(const uint8_t* data, size_t size) {
+    auto first_hash = sha256(data, size);
+    return ripemd160(first_hash.data(), first_hash.size());
 }
 
 } // namespace crypto_wallet
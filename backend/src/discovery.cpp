@@ -0,0 +1,71 @@
+#include "discovery.h"
+#include <algorithm>
+#include <future>
+
+namespace crypto_wallet {
+
+AddressDiscovery::AddressDiscovery(const Wallet& wallet, const NetworkClient& client,
+                                   DiscoveryOptions options)
+    : wallet_(wallet), client_(client), options_(options) {
+    options_.gap_limit = std::max<uint32_t>(options_.gap_limit, 1);
+    options_.batch_size = std::max<uint32_t>(options_.batch_size, 1);
+    options_.concurrency = std::max<size_t>(options_.concurrency, 1);
+    options_.max_addresses = std::max(options_.max_addresses, options_.gap_limit);
+}
+
+DiscoveryResult AddressDiscovery::run() const {
+    // Derive the seed before the chains race to do it
+    wallet_.seed();
+
+    auto change = std::async(std::launch::async, [this] { return scan_chain(true); });
+    DiscoveryResult result;
+    result.receive = scan_chain(false);
+    result.change = change.get();
+
+    // A wallet always has a first receive address, used or not
+    if (result.receive.addresses.empty()) {
+        result.receive.addresses = wallet_.generate_addresses(0, 1);
+    }
+    return result;
+}
+
+ChainDiscovery AddressDiscovery::scan_chain(bool change) const {
+    ChainDiscovery chain;
+    std::vector<std::string> derived;
+    uint32_t unused_run = 0;
+
+    while (unused_run < options_.gap_limit && chain.scanned < options_.max_addresses) {
+        uint32_t count = std::min(options_.batch_size, options_.max_addresses - chain.scanned);
+        auto batch = wallet_.generate_addresses(chain.scanned, count, change);
+        auto stats = lookup(client_, batch, options_.concurrency);
+
+        for (size_t i = 0; i < batch.size() && unused_run < options_.gap_limit; ++i) {
+            derived.push_back(std::move(batch[i]));
+            ++chain.scanned;
+            if (stats[i].used()) {
+                ++chain.used_count;
+                chain.balance += stats[i].balance;
+                chain.addresses.insert(chain.addresses.end(),
+                                       std::make_move_iterator(derived.begin()),
+                                       std::make_move_iterator(derived.end()));
+                derived.clear();
+                unused_run = 0;
+            } else {
+                ++unused_run;
+            }
+        }
+    }
+    chain.truncated = unused_run < options_.gap_limit;
+
+    return chain;
+}
+
+std::vector<AddressStats> AddressDiscovery::lookup(const NetworkClient& client,
+                                                   const std::vector<std::string>& addresses,
+                                                   size_t concurrency) {
+    // Lookups wait on the network, not the CPU, so they go to the HTTP
+    // event loop rather than occupying threads
+    return client.get_address_stats(addresses, concurrency);
+}
+
+} // namespace crypto_wallet
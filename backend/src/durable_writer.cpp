@@ -0,0 +1,247 @@
+#include "durable_writer.h"
+#include "error.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace crypto_wallet {
+
+static std::string errno_message() {
+    return std::string(std::strerror(errno));
+}
+
+static std::string temp_path_for(const std::filesystem::path& path) {
+    return path.string() + ".tmp-" + std::to_string(::getpid());
+}
+
+// Write and fsync a new file at temp
+static void write_synced(const std::string& temp, const uint8_t* data, size_t size) {
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw WalletError::storage("Failed to create " + temp + ": " + errno_message());
+    }
+
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::string message = errno_message();
+            ::close(fd);
+            ::unlink(temp.c_str());
+            throw WalletError::storage("Failed to write " + temp + ": " + message);
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    if (::fsync(fd) != 0) {
+        std::string message = errno_message();
+        ::close(fd);
+        ::unlink(temp.c_str());
+        throw WalletError::storage("Failed to sync " + temp + ": " + message);
+    }
+    ::close(fd);
+}
+
+static void rename_over(const std::string& temp, const std::filesystem::path& path) {
+    if (::rename(temp.c_str(), path.c_str()) != 0) {
+        std::string message = errno_message();
+        ::unlink(temp.c_str());
+        throw WalletError::storage("Failed to replace " + path.string() + ": " + message);
+    }
+}
+
+// Makes renames inside the directory durable
+static void sync_directory(const std::filesystem::path& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw WalletError::storage("Failed to open " + directory.string() + ": " + errno_message());
+    }
+    if (::fsync(fd) != 0) {
+        std::string message = errno_message();
+        ::close(fd);
+        throw WalletError::storage("Failed to sync " + directory.string() + ": " + message);
+    }
+    ::close(fd);
+}
+
+static std::filesystem::path parent_directory(const std::filesystem::path& path) {
+    auto parent = path.parent_path();
+    return parent.empty() ? std::filesystem::path(".") : parent;
+}
+
+void atomic_write_file(const std::filesystem::path& path, const uint8_t* data, size_t size) {
+    auto temp = temp_path_for(path);
+    write_synced(temp, data, size);
+    rename_over(temp, path);
+    sync_directory(parent_directory(path));
+}
+
+struct DurableWriter::Ticket {
+    bool done = false;
+    std::exception_ptr error;
+};
+
+DurableWriter::DurableWriter(std::chrono::milliseconds window)
+    : window_(window),
+      queued_batch_(1),
+      completed_batch_(0),
+      flush_requested_(false),
+      stopping_(false),
+      stats_() {
+    worker_ = std::thread(&DurableWriter::worker_loop, this);
+}
+
+DurableWriter::~DurableWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    worker_.join();
+}
+
+DurableWriter& DurableWriter::shared() {
+    static DurableWriter writer;
+    return writer;
+}
+
+void DurableWriter::replace(const std::filesystem::path& path, std::vector<uint8_t> contents,
+                            std::mutex* rename_lock) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& pending = replaces_[path.string()];
+    pending.contents = std::move(contents);
+    pending.rename_lock = rename_lock;
+    if (!pending.ticket) {
+        pending.ticket = std::make_shared<Ticket>();
+    }
+    auto ticket = pending.ticket;
+    ++stats_.replaces;
+
+    work_ready_.notify_one();
+    batch_done_.wait(lock, [&ticket] { return ticket->done; });
+    if (ticket->error) {
+        std::rethrow_exception(ticket->error);
+    }
+}
+
+void DurableWriter::schedule_sync(const std::filesystem::path& path, std::function<void()> sync) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    syncs_[path.string()] = std::move(sync);
+    ++stats_.syncs_requested;
+    work_ready_.notify_one();
+}
+
+void DurableWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Queued work goes into the next batch; with nothing queued, wait for
+    // the batch that may be running now
+    bool queued = !replaces_.empty() || !syncs_.empty();
+    uint64_t target = queued ? queued_batch_ : queued_batch_ - 1;
+    if (queued) {
+        flush_requested_ = true;
+        work_ready_.notify_one();
+    }
+    batch_done_.wait(lock, [this, target] { return completed_batch_ >= target; });
+}
+
+DurableWriter::Stats DurableWriter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void DurableWriter::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_ready_.wait(lock, [this] { return stopping_ || !replaces_.empty() || !syncs_.empty(); });
+        if (replaces_.empty() && syncs_.empty()) {
+            return;
+        }
+
+        // Give other writers the rest of the window to join this batch
+        if (!stopping_ && !flush_requested_) {
+            work_ready_.wait_for(lock, window_, [this] { return stopping_ || flush_requested_; });
+        }
+        flush_requested_ = false;
+
+        auto replaces = std::move(replaces_);
+        auto syncs = std::move(syncs_);
+        replaces_.clear();
+        syncs_.clear();
+        uint64_t batch = queued_batch_++;
+
+        lock.unlock();
+        run_batch(replaces, syncs);
+        lock.lock();
+
+        ++stats_.batches;
+        stats_.files_written += replaces.size();
+        stats_.syncs_run += syncs.size();
+        for (auto& entry : replaces) {
+            entry.second.ticket->done = true;
+        }
+        completed_batch_ = batch;
+        batch_done_.notify_all();
+    }
+}
+
+void DurableWriter::run_batch(std::unordered_map<std::string, PendingReplace>& replaces,
+                              std::unordered_map<std::string, std::function<void()>>& syncs) {
+    // Every file is written and fsynced before any rename, so a crash part
+    // way through leaves each target either old or new
+    std::vector<std::pair<const std::string*, std::string>> written;
+    for (auto& entry : replaces) {
+        auto temp = temp_path_for(entry.first);
+        try {
+            write_synced(temp, entry.second.contents.data(), entry.second.contents.size());
+            written.emplace_back(&entry.first, std::move(temp));
+        } catch (...) {
+            entry.second.ticket->error = std::current_exception();
+        }
+    }
+
+    std::unordered_map<std::string, std::vector<Ticket*>> directories;
+    for (auto& file : written) {
+        auto& pending = replaces[*file.first];
+        try {
+            std::unique_lock<std::mutex> rename_guard;
+            if (pending.rename_lock) {
+                rename_guard = std::unique_lock<std::mutex>(*pending.rename_lock);
+            }
+            rename_over(file.second, *file.first);
+            directories[parent_directory(*file.first).string()].push_back(pending.ticket.get());
+        } catch (...) {
+            pending.ticket->error = std::current_exception();
+        }
+    }
+
+    // One directory fsync covers every rename into that directory
+    for (auto& directory : directories) {
+        try {
+            sync_directory(directory.first);
+        } catch (...) {
+            for (auto* ticket : directory.second) {
+                ticket->error = std::current_exception();
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.directory_syncs += directories.size();
+    }
+
+    // Nobody waits on a scheduled sync, so failures can only be reported
+    for (auto& entry : syncs) {
+        try {
+            entry.second();
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: failed to sync " << entry.first << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+} // namespace crypto_wallet
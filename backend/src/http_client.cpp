@@ -0,0 +1,792 @@
+#include "http_client.h"
+#include <algorithm>
+#include <memory>
+
+namespace crypto_wallet {
+
+static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
+    size_t newLength = size * nmemb;
+    try {
+        s->append((char*)contents, newLength);
+        return newLength;
+    } catch (std::bad_alloc& e) {
+        return 0;
+    }
+}
+
+struct HttpClient::StreamTarget {
+    HttpStreamHandler write;
+    std::exception_ptr error;  // Thrown by write; the transfer was aborted
+};
+
+size_t HttpClient::write_stream(void* contents, size_t size, size_t nmemb, void* target) {
+    auto* stream = static_cast<StreamTarget*>(target);
+    size_t length = size * nmemb;
+    try {
+        stream->write(static_cast<const char*>(contents), length);
+        return length;
+    } catch (...) {
+        stream->error = std::current_exception();
+        return 0;
+    }
+}
+
+static std::string describe(const std::exception_ptr& error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "Unknown error";
+    }
+}
+
+// scheme://host[:port], the unit curl keeps connections for
+static std::string origin_of(const std::string& url) {
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    return url.substr(0, url.find('/', start));
+}
+
+// Latencies kept per mirror for its hedge delay
+static constexpr size_t LATENCY_SAMPLES = 128;
+// Before which the hedge delay is hedge_initial_ms
+static constexpr size_t LATENCY_MIN_SAMPLES = 20;
+// Recorded latencies between percentile refreshes
+static constexpr size_t LATENCY_REFRESH = 16;
+
+struct HttpClient::Mirror {
+    std::string base;
+    CircuitBreaker breaker;
+    std::vector<double> latencies_ms;  // Ring of successful attempts
+    size_t next = 0;
+    size_t since_estimate = 0;
+    double percentile_ms = 0;          // Valid once estimated
+    bool estimated = false;
+    uint64_t attempts = 0;
+    uint64_t failures = 0;
+
+    Mirror(const std::string& base_url, const CircuitBreakerOptions& options) : base(base_url), breaker(options) {}
+
+    void record_latency(double ms, double percentile) {
+        if (latencies_ms.size() < LATENCY_SAMPLES) {
+            latencies_ms.push_back(ms);
+        } else {
+            latencies_ms[next] = ms;
+        }
+        next = (next + 1) % LATENCY_SAMPLES;
+        if (latencies_ms.size() < LATENCY_MIN_SAMPLES || (estimated && ++since_estimate < LATENCY_REFRESH)) {
+            return;
+        }
+        std::vector<double> sorted(latencies_ms);
+        auto at = sorted.begin() + static_cast<size_t>(percentile * (sorted.size() - 1));
+        std::nth_element(sorted.begin(), at, sorted.end());
+        percentile_ms = *at;
+        estimated = true;
+        since_estimate = 0;
+    }
+};
+
+// One URL of a batch, answered by whichever of its attempts finishes first
+struct HttpClient::Request {
+    Batch* batch;
+    size_t index;
+    std::vector<Mirror*> mirrors;  // Its mirror group, home first; empty if unmirrored
+    std::string suffix;            // The URL past the mirror base, or all of it
+    Clock::time_point started;
+    Clock::time_point deadline;
+    Clock::time_point hedge_at;
+    std::vector<Transfer*> attempts;  // In flight
+    std::vector<Mirror*> tried;
+    Transfer* committed = nullptr;    // Streaming: the attempt whose data went out
+    size_t launched = 0;
+    bool hedged = false;
+    std::string error;                // Last upstream failure
+    std::list<std::unique_ptr<Request>>::iterator position;
+};
+
+struct HttpClient::Batch {
+    const std::vector<std::string>* urls;
+    const HttpBatchHandler* handler;
+    const HttpChunkHandler* on_data = nullptr;  // Set when streaming
+    size_t concurrency;
+    size_t next = 0;
+    size_t in_flight = 0;  // Requests, not attempts
+    std::list<std::unique_ptr<Request>> live;
+    std::exception_ptr error;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+};
+
+struct HttpClient::Transfer {
+    Request* request;
+    CURL* handle;
+    Mirror* mirror;  // Null when unmirrored
+    bool probe;      // The mirror's half-open trial
+    bool hedge;
+    Clock::time_point started;
+    std::string body;
+    StreamTarget stream;
+    char error[CURL_ERROR_SIZE];
+};
+
+// A superseded streaming attempt aborting itself
+struct Superseded : std::runtime_error {
+    Superseded() : std::runtime_error("Superseded by another attempt") {}
+};
+
+static bool is_under(const std::string& url, const std::string& base) {
+    return url.compare(0, base.size(), base) == 0 &&
+           (url.size() == base.size() || url[base.size()] == '/' || url[base.size()] == '?');
+}
+
+static std::chrono::milliseconds since(CircuitBreaker::Clock::time_point start, CircuitBreaker::Clock::time_point now) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+}
+
+HttpClient::HttpClient(const HttpClientOptions& options)
+    : options_(options),
+      stopping_(false),
+      requests_(0),
+      connections_opened_(0),
+      handles_created_(0),
+      started_(0),
+      hedges_(0),
+      hedge_wins_(0),
+      failovers_(0),
+      rejected_(0) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    share_ = curl_share_init();
+    if (!share_) {
+        throw WalletError::http("Failed to initialize CURL share");
+    }
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &HttpClient::lock_share);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &HttpClient::unlock_share);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    multi_ = curl_multi_init();
+    if (!multi_) {
+        curl_share_cleanup(share_);
+        throw WalletError::http("Failed to initialize CURL multi");
+    }
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(options_.max_host_connections));
+    curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, static_cast<long>(options_.max_idle_connections));
+}
+
+HttpClient::~HttpClient() {
+    if (loop_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(loop_mutex_);
+            stopping_ = true;
+        }
+        curl_multi_wakeup(multi_);
+        loop_.join();
+    }
+    curl_multi_cleanup(multi_);
+    for (CURL* handle : idle_) {
+        curl_easy_cleanup(handle);
+    }
+    curl_share_cleanup(share_);
+    curl_global_cleanup();
+}
+
+HttpClient& HttpClient::shared() {
+    static HttpClient client;
+    return client;
+}
+
+void HttpClient::lock_share(CURL*, curl_lock_data data, curl_lock_access, void* client) {
+    static_cast<HttpClient*>(client)->share_locks_[data].lock();
+}
+
+void HttpClient::unlock_share(CURL*, curl_lock_data data, void* client) {
+    static_cast<HttpClient*>(client)->share_locks_[data].unlock();
+}
+
+CURL* HttpClient::acquire_handle() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!idle_.empty()) {
+            CURL* handle = idle_.back();
+            idle_.pop_back();
+            return handle;
+        }
+    }
+    CURL* handle = curl_easy_init();
+    if (!handle) {
+        throw WalletError::http("Failed to initialize CURL");
+    }
+    ++handles_created_;
+    return handle;
+}
+
+void HttpClient::release_handle(CURL* handle) {
+    // Reset clears options but keeps the handle's buffers
+    curl_easy_reset(handle);
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    idle_.push_back(handle);
+}
+
+void HttpClient::acquire_host(const std::string& host) {
+    std::unique_lock<std::mutex> lock(hosts_mutex_);
+    host_available_.wait(lock, [&] { return in_flight_[host] < options_.max_host_connections; });
+    ++in_flight_[host];
+}
+
+void HttpClient::release_host(const std::string& host) {
+    {
+        std::lock_guard<std::mutex> lock(hosts_mutex_);
+        if (--in_flight_[host] == 0) {
+            in_flight_.erase(host);
+        }
+    }
+    host_available_.notify_all();
+}
+
+std::string HttpClient::get(const std::string& url) {
+    if (!mirrored(url)) {
+        return perform(url, nullptr);
+    }
+    std::string body;
+    std::string error;
+    get_many({url}, 1, [&](size_t, std::string&& response, const std::string& failure) {
+        body = std::move(response);
+        error = failure;
+    });
+    if (!error.empty()) {
+        throw WalletError::http(error);
+    }
+    return body;
+}
+
+std::string HttpClient::post(const std::string& url, const std::string& data) {
+    return perform(url, &data);
+}
+
+void HttpClient::get(const std::string& url, const HttpStreamHandler& on_data) {
+    if (!mirrored(url)) {
+        StreamTarget stream{on_data, nullptr};
+        perform(url, nullptr, &stream);
+        return;
+    }
+    // Rethrow on_data's own exception rather than its message
+    std::exception_ptr thrown;
+    std::string error;
+    HttpChunkHandler write = [&](size_t, const char* data, size_t size) {
+        try {
+            on_data(data, size);
+        } catch (...) {
+            thrown = std::current_exception();
+            throw;
+        }
+    };
+    get_many({url}, 1, write, [&](size_t, std::string&&, const std::string& failure) { error = failure; });
+    if (thrown) {
+        std::rethrow_exception(thrown);
+    }
+    if (!error.empty()) {
+        throw WalletError::http(error);
+    }
+}
+
+void HttpClient::add_mirrors(const std::vector<std::string>& base_urls) {
+    if (base_urls.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mirrors_mutex_);
+    for (const auto& group : groups_) {
+        if (group.front()->base == base_urls.front()) {
+            return;
+        }
+    }
+    std::vector<Mirror*> group;
+    for (const auto& base : base_urls) {
+        mirrors_.emplace_back(base, options_.breaker);
+        group.push_back(&mirrors_.back());
+    }
+    groups_.push_back(std::move(group));
+}
+
+bool HttpClient::mirrored(const std::string& url) const {
+    std::lock_guard<std::mutex> lock(mirrors_mutex_);
+    for (const auto& mirror : mirrors_) {
+        if (is_under(url, mirror.base)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HttpClient::configure(CURL* curl, const std::string& url, const std::string* post_data,
+                           std::string* body, StreamTarget* stream) {
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    if (post_data) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data->c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(post_data->size()));
+    }
+    if (stream) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &HttpClient::write_stream);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, stream);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, body);
+    }
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    // Error statuses fail the request rather than returning an error page
+    // as if it were data
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, options_.timeout_seconds);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, options_.connect_timeout_seconds);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // The default cache of 5 would close connections the host cap allows
+    curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, static_cast<long>(options_.max_idle_connections));
+    // Timeouts must not use signals in a multi-threaded process
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    if (options_.http2) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        // Wait for an HTTP/2 connection being set up rather than open another
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    }
+}
+
+void HttpClient::count_request(CURL* curl) {
+    ++requests_;
+    long connects = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK) {
+        connections_opened_ += static_cast<uint64_t>(connects);
+    }
+}
+
+std::string HttpClient::perform(const std::string& url, const std::string* post_data, StreamTarget* stream) {
+    // Give back the host slot and the handle however the request ends
+    struct Lease {
+        HttpClient& client;
+        std::string host;
+        CURL* handle = nullptr;
+
+        ~Lease() {
+            if (handle) {
+                client.release_handle(handle);
+            }
+            client.release_host(host);
+        }
+    };
+
+    Lease lease{*this, origin_of(url)};
+    acquire_host(lease.host);
+    lease.handle = acquire_handle();
+
+    std::string readBuffer;
+    configure(lease.handle, url, post_data, &readBuffer, stream);
+    curl_easy_setopt(lease.handle, CURLOPT_SHARE, share_);
+    CURLcode res = curl_easy_perform(lease.handle);
+    count_request(lease.handle);
+
+    if (stream && stream->error) {
+        std::rethrow_exception(stream->error);
+    }
+    if (res != CURLE_OK) {
+        throw WalletError::http("CURL error: " + std::string(curl_easy_strerror(res)));
+    }
+    return readBuffer;
+}
+
+void HttpClient::get_many(const std::vector<std::string>& urls, size_t concurrency,
+                          const HttpBatchHandler& handler) {
+    if (urls.empty()) {
+        return;
+    }
+
+    Batch batch;
+    batch.urls = &urls;
+    batch.handler = &handler;
+    batch.concurrency = std::max<size_t>(concurrency, 1);
+    run_batch(batch);
+}
+
+void HttpClient::get_many(const std::vector<std::string>& urls, size_t concurrency,
+                          const HttpChunkHandler& on_data, const HttpBatchHandler& handler) {
+    if (urls.empty()) {
+        return;
+    }
+
+    Batch batch;
+    batch.urls = &urls;
+    batch.handler = &handler;
+    batch.on_data = &on_data;
+    batch.concurrency = std::max<size_t>(concurrency, 1);
+    run_batch(batch);
+}
+
+void HttpClient::run_batch(Batch& batch) {
+    std::call_once(loop_started_, [this] { loop_ = std::thread(&HttpClient::event_loop, this); });
+    {
+        std::lock_guard<std::mutex> lock(loop_mutex_);
+        submitted_.push_back(&batch);
+    }
+    curl_multi_wakeup(multi_);
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.finished.wait(lock, [&] { return batch.done; });
+    if (batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
+
+void HttpClient::event_loop() {
+    std::vector<Batch*> active;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(loop_mutex_);
+            if (stopping_) {
+                break;
+            }
+            active.insert(active.end(), submitted_.begin(), submitted_.end());
+            submitted_.clear();
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+            CURLcode result = message->data.result;
+            curl_multi_remove_handle(multi_, message->easy_handle);
+            finish_transfer(transfer, result);
+        }
+
+        // Refill each batch's window, start due hedges, then hand back the
+        // batches that are done
+        Clock::time_point now = Clock::now();
+        Clock::time_point wake = now + std::chrono::seconds(1);
+        for (auto it = active.begin(); it != active.end();) {
+            Batch& batch = **it;
+            start_requests(batch);
+            wake = std::min(wake, check_hedges(batch, now));
+            if (batch.in_flight == 0 && batch.next == batch.urls->size()) {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                batch.done = true;
+                batch.finished.notify_all();
+                it = active.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count();
+        curl_multi_poll(multi_, nullptr, 0, static_cast<int>(std::max<long long>(timeout, 0)), nullptr);
+    }
+}
+
+void HttpClient::start_requests(Batch& batch) {
+    while (batch.in_flight < batch.concurrency && batch.next < batch.urls->size()) {
+        auto owned = std::make_unique<Request>();
+        Request& request = *owned;
+        request.batch = &batch;
+        request.index = batch.next++;
+        const std::string& url = (*batch.urls)[request.index];
+        request.suffix = url;
+        {
+            std::lock_guard<std::mutex> lock(mirrors_mutex_);
+            for (const auto& group : groups_) {
+                for (size_t i = 0; i < group.size() && request.mirrors.empty(); ++i) {
+                    if (is_under(url, group[i]->base)) {
+                        // The URL's own mirror first, then the rest in order
+                        request.mirrors.push_back(group[i]);
+                        for (size_t j = 0; j < group.size(); ++j) {
+                            if (j != i) {
+                                request.mirrors.push_back(group[j]);
+                            }
+                        }
+                        request.suffix = url.substr(group[i]->base.size());
+                    }
+                }
+            }
+        }
+
+        request.started = Clock::now();
+        if (request.mirrors.empty()) {
+            request.deadline = request.started + std::chrono::seconds(options_.timeout_seconds);
+        } else {
+            request.deadline = request.started + std::chrono::milliseconds(options_.deadline_ms);
+            ++started_;
+        }
+        ++batch.in_flight;
+        batch.live.push_back(std::move(owned));
+        request.position = std::prev(batch.live.end());
+        if (!launch(request, false)) {
+            complete(request, std::string(), request.error);
+        }
+    }
+}
+
+bool HttpClient::launch(Request& request, bool hedge) {
+    Clock::time_point now = Clock::now();
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(request.deadline - now);
+    if (remaining.count() <= 0) {
+        if (request.error.empty()) {
+            request.error = "Deadline exceeded";
+        }
+        return false;
+    }
+
+    Mirror* mirror = nullptr;
+    bool probe = false;
+    long hedge_delay_ms = 0;
+    if (!request.mirrors.empty()) {
+        std::lock_guard<std::mutex> lock(mirrors_mutex_);
+        // Mirrors not tried yet, then any whose breaker still admits a call
+        for (int pass = 0; pass < 2 && !mirror; ++pass) {
+            for (Mirror* candidate : request.mirrors) {
+                bool tried = std::find(request.tried.begin(), request.tried.end(), candidate) != request.tried.end();
+                if (pass == 0 && tried) {
+                    continue;
+                }
+                if (candidate->breaker.try_acquire(now, probe)) {
+                    mirror = candidate;
+                    break;
+                }
+            }
+        }
+        if (!mirror) {
+            if (request.launched == 0) {
+                ++rejected_;
+            }
+            if (request.error.empty()) {
+                request.error = "Circuit open for " + request.mirrors.front()->base;
+            }
+            return false;
+        }
+        ++mirror->attempts;
+        hedge_delay_ms = mirror->estimated
+                             ? std::max<long>(options_.hedge_min_ms, static_cast<long>(mirror->percentile_ms))
+                             : options_.hedge_initial_ms;
+    }
+
+    auto transfer = std::make_unique<Transfer>();
+    transfer->request = &request;
+    transfer->mirror = mirror;
+    transfer->probe = probe;
+    transfer->hedge = hedge;
+    transfer->started = now;
+    transfer->error[0] = '\0';
+    try {
+        transfer->handle = acquire_handle();
+    } catch (const WalletError& e) {
+        if (probe) {
+            std::lock_guard<std::mutex> lock(mirrors_mutex_);
+            mirror->breaker.abandon();
+        }
+        request.error = e.what();
+        return false;
+    }
+
+    // No share here: the multi handle keeps its own DNS, TLS session and
+    // connection caches, and only its own pool enforces the host cap
+    StreamTarget* stream = nullptr;
+    if (request.batch->on_data) {
+        const HttpChunkHandler* on_data = request.batch->on_data;
+        Transfer* self = transfer.get();
+        // The first attempt to deliver data owns the response; the others
+        // abort on their first write
+        transfer->stream.write = [on_data, self](const char* data, size_t size) {
+            Request& owner = *self->request;
+            if (owner.committed != self) {
+                if (owner.committed) {
+                    throw Superseded();
+                }
+                owner.committed = self;
+            }
+            (*on_data)(owner.index, data, size);
+        };
+        stream = &transfer->stream;
+    }
+    std::string url = mirror ? mirror->base + request.suffix : request.suffix;
+    configure(transfer->handle, url, nullptr, &transfer->body, stream);
+    // Whatever is left of the request's deadline
+    curl_easy_setopt(transfer->handle, CURLOPT_TIMEOUT_MS, static_cast<long>(remaining.count()));
+    curl_easy_setopt(transfer->handle, CURLOPT_ERRORBUFFER, transfer->error);
+    curl_easy_setopt(transfer->handle, CURLOPT_PRIVATE, transfer.get());
+    curl_multi_add_handle(multi_, transfer->handle);
+
+    if (mirror) {
+        request.tried.push_back(mirror);
+    }
+    if (hedge) {
+        ++hedges_;
+        request.hedged = true;
+    } else if (request.launched == 0) {
+        request.hedge_at = now + std::chrono::milliseconds(hedge_delay_ms);
+    }
+    ++request.launched;
+    request.attempts.push_back(transfer.release());
+    return true;
+}
+
+HttpClient::Clock::time_point HttpClient::check_hedges(Batch& batch, Clock::time_point now) {
+    Clock::time_point wake = Clock::time_point::max();
+    if (!options_.hedge) {
+        return wake;
+    }
+    for (const auto& live : batch.live) {
+        Request& request = *live;
+        if (request.mirrors.empty() || request.hedged || request.committed || request.attempts.size() != 1 ||
+            request.launched >= options_.max_attempts) {
+            continue;
+        }
+        if (now < request.hedge_at) {
+            wake = std::min(wake, request.hedge_at);
+            continue;
+        }
+        // Hedges stay a small share of traffic, so a slow upstream is not
+        // sent twice the load
+        if (hedges_ >= 1 + options_.hedge_budget * started_ || !launch(request, true)) {
+            request.hedged = true;
+        }
+    }
+    return wake;
+}
+
+void HttpClient::finish_transfer(Transfer* raw, CURLcode result) {
+    std::unique_ptr<Transfer> transfer(raw);
+    Request& request = *transfer->request;
+    request.attempts.erase(std::find(request.attempts.begin(), request.attempts.end(), raw));
+    count_request(transfer->handle);
+    long status = 0;
+    curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &status);
+    release_handle(transfer->handle);
+
+    Clock::time_point now = Clock::now();
+    bool superseded = request.committed && request.committed != raw;
+    std::string error;
+    bool upstream_failure = false;
+    if (transfer->stream.error) {
+        error = describe(transfer->stream.error);
+    } else if (result != CURLE_OK) {
+        error = "CURL error: " + std::string(transfer->error[0] ? transfer->error : curl_easy_strerror(result));
+        // A 4xx is the upstream's answer; anything else means it had none
+        upstream_failure = result != CURLE_HTTP_RETURNED_ERROR || status >= 500 || status == 429;
+    }
+
+    if (Mirror* mirror = transfer->mirror) {
+        std::lock_guard<std::mutex> lock(mirrors_mutex_);
+        // Aborted by the attempt that won rather than failed by the upstream
+        if (superseded && transfer->stream.error) {
+            if (transfer->probe) {
+                mirror->breaker.abandon();
+            }
+        } else {
+            auto latency = since(transfer->started, now);
+            mirror->breaker.record(upstream_failure, latency, now);
+            if (upstream_failure) {
+                ++mirror->failures;
+            } else if (error.empty()) {
+                mirror->record_latency(static_cast<double>(latency.count()), options_.hedge_percentile);
+            }
+        }
+    }
+    if (superseded) {
+        return;
+    }
+
+    if (error.empty()) {
+        if (transfer->hedge) {
+            ++hedge_wins_;
+        }
+        complete(request, std::move(transfer->body), error);
+        return;
+    }
+    // A stream that already delivered data cannot start over
+    if (!upstream_failure || request.committed || request.mirrors.empty()) {
+        complete(request, std::string(), error);
+        return;
+    }
+    request.error = error;
+    if (!request.attempts.empty()) {
+        return;  // The hedge may still answer
+    }
+    if (request.launched < options_.max_attempts && launch(request, false)) {
+        ++failovers_;
+        return;
+    }
+    complete(request, std::string(), request.error);
+}
+
+void HttpClient::cancel(Transfer* raw) {
+    std::unique_ptr<Transfer> transfer(raw);
+    curl_multi_remove_handle(multi_, transfer->handle);
+    release_handle(transfer->handle);
+    if (Mirror* mirror = transfer->mirror) {
+        // A loser that had already run past the slow threshold still counts
+        // as a slow call
+        Clock::time_point now = Clock::now();
+        auto elapsed = since(transfer->started, now);
+        std::lock_guard<std::mutex> lock(mirrors_mutex_);
+        if (elapsed >= options_.breaker.slow_call) {
+            mirror->breaker.record(false, elapsed, now);
+        } else if (transfer->probe) {
+            mirror->breaker.abandon();
+        }
+    }
+}
+
+void HttpClient::complete(Request& request, std::string&& body, const std::string& error) {
+    for (Transfer* transfer : request.attempts) {
+        cancel(transfer);
+    }
+    request.attempts.clear();
+
+    Batch& batch = *request.batch;
+    --batch.in_flight;
+    if (!batch.error) {
+        try {
+            (*batch.handler)(request.index, std::move(body), error);
+        } catch (...) {
+            // Stop starting this batch's URLs; the rest drain normally
+            batch.error = std::current_exception();
+            batch.next = batch.urls->size();
+        }
+    }
+    batch.live.erase(request.position);
+}
+
+HttpClientStats HttpClient::stats() const {
+    HttpClientStats stats{};
+    stats.requests = requests_;
+    stats.connections_opened = connections_opened_;
+    stats.handles_created = handles_created_;
+    stats.hedges = hedges_;
+    stats.hedge_wins = hedge_wins_;
+    stats.failovers = failovers_;
+    stats.rejected = rejected_;
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    stats.idle_handles = idle_.size();
+    return stats;
+}
+
+std::vector<UpstreamStats> HttpClient::upstream_stats() const {
+    Clock::time_point now = Clock::now();
+    std::vector<UpstreamStats> result;
+    std::lock_guard<std::mutex> lock(mirrors_mutex_);
+    for (const auto& mirror : mirrors_) {
+        result.push_back(UpstreamStats{mirror.base, mirror.breaker.state(now),
+                                       mirror.estimated ? mirror.percentile_ms : 0.0, mirror.attempts,
+                                       mirror.failures});
+    }
+    return result;
+}
+
+} // namespace crypto_wallet
@@ -0,0 +1,373 @@
+#include "json_stream.h"
+
+namespace crypto_wallet {
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool is_number_char(char c) {
+    return is_digit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool valid_number(const std::string& s) {
+    size_t i = 0;
+    size_t n = s.size();
+    auto digits = [&] {
+        size_t start = i;
+        while (i < n && is_digit(s[i])) {
+            ++i;
+        }
+        return i > start;
+    };
+
+    if (i < n && s[i] == '-') {
+        ++i;
+    }
+    if (i < n && s[i] == '0') {
+        ++i;
+    } else if (!digits()) {
+        return false;
+    }
+    if (i < n && s[i] == '.') {
+        ++i;
+        if (!digits()) {
+            return false;
+        }
+    }
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+        if (i < n && (s[i] == '+' || s[i] == '-')) {
+            ++i;
+        }
+        if (!digits()) {
+            return false;
+        }
+    }
+    return i == n;
+}
+
+JsonStreamParser::JsonStreamParser(JsonStreamHandler& handler)
+    : handler_(handler),
+      expect_(Expect::Value),
+      lex_(Lex::None),
+      token_is_key_(false),
+      unicode_(0),
+      unicode_digits_(0),
+      high_surrogate_(0),
+      offset_(0) {}
+
+void JsonStreamParser::fail(const std::string& reason) const {
+    throw WalletError::serialization("Invalid JSON at byte " + std::to_string(offset_) + ": " + reason);
+}
+
+const std::string& JsonStreamParser::current_key() const {
+    static const std::string none;
+    return stack_.empty() || stack_.back().array ? none : stack_.back().key;
+}
+
+void JsonStreamParser::feed(const char* data, size_t size) {
+    const char* end = data + size;
+    for (const char* p = data; p < end; ++p, ++offset_) {
+        char c = *p;
+        switch (lex_) {
+        case Lex::String: {
+            // Copy runs of plain characters at once
+            const char* run = p;
+            while (run < end && *run != '"' && *run != '\\' && static_cast<unsigned char>(*run) >= 0x20) {
+                ++run;
+            }
+            if (run > p) {
+                flush_surrogate();
+                if (token_.size() + (run - p) > MAX_TOKEN_SIZE) {
+                    fail("string too long");
+                }
+                token_.append(p, run);
+                offset_ += run - p;
+                p = run;
+                if (p == end) {
+                    return;
+                }
+            }
+            string_char(*p);
+            continue;
+        }
+        case Lex::Escape:
+            escape_char(c);
+            continue;
+        case Lex::Unicode:
+            unicode_char(c);
+            continue;
+        case Lex::Number:
+            if (is_number_char(c)) {
+                if (token_.size() == MAX_TOKEN_SIZE) {
+                    fail("number too long");
+                }
+                token_ += c;
+                continue;
+            }
+            finish_number();
+            break;
+        case Lex::Literal:
+            if (c >= 'a' && c <= 'z') {
+                token_ += c;
+                if (token_.size() > 5) {
+                    fail("unknown literal");
+                }
+                continue;
+            }
+            finish_literal();
+            break;
+        case Lex::None:
+            break;
+        }
+
+        switch (c) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            break;
+        case '{':
+            open(false);
+            break;
+        case '[':
+            open(true);
+            break;
+        case '}':
+            close(false);
+            break;
+        case ']':
+            close(true);
+            break;
+        case ':':
+            if (expect_ != Expect::Colon) {
+                fail("unexpected ':'");
+            }
+            expect_ = Expect::Value;
+            break;
+        case ',':
+            if (expect_ != Expect::CommaOrEnd) {
+                fail("unexpected ','");
+            }
+            expect_ = stack_.back().array ? Expect::Value : Expect::Key;
+            break;
+        case '"':
+            if (expect_ == Expect::Key || expect_ == Expect::KeyOrEnd) {
+                token_is_key_ = true;
+            } else {
+                start_value();
+                token_is_key_ = false;
+            }
+            token_.clear();
+            lex_ = Lex::String;
+            break;
+        default:
+            if (c == '-' || is_digit(c)) {
+                start_value();
+                token_.assign(1, c);
+                lex_ = Lex::Number;
+            } else if (c >= 'a' && c <= 'z') {
+                start_value();
+                token_.assign(1, c);
+                lex_ = Lex::Literal;
+            } else {
+                fail("unexpected character");
+            }
+        }
+    }
+}
+
+void JsonStreamParser::finish() {
+    switch (lex_) {
+    case Lex::Number:
+        finish_number();
+        break;
+    case Lex::Literal:
+        finish_literal();
+        break;
+    case Lex::String:
+    case Lex::Escape:
+    case Lex::Unicode:
+        fail("unterminated string");
+    case Lex::None:
+        break;
+    }
+    if (expect_ != Expect::Done) {
+        fail("truncated document");
+    }
+}
+
+void JsonStreamParser::start_value() {
+    if (expect_ != Expect::Value && expect_ != Expect::ValueOrEnd) {
+        fail("unexpected value");
+    }
+}
+
+void JsonStreamParser::after_value() {
+    expect_ = stack_.empty() ? Expect::Done : Expect::CommaOrEnd;
+}
+
+void JsonStreamParser::open(bool array) {
+    start_value();
+    if (stack_.size() == MAX_DEPTH) {
+        fail("nested too deeply");
+    }
+    handler_.begin(stack_.size() + 1, current_key(), array);
+    stack_.push_back(Frame{array, std::string()});
+    expect_ = array ? Expect::ValueOrEnd : Expect::KeyOrEnd;
+}
+
+void JsonStreamParser::close(bool array) {
+    if (stack_.empty() || stack_.back().array != array) {
+        fail("mismatched bracket");
+    }
+    // A trailing comma leaves Value or Key expected
+    if (expect_ != Expect::CommaOrEnd && expect_ != (array ? Expect::ValueOrEnd : Expect::KeyOrEnd)) {
+        fail("unexpected end of container");
+    }
+    handler_.end(stack_.size(), array);
+    stack_.pop_back();
+    after_value();
+}
+
+void JsonStreamParser::string_char(char c) {
+    if (c == '"') {
+        finish_string();
+    } else if (c == '\\') {
+        lex_ = Lex::Escape;
+    } else {
+        fail("control character in string");
+    }
+}
+
+void JsonStreamParser::escape_char(char c) {
+    char decoded;
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+        decoded = c;
+        break;
+    case 'b':
+        decoded = '\b';
+        break;
+    case 'f':
+        decoded = '\f';
+        break;
+    case 'n':
+        decoded = '\n';
+        break;
+    case 'r':
+        decoded = '\r';
+        break;
+    case 't':
+        decoded = '\t';
+        break;
+    case 'u':
+        unicode_ = 0;
+        unicode_digits_ = 0;
+        lex_ = Lex::Unicode;
+        return;
+    default:
+        fail("invalid escape");
+    }
+    flush_surrogate();
+    token_ += decoded;
+    lex_ = Lex::String;
+}
+
+void JsonStreamParser::unicode_char(char c) {
+    uint32_t digit;
+    if (is_digit(c)) {
+        digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+    } else {
+        fail("invalid \\u escape");
+    }
+    unicode_ = unicode_ << 4 | digit;
+    if (++unicode_digits_ < 4) {
+        return;
+    }
+
+    lex_ = Lex::String;
+    if (unicode_ >= 0xD800 && unicode_ < 0xDC00) {
+        flush_surrogate();
+        high_surrogate_ = unicode_;
+    } else if (unicode_ >= 0xDC00 && unicode_ < 0xE000) {
+        if (high_surrogate_) {
+            append_code_point(0x10000 + ((high_surrogate_ - 0xD800) << 10) + (unicode_ - 0xDC00));
+            high_surrogate_ = 0;
+        } else {
+            append_code_point(0xFFFD);
+        }
+    } else {
+        flush_surrogate();
+        append_code_point(unicode_);
+    }
+}
+
+void JsonStreamParser::append_code_point(uint32_t code_point) {
+    if (code_point < 0x80) {
+        token_ += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        token_ += static_cast<char>(0xC0 | code_point >> 6);
+        token_ += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        token_ += static_cast<char>(0xE0 | code_point >> 12);
+        token_ += static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+        token_ += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        token_ += static_cast<char>(0xF0 | code_point >> 18);
+        token_ += static_cast<char>(0x80 | (code_point >> 12 & 0x3F));
+        token_ += static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+        token_ += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+void JsonStreamParser::flush_surrogate() {
+    // A high surrogate without its pair
+    if (high_surrogate_) {
+        append_code_point(0xFFFD);
+        high_surrogate_ = 0;
+    }
+}
+
+void JsonStreamParser::finish_string() {
+    flush_surrogate();
+    lex_ = Lex::None;
+    if (token_is_key_) {
+        stack_.back().key.swap(token_);
+        expect_ = Expect::Colon;
+        return;
+    }
+    handler_.scalar(stack_.size() + 1, current_key(), JsonType::String, token_);
+    after_value();
+}
+
+void JsonStreamParser::finish_number() {
+    lex_ = Lex::None;
+    if (!valid_number(token_)) {
+        fail("invalid number");
+    }
+    handler_.scalar(stack_.size() + 1, current_key(), JsonType::Number, token_);
+    after_value();
+}
+
+void JsonStreamParser::finish_literal() {
+    lex_ = Lex::None;
+    if (token_ == "true" || token_ == "false") {
+        handler_.scalar(stack_.size() + 1, current_key(), JsonType::Bool, token_);
+    } else if (token_ == "null") {
+        handler_.scalar(stack_.size() + 1, current_key(), JsonType::Null, token_);
+    } else {
+        fail("unknown literal");
+    }
+    after_value();
+}
+
+} // namespace crypto_wallet
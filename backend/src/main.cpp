@@ -4,7 +4,10 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
 #include "wallet.h"
+#include "storage.h"
 #include "cli.h"
 #include "web_server.h"
 #include "error.h"
@@ -50,10 +53,10 @@ private:
         std::cout << "Usage: crypto_wallet <command> [options]\n\n";
         std::cout << "Commands:\n";
         std::cout << "  create -n <name> [-p <password>]     Create a new wallet\n";
-        std::cout << "  import -n <name> -s <seed> [-p <password>]  Import wallet from seed phrase\n";
-        std::cout << "  send -w <wallet> -t <address> -a <amount> [-n <network>]  Send cryptocurrency\n";
-        std::cout << "  balance -w <wallet> [-n <network>]   Get wallet balance\n";
-        std::cout << "  addresses -w <wallet>                List wallet addresses\n";
+        std::cout << "  import -n <name> -s <seed> [-p <password>] [--network <network>]  Import wallet and scan for used addresses\n";
+        std::cout << "  send -w <wallet> -t <address> -a <amount> [-t <address> -a <amount> ...] [-c <blocks>] [-n <network>] [-p <password>]  Send cryptocurrency, batching several payouts into one transaction\n";
+        std::cout << "  balance -w <wallet> [-n <network>] [-p <password>]  Get wallet balance\n";
+        std::cout << "  addresses -w <wallet> [-p <password>]  List wallet addresses\n";
         std::cout << "  server                               Start web server with GUI\n";
     }
     
@@ -79,7 +82,7 @@ private:
             return;
         }
         
-        auto wallet = Wallet::create_new(name);
+        auto wallet = Wallet::create_new(name, password);
         std::cout << "✅ Wallet '" << name << "' created successfully!" << std::endl;
         std::cout << "📝 Seed phrase: " << wallet.get_seed_phrase() << std::endl;
         std::cout << "⚠️  IMPORTANT: Store your seed phrase in a safe place!" << std::endl;
@@ -89,6 +92,7 @@ private:
         std::string name;
         std::string seed_phrase;
         std::string password;
+        std::string network = "mainnet";
         
         for (int i = 2; i < argc; i += 2) {
             if (i + 1 >= argc) break;
@@ -102,6 +106,8 @@ private:
                 seed_phrase = value;
             } else if (flag == "-p" || flag == "--password") {
                 password = value;
+            } else if (flag == "--network") {
+                network = value;
             }
         }
         
@@ -110,15 +116,39 @@ private:
             return;
         }
         
-        auto wallet = Wallet::from_seed_phrase(seed_phrase, name);
+        if (!Wallet::supports_network(network)) {
+            std::cerr << "Error: Unsupported network '" << network << "' (mainnet or mock)" << std::endl;
+            return;
+        }
+        
+        auto wallet = Wallet::from_seed_phrase(seed_phrase, name, password);
         std::cout << "✅ Wallet '" << name << "' imported successfully!" << std::endl;
+        
+        // Recover addresses the seed has already used
+        try {
+            double balance = wallet.discover_addresses(network);
+            std::cout << "Found " << wallet.addresses.size() << " receive and "
+                      << wallet.change_addresses.size() << " change addresses, balance "
+                      << balance << " BTC" << std::endl;
+        } catch (const WalletError& e) {
+            std::cerr << "Warning: address discovery failed: " << e.what() << std::endl;
+        }
+    }
+    
+    // Encrypted wallets need the password once per process
+    static void unlock_if_needed(const std::string& wallet_name, const std::string& password) {
+        if (!password.empty()) {
+            WalletStorage::unlock(wallet_name, password);
+        }
     }
     
     static void handle_send(int argc, char* argv[]) {
         std::string wallet_name;
-        std::string to_address;
-        double amount = 0.0;
+        std::vector<std::string> to_addresses;
+        std::vector<double> amounts;
         std::string network = "mainnet";
+        std::string password;
+        uint32_t confirmation_target = Wallet::DEFAULT_CONFIRMATION_TARGET;
         
         for (int i = 2; i < argc; i += 2) {
             if (i + 1 >= argc) break;
@@ -129,21 +159,33 @@ private:
             if (flag == "-w" || flag == "--wallet") {
                 wallet_name = value;
             } else if (flag == "-t" || flag == "--to") {
-                to_address = value;
+                to_addresses.push_back(value);
             } else if (flag == "-a" || flag == "--amount") {
-                amount = std::stod(value);
+                amounts.push_back(std::stod(value));
             } else if (flag == "-n" || flag == "--network") {
                 network = value;
+            } else if (flag == "-p" || flag == "--password") {
+                password = value;
+            } else if (flag == "-c" || flag == "--confirm-target") {
+                confirmation_target = static_cast<uint32_t>(std::stoul(value));
             }
         }
         
-        if (wallet_name.empty() || to_address.empty() || amount <= 0) {
-            std::cerr << "Error: Wallet name (-w), recipient address (-t), and amount (-a) are required" << std::endl;
+        bool amounts_valid = std::all_of(amounts.begin(), amounts.end(), [](double amount) { return amount > 0; });
+        if (wallet_name.empty() || to_addresses.empty() || to_addresses.size() != amounts.size() || !amounts_valid) {
+            std::cerr << "Error: Wallet name (-w) and a recipient address (-t) with an amount (-a) for each payout are required" << std::endl;
             return;
         }
         
+        // Several -t/-a pairs are paid by one transaction
+        std::vector<Payout> payouts;
+        for (size_t i = 0; i < to_addresses.size(); ++i) {
+            payouts.push_back(Payout{to_addresses[i], static_cast<uint64_t>(std::llround(amounts[i] * 100000000.0))});
+        }
+        
+        unlock_if_needed(wallet_name, password);
         auto wallet = Wallet::load(wallet_name);
-        auto tx_hash = wallet.send_transaction(to_address, amount, network);
+        auto tx_hash = wallet.send_payouts(payouts, network, confirmation_target);
         std::cout << "✅ Transaction sent successfully!" << std::endl;
         std::cout << "🔗 Transaction hash: " << tx_hash << std::endl;
     }
@@ -151,6 +193,7 @@ private:
     static void handle_balance(int argc, char* argv[]) {
         std::string wallet_name;
         std::string network = "mainnet";
+        std::string password;
         
         for (int i = 2; i < argc; i += 2) {
             if (i + 1 >= argc) break;
@@ -162,6 +205,8 @@ private:
                 wallet_name = value;
             } else if (flag == "-n" || flag == "--network") {
                 network = value;
+            } else if (flag == "-p" || flag == "--password") {
+                password = value;
             }
         }
         
@@ -170,6 +215,7 @@ private:
             return;
         }
         
+        unlock_if_needed(wallet_name, password);
         auto wallet = Wallet::load(wallet_name);
         auto balance = wallet.get_balance(network);
         std::cout << "💰 Balance: " << balance << " BTC" << std::endl;
@@ -177,6 +223,7 @@ private:
     
     static void handle_addresses(int argc, char* argv[]) {
         std::string wallet_name;
+        std::string password;
         
         for (int i = 2; i < argc; i += 2) {
             if (i + 1 >= argc) break;
@@ -186,6 +233,8 @@ private:
             
             if (flag == "-w" || flag == "--wallet") {
                 wallet_name = value;
+            } else if (flag == "-p" || flag == "--password") {
+                password = value;
             }
         }
         
@@ -194,6 +243,7 @@ private:
             return;
         }
         
+        unlock_if_needed(wallet_name, password);
         auto wallet = Wallet::load(wallet_name);
         auto addresses = wallet.get_addresses();
         std::cout << "📍 Wallet addresses:" << std::endl;
@@ -1,156 +1,427 @@
 #include "network.h"
-#include <curl/curl.h>
+#include "http_client.h"
+#include "response_cache.h"
+#include "json_stream.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
 #include <sstream>
 #include <iostream>
 
 namespace crypto_wallet {
 
-// Callback function for curl
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
-    size_t newLength = size * nmemb;
-    try {
-        s->append((char*)contents, newLength);
-        return newLength;
-    } catch (std::bad_alloc& e) {
-        return 0;
-    }
-}
-
 NetworkClient::NetworkClient(const std::string& base_url) : base_url_(base_url) {}
 
 std::unique_ptr<NetworkClient> NetworkClient::create(const std::string& network) {
-    std::string base_url;
+    // Public instances serving the same API, preferred first
+    std::vector<std::string> mirrors;
     if (network == "mainnet") {
-        base_url = "https://blockstream.info/api";
+        mirrors = {"https://blockstream.info/api", "https://mempool.space/api"};
     } else if (network == "testnet") {
-        base_url = "https://blockstream.info/testnet/api";
+        mirrors = {"https://blockstream.info/testnet/api", "https://mempool.space/testnet/api"};
+    } else if (network == "mock") {
+        mirrors = {MOCK_BASE_URL};
     } else {
         throw WalletError::network("Unsupported network: " + network);
     }
     
-    return std::make_unique<NetworkClient>(base_url);
+    // Point any network at other Esplora instances, e.g. self-hosted ones
+    // or tools/mock_esplora
+    if (const char* override_urls = std::getenv(BASE_URL_ENV)) {
+        mirrors.clear();
+        std::stringstream list(override_urls);
+        std::string base_url;
+        while (std::getline(list, base_url, ',')) {
+            while (!base_url.empty() && base_url.back() == '/') {
+                base_url.pop_back();
+            }
+            if (!base_url.empty()) {
+                mirrors.push_back(base_url);
+            }
+        }
+        if (mirrors.empty()) {
+            throw WalletError::network(std::string(BASE_URL_ENV) + " lists no URL");
+        }
+    }
+    
+    // Requests are written against the first; the client fails over and
+    // hedges to the others
+    HttpClient::shared().add_mirrors(mirrors);
+    return std::make_unique<NetworkClient>(mirrors.front());
 }
 
-double NetworkClient::get_balance(const std::string& address) const {
-    std::string url = base_url_ + "/address/" + address + "/utxo";
-    std::string response = http_get(url);
+// Esplora amounts, heights and times are integers; anything else is read
+// as a double
+static uint64_t to_uint64(const std::string& text) {
+    if (text.find_first_of(".eE-") != std::string::npos) {
+        double value = std::strtod(text.c_str(), nullptr);
+        return value > 0 ? static_cast<uint64_t>(value) : 0;
+    }
+    return std::strtoull(text.c_str(), nullptr, 10);
+}
+
+// A JsonStreamParser that reports malformed input as a network error
+// naming what was being parsed
+class ResponseParser {
+public:
+    ResponseParser(JsonStreamHandler& handler, const char* what) : parser_(handler), what_(what) {}
+    
+    void feed(const char* data, size_t size) {
+        try {
+            parser_.feed(data, size);
+        } catch (const WalletError& e) {
+            fail(e);
+        }
+    }
+    
+    void feed(const std::string& data) { feed(data.data(), data.size()); }
+    
+    void finish() {
+        try {
+            parser_.finish();
+        } catch (const WalletError& e) {
+            fail(e);
+        }
+    }
+    
+private:
+    JsonStreamParser parser_;
+    const char* what_;
+    
+    [[noreturn]] void fail(const WalletError& e) const {
+        throw WalletError::network("Failed to parse " + std::string(what_) + ": " + e.what());
+    }
+};
+
+// Sums "value" over the entries of an /address/<addr>/utxo response
+class UtxoValueSum : public JsonStreamHandler {
+public:
+    uint64_t satoshis = 0;
+    
+    void scalar(size_t depth, const std::string& key, JsonType type, const std::string& text) override {
+        if (depth == 3 && type == JsonType::Number && key == "value") {
+            satoshis += to_uint64(text);
+        }
+    }
+};
+
+// Builds ChainTransactions from an /address/<addr>/txs response, keeping
+// only the fields the wallet uses, and hands each one over as soon as its
+// closing brace arrives. Scripts, witnesses and the like are skipped.
+class TransactionExtractor : public JsonStreamHandler {
+public:
+    explicit TransactionExtractor(std::function<void(ChainTransaction&&)> emit) : emit_(std::move(emit)) {}
+    
+    void begin(size_t depth, const std::string& key, bool array) override {
+        if (depth == 2) {
+            tx_ = ChainTransaction{"", false, 0, 0, {}, {}};
+        } else if (depth == 3) {
+            section_ = key == "vin"    ? Section::Inputs
+                     : key == "vout"   ? Section::Outputs
+                     : key == "status" ? Section::Status
+                                       : Section::Other;
+        } else if (depth == 4 && !array && section_ == Section::Inputs) {
+            tx_.inputs.push_back(TxInput{"", 0, "", 0});
+        } else if (depth == 4 && !array && section_ == Section::Outputs) {
+            tx_.outputs.push_back(TxOutput{"", 0});
+        } else if (depth == 5 && section_ == Section::Inputs) {
+            in_prevout_ = !array && key == "prevout";
+        }
+    }
+    
+    void end(size_t depth, bool /*array*/) override {
+        if (depth == 2) {
+            emit_(std::move(tx_));
+        } else if (depth == 3) {
+            section_ = Section::Other;
+        } else if (depth == 5) {
+            in_prevout_ = false;
+        }
+    }
     
+    void scalar(size_t depth, const std::string& key, JsonType type, const std::string& text) override {
+        if (type == JsonType::Null) {
+            return;
+        }
+        if (depth == 3 && key == "txid") {
+            tx_.txid = text;
+        } else if (depth == 4 && section_ == Section::Status) {
+            if (key == "confirmed") {
+                tx_.confirmed = text == "true";
+            } else if (key == "block_height") {
+                tx_.block_height = static_cast<uint32_t>(to_uint64(text));
+            } else if (key == "block_time") {
+                tx_.block_time = static_cast<int64_t>(to_uint64(text));
+            }
+        } else if (depth == 5 && section_ == Section::Inputs && !tx_.inputs.empty()) {
+            if (key == "txid") {
+                tx_.inputs.back().prev_txid = text;
+            } else if (key == "vout") {
+                tx_.inputs.back().prev_vout = static_cast<uint32_t>(to_uint64(text));
+            }
+        } else if (depth == 5 && section_ == Section::Outputs && !tx_.outputs.empty()) {
+            if (key == "scriptpubkey_address") {
+                tx_.outputs.back().address = text;
+            } else if (key == "value") {
+                tx_.outputs.back().value = to_uint64(text);
+            }
+        } else if (depth == 6 && in_prevout_ && !tx_.inputs.empty()) {
+            if (key == "scriptpubkey_address") {
+                tx_.inputs.back().prev_address = text;
+            } else if (key == "value") {
+                tx_.inputs.back().prev_value = to_uint64(text);
+            }
+        }
+    }
+    
+private:
+    enum class Section { Other, Inputs, Outputs, Status };
+    
+    std::function<void(ChainTransaction&&)> emit_;
+    ChainTransaction tx_;
+    Section section_ = Section::Other;
+    bool in_prevout_ = false;
+};
+
+// Confirmed transactions as history entries
+static std::function<void(ChainTransaction&&)> append_history(std::vector<Transaction>& transactions) {
+    return [&transactions](ChainTransaction&& tx) {
+        if (tx.confirmed) {
+            auto timestamp = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(tx.block_time));
+            transactions.emplace_back(tx.txid, "unknown", "unknown", 0.0, timestamp);
+        }
+    };
+}
+
+// Sum of the UTXO values in an /address/<addr>/utxo response
+static double parse_balance(const std::string& response) {
+    UtxoValueSum sum;
+    ResponseParser parser(sum, "balance response");
+    parser.feed(response);
+    parser.finish();
+    return sum.satoshis / 100000000.0; // Convert satoshis to BTC
+}
+
+static AddressStats parse_address_stats(const std::string& response) {
     try {
         auto json = nlohmann::json::parse(response);
-        double balance = 0.0;
+        AddressStats stats{0, 0.0, 0, 0};
+        int64_t satoshis = 0;
         
-        for (const auto& utxo : json) {
-            if (utxo.contains("value") && utxo["value"].is_number()) {
-                balance += utxo["value"].get<double>() / 100000000.0; // Convert satoshis to BTC
+        for (const char* section : {"chain_stats", "mempool_stats"}) {
+            if (!json.contains(section)) {
+                continue;
             }
+            const auto& s = json[section];
+            uint64_t tx_count = s.value("tx_count", uint64_t(0));
+            stats.tx_count += tx_count;
+            int64_t section_satoshis = s.value("funded_txo_sum", int64_t(0)) - s.value("spent_txo_sum", int64_t(0));
+            if (std::string(section) == "mempool_stats") {
+                stats.mempool_tx_count = tx_count;
+            } else {
+                stats.confirmed_satoshis = section_satoshis;
+            }
+            satoshis += section_satoshis;
         }
         
-        return balance;
+        stats.balance = satoshis / 100000000.0; // Convert satoshis to BTC
+        return stats;
     } catch (const std::exception& e) {
-        throw WalletError::network("Failed to parse balance response: " + std::string(e.what()));
+        throw WalletError::network("Failed to parse address stats: " + std::string(e.what()));
     }
 }
 
-std::string NetworkClient::send_transaction(
-    const std::string& from_address,
-    const std::string& to_address,
-    double amount
-) const {
-    // This is a simplified implementation
-    // In a real wallet, you would:
-    // 1. Get UTXOs for the from_address
-    // 2. Create a proper Bitcoin transaction
-    // 3. Sign the transaction with the private key
-    // 4. Broadcast the transaction to the network
-    
-    // For now, we'll simulate a transaction
-    std::string tx_hash = "tx_" + from_address + "_" + to_address + "_" + std::to_string(amount);
+double NetworkClient::get_balance(const std::string& address) const {
+    std::string url = base_url_ + "/address/" + address + "/utxo";
+    return parse_balance(http_get(url));
+}
+
+std::vector<AddressBalance> NetworkClient::get_balances(const std::vector<std::string>& addresses,
+                                                        size_t concurrency) const {
+    std::vector<std::string> urls;
+    urls.reserve(addresses.size());
+    for (const auto& address : addresses) {
+        urls.push_back(base_url_ + "/address/" + address + "/utxo");
+    }
     
-    // In a real implementation, you would broadcast to the network
-    // For demo purposes, we'll just return a mock hash
-    return tx_hash;
+    std::vector<AddressBalance> balances(addresses.size(), AddressBalance{0.0, ""});
+    ResponseCache::shared().get_many(urls, concurrency,
+        [&](size_t i, std::string&& body, const std::string& error) {
+            if (!error.empty()) {
+                balances[i].error = error;
+                return;
+            }
+            try {
+                balances[i].balance = parse_balance(body);
+            } catch (const WalletError& e) {
+                balances[i].error = e.what();
+            }
+        });
+    return balances;
 }
 
-std::vector<Transaction> NetworkClient::get_transaction_history(const std::string& address) const {
-    std::string url = base_url_ + "/address/" + address + "/txs";
-    std::string response = http_get(url);
+std::string NetworkClient::send_transaction(const std::string& raw_hex) const {
+    // Esplora answers with the txid as plain text
+    std::string txid = http_post(base_url_ + "/tx", raw_hex);
+    while (!txid.empty() && std::isspace(static_cast<unsigned char>(txid.back()))) {
+        txid.pop_back();
+    }
+    if (txid.size() != 64) {
+        throw WalletError::network("Unexpected broadcast response: " + txid.substr(0, 200));
+    }
+    return txid;
+}
+
+double NetworkClient::estimate_fee_rate(uint32_t confirmation_target) const {
+    std::string body = http_get(base_url_ + "/fee-estimates");
     
+    // Keys are confirmation targets in blocks. Take the estimate for the
+    // largest target within the one asked for, or the fastest on offer.
+    double rate = 0;
+    long best_target = -1;
+    long fastest_target = -1;
+    double fastest_rate = 0;
     try {
-        auto json = nlohmann::json::parse(response);
-        std::vector<Transaction> transactions;
-        
-        for (const auto& tx : json) {
-            if (tx.contains("txid") && tx.contains("status") && 
-                tx["status"].contains("block_time")) {
-                
-                std::string hash = tx["txid"];
-                auto time_t = tx["status"]["block_time"].get<uint64_t>();
-                auto timestamp = std::chrono::system_clock::from_time_t(time_t);
-                
-                transactions.emplace_back(hash, "unknown", "unknown", 0.0, timestamp);
+        auto estimates = nlohmann::json::parse(body);
+        for (auto it = estimates.begin(); it != estimates.end(); ++it) {
+            long target = std::strtol(it.key().c_str(), nullptr, 10);
+            double value = it.value().get<double>();
+            if (target <= static_cast<long>(confirmation_target) && target > best_target) {
+                best_target = target;
+                rate = value;
+            }
+            if (fastest_target < 0 || target < fastest_target) {
+                fastest_target = target;
+                fastest_rate = value;
             }
         }
-        
-        return transactions;
-    } catch (const std::exception& e) {
-        throw WalletError::network("Failed to parse transaction history: " + std::string(e.what()));
+    } catch (const nlohmann::json::exception& e) {
+        throw WalletError::network("Failed to parse fee estimates: " + std::string(e.what()));
+    }
+    if (best_target < 0) {
+        rate = fastest_rate;
     }
+    
+    // Nodes relay nothing below 1 sat/vB; an empty map means no data yet
+    return std::max(rate, MIN_FEE_RATE);
 }
 
-std::string NetworkClient::http_get(const std::string& url) const {
-    CURL* curl;
-    CURLcode res;
-    std::string readBuffer;
-    
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            throw WalletError::http("CURL error: " + std::string(curl_easy_strerror(res)));
-        }
-    } else {
-        throw WalletError::http("Failed to initialize CURL");
+void NetworkClient::forget_address(const std::string& address) const {
+    std::string url = base_url_ + "/address/" + address;
+    ResponseCache::shared().invalidate(url);
+    ResponseCache::shared().invalidate(url + "/utxo");
+    ResponseCache::shared().invalidate(url + "/txs");
+}
+
+std::vector<Transaction> NetworkClient::get_transaction_history(const std::string& address) const {
+    std::string url = base_url_ + "/address/" + address + "/txs";
+    
+    // Parsed off the wire rather than buffered; the UTXO index is what
+    // keeps history between calls
+    std::vector<Transaction> transactions;
+    TransactionExtractor extractor(append_history(transactions));
+    ResponseParser parser(extractor, "transaction history");
+    HttpClient::shared().get(url, [&parser](const char* data, size_t size) { parser.feed(data, size); });
+    parser.finish();
+    
+    return transactions;
+}
+
+std::vector<Transaction> NetworkClient::parse_transactions(const std::string& json_response) const {
+    std::vector<Transaction> transactions;
+    TransactionExtractor extractor(append_history(transactions));
+    ResponseParser parser(extractor, "transaction history");
+    parser.feed(json_response);
+    parser.finish();
+    return transactions;
+}
+
+AddressStats NetworkClient::get_address_stats(const std::string& address) const {
+    std::string url = base_url_ + "/address/" + address;
+    return parse_address_stats(http_get(url));
+}
+
+std::vector<AddressStats> NetworkClient::get_address_stats(const std::vector<std::string>& addresses,
+                                                           size_t concurrency) const {
+    std::vector<std::string> urls;
+    urls.reserve(addresses.size());
+    for (const auto& address : addresses) {
+        urls.push_back(base_url_ + "/address/" + address);
     }
     
-    return readBuffer;
+    std::vector<AddressStats> stats(addresses.size(), AddressStats{0, 0.0, 0, 0});
+    ResponseCache::shared().get_many(urls, concurrency,
+        [&](size_t i, std::string&& body, const std::string& error) {
+            if (!error.empty()) {
+                throw WalletError::http(error);
+            }
+            stats[i] = parse_address_stats(body);
+        });
+    return stats;
 }
 
-std::string NetworkClient::http_post(const std::string& url, const std::string& data) const {
-    CURL* curl;
-    CURLcode res;
-    std::string readBuffer;
-    
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
-        
-        if (res != CURLE_OK) {
-            throw WalletError::http("CURL error: " + std::string(curl_easy_strerror(res)));
+std::vector<TransactionPage> NetworkClient::get_transaction_pages(const std::vector<std::string>& addresses,
+                                                                  const std::vector<std::string>& after_txids,
+                                                                  size_t concurrency) const {
+    std::vector<std::string> urls;
+    urls.reserve(addresses.size());
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        std::string url = base_url_ + "/address/" + addresses[i] + "/txs";
+        if (!after_txids[i].empty()) {
+            url += "/chain/" + after_txids[i];
         }
-    } else {
-        throw WalletError::http("Failed to initialize CURL");
+        urls.push_back(std::move(url));
     }
     
-    return readBuffer;
+    // Each page is parsed as it streams in, so only the extracted fields
+    // are ever held, and one transaction at a time at that
+    struct PageStream {
+        TransactionExtractor extractor;
+        ResponseParser parser;
+        
+        explicit PageStream(std::vector<ChainTransaction>& transactions)
+            : extractor([&transactions](ChainTransaction&& tx) { transactions.push_back(std::move(tx)); }),
+              parser(extractor, "transactions") {}
+    };
+    
+    std::vector<TransactionPage> pages(addresses.size());
+    std::vector<std::unique_ptr<PageStream>> streams;
+    streams.reserve(addresses.size());
+    for (auto& page : pages) {
+        streams.push_back(std::make_unique<PageStream>(page.transactions));
+    }
+    
+    HttpClient::shared().get_many(urls, concurrency,
+        [&](size_t i, const char* data, size_t size) { streams[i]->parser.feed(data, size); },
+        [&](size_t i, std::string&&, const std::string& error) {
+            if (error.empty()) {
+                try {
+                    streams[i]->parser.finish();
+                } catch (const WalletError& e) {
+                    pages[i].error = e.what();
+                }
+            } else {
+                pages[i].error = error;
+            }
+            if (!pages[i].ok()) {
+                pages[i].transactions.clear();
+            }
+            streams[i].reset();
+        });
+    return pages;
+}
+
+// Both go through the shared pooled client, so repeated lookups reuse warm
+// connections instead of resolving and handshaking per request. Reads are
+// answered from the response cache when it can.
+std::string NetworkClient::http_get(const std::string& url) const {
+    return ResponseCache::shared().get(url);
+}
+
+std::string NetworkClient::http_post(const std::string& url, const std::string& data) const {
+    return HttpClient::shared().post(url, data);
 }
 
 } // namespace crypto_wallet
@@ -0,0 +1,351 @@
+#include "response_cache.h"
+#include <algorithm>
+
+namespace crypto_wallet {
+
+// Background revalidations in flight at once
+static constexpr size_t REFRESH_CONCURRENCY = 8;
+
+ResponseCache::ResponseCache(HttpClient& client, size_t capacity)
+    : client_(client),
+      capacity_(std::max<size_t>(capacity, 1)),
+      next_generation_(0),
+      stopping_(false),
+      hits_(0),
+      stale_hits_(0),
+      misses_(0),
+      coalesced_(0),
+      refreshes_(0),
+      errors_(0) {
+    using std::chrono::seconds;
+    // Balances move with every block or mempool transaction; confirmed
+    // history mostly grows at the end
+    policies_[static_cast<int>(Endpoint::Utxo)] = CachePolicy{seconds(10), seconds(60)};
+    policies_[static_cast<int>(Endpoint::Transactions)] = CachePolicy{seconds(30), seconds(300)};
+    policies_[static_cast<int>(Endpoint::Address)] = CachePolicy{seconds(10), seconds(60)};
+    policies_[static_cast<int>(Endpoint::Other)] = CachePolicy{seconds(0), seconds(0)};
+
+    refresher_ = std::thread(&ResponseCache::refresh_loop, this);
+}
+
+ResponseCache::~ResponseCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    refresh_ready_.notify_all();
+    refresher_.join();
+}
+
+ResponseCache& ResponseCache::shared() {
+    static ResponseCache cache(HttpClient::shared());
+    return cache;
+}
+
+Endpoint ResponseCache::classify(const std::string& url) {
+    auto ends_with = [&url](const std::string& suffix) {
+        return url.size() >= suffix.size() && url.compare(url.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (url.find("/address/") == std::string::npos) {
+        return Endpoint::Other;
+    }
+    if (ends_with("/utxo")) {
+        return Endpoint::Utxo;
+    }
+    if (ends_with("/txs") || url.find("/txs/") != std::string::npos) {
+        return Endpoint::Transactions;
+    }
+    return Endpoint::Address;
+}
+
+void ResponseCache::set_policy(Endpoint endpoint, CachePolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    policies_[static_cast<int>(endpoint)] = policy;
+}
+
+ResponseCache::Entry& ResponseCache::touch(const std::string& url) {
+    auto it = entries_.find(url);
+    if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return it->second;
+    }
+    lru_.push_front(url);
+    Entry& entry = entries_[url];
+    entry.lru = lru_.begin();
+    entry.generation = ++next_generation_;
+    evict();
+    return entry;
+}
+
+void ResponseCache::evict() {
+    // Entries with a request in flight stay; their waiters need them
+    auto it = lru_.end();
+    while (entries_.size() > capacity_ && it != lru_.begin()) {
+        --it;
+        auto entry = entries_.find(*it);
+        if (entry->second.flight.valid()) {
+            continue;
+        }
+        entries_.erase(entry);
+        it = lru_.erase(it);
+    }
+}
+
+ResponseCache::Lookup ResponseCache::lookup(const std::string& url, std::string& body, Flight& flight,
+                                            std::shared_ptr<std::promise<std::string>>& promise,
+                                            uint64_t& generation) {
+    Entry& entry = touch(url);
+    const CachePolicy& policy = policies_[static_cast<int>(classify(url))];
+
+    if (entry.has_body) {
+        auto age = std::chrono::steady_clock::now() - entry.fetched;
+        if (age < policy.ttl) {
+            ++hits_;
+            body = entry.body;
+            return Lookup::Fresh;
+        }
+        if (age < policy.ttl + policy.stale_for) {
+            ++stale_hits_;
+            body = entry.body;
+            if (!entry.flight.valid()) {
+                auto refresh = std::make_shared<std::promise<std::string>>();
+                entry.flight = refresh->get_future().share();
+                refresh_queue_.push_back(Refresh{url, std::move(refresh), entry.generation});
+                refresh_ready_.notify_one();
+            }
+            return Lookup::Stale;
+        }
+    }
+
+    if (entry.flight.valid()) {
+        ++coalesced_;
+        flight = entry.flight;
+        return Lookup::InFlight;
+    }
+
+    ++misses_;
+    promise = std::make_shared<std::promise<std::string>>();
+    entry.flight = promise->get_future().share();
+    generation = entry.generation;
+    return Lookup::Miss;
+}
+
+void ResponseCache::complete(const std::string& url, uint64_t generation, std::promise<std::string>& promise,
+                             std::string body) {
+    {
+        // A response fetched before an invalidation answers its waiters but
+        // is not stored over the invalidated entry
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(url);
+        if (it != entries_.end() && it->second.generation == generation) {
+            it->second.body = body;
+            it->second.has_body = true;
+            it->second.fetched = std::chrono::steady_clock::now();
+            it->second.flight = Flight();
+        }
+    }
+    promise.set_value(std::move(body));
+}
+
+void ResponseCache::fail(const std::string& url, uint64_t generation, std::promise<std::string>& promise,
+                         const std::string& error) {
+    ++errors_;
+    {
+        // Any stale body stays; the next stale hit retries the refresh
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(url);
+        if (it != entries_.end() && it->second.generation == generation) {
+            it->second.flight = Flight();
+        }
+    }
+    promise.set_exception(std::make_exception_ptr(WalletError::http(error)));
+}
+
+std::string ResponseCache::get(const std::string& url) {
+    std::string body;
+    Flight flight;
+    std::shared_ptr<std::promise<std::string>> promise;
+    uint64_t generation = 0;
+    Lookup result;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result = lookup(url, body, flight, promise, generation);
+    }
+
+    if (result == Lookup::Fresh || result == Lookup::Stale) {
+        return body;
+    }
+    if (result == Lookup::InFlight) {
+        return flight.get();
+    }
+
+    try {
+        body = client_.get(url);
+    } catch (const WalletError& e) {
+        fail(url, generation, *promise, e.what());
+        throw;
+    }
+    complete(url, generation, *promise, body);
+    return body;
+}
+
+void ResponseCache::get_many(const std::vector<std::string>& urls, size_t concurrency,
+                             const HttpBatchHandler& handler) {
+    struct Ready {
+        size_t index;
+        std::string body;
+    };
+    struct Waiting {
+        size_t index;
+        Flight flight;
+    };
+    std::vector<Ready> ready;
+    std::vector<Waiting> waiting;
+    std::vector<std::string> fetch_urls;
+    std::vector<size_t> fetch_index;
+    std::vector<std::shared_ptr<std::promise<std::string>>> promises;
+    std::vector<uint64_t> generations;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < urls.size(); ++i) {
+            std::string body;
+            Flight flight;
+            std::shared_ptr<std::promise<std::string>> promise;
+            uint64_t generation = 0;
+            switch (lookup(urls[i], body, flight, promise, generation)) {
+            case Lookup::Fresh:
+            case Lookup::Stale:
+                ready.push_back(Ready{i, std::move(body)});
+                break;
+            case Lookup::InFlight:
+                waiting.push_back(Waiting{i, std::move(flight)});
+                break;
+            case Lookup::Miss:
+                fetch_urls.push_back(urls[i]);
+                fetch_index.push_back(i);
+                promises.push_back(std::move(promise));
+                generations.push_back(generation);
+                break;
+            }
+        }
+    }
+
+    // Every flight registered above has to be settled, even when the
+    // handler throws, or other callers would wait on it forever
+    std::vector<bool> settled(fetch_urls.size(), false);
+    try {
+        for (auto& hit : ready) {
+            handler(hit.index, std::move(hit.body), std::string());
+        }
+
+        client_.get_many(fetch_urls, concurrency, [&](size_t j, std::string&& body, const std::string& error) {
+            settled[j] = true;
+            if (error.empty()) {
+                complete(fetch_urls[j], generations[j], *promises[j], body);
+            } else {
+                fail(fetch_urls[j], generations[j], *promises[j], error);
+            }
+            handler(fetch_index[j], std::move(body), error);
+        });
+
+        for (auto& wait : waiting) {
+            std::string body;
+            std::string error;
+            try {
+                body = wait.flight.get();
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            handler(wait.index, std::move(body), error);
+        }
+    } catch (...) {
+        for (size_t j = 0; j < settled.size(); ++j) {
+            if (!settled[j]) {
+                fail(fetch_urls[j], generations[j], *promises[j], "Request abandoned");
+            }
+        }
+        throw;
+    }
+}
+
+// Forgets the body and detaches any flight, so the next request goes
+// upstream rather than joining one that started before the change
+void ResponseCache::drop(Entry& entry) {
+    entry.has_body = false;
+    entry.body.clear();
+    entry.flight = Flight();
+    entry.generation = ++next_generation_;
+}
+
+void ResponseCache::invalidate(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(url);
+    if (it != entries_.end()) {
+        drop(it->second);
+    }
+}
+
+void ResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : entries_) {
+        drop(entry.second);
+    }
+}
+
+ResponseCacheStats ResponseCache::stats() const {
+    ResponseCacheStats stats{};
+    stats.hits = hits_;
+    stats.stale_hits = stale_hits_;
+    stats.misses = misses_;
+    stats.coalesced = coalesced_;
+    stats.refreshes = refreshes_;
+    stats.errors = errors_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.size = entries_.size();
+    return stats;
+}
+
+void ResponseCache::refresh_loop() {
+    while (true) {
+        std::vector<Refresh> batch;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            refresh_ready_.wait(lock, [&] { return stopping_ || !refresh_queue_.empty(); });
+            batch.swap(refresh_queue_);
+            stopping = stopping_;
+        }
+        if (stopping) {
+            for (auto& refresh : batch) {
+                fail(refresh.url, refresh.generation, *refresh.promise, "Response cache shut down");
+            }
+            return;
+        }
+
+        std::vector<std::string> urls;
+        for (const auto& refresh : batch) {
+            urls.push_back(refresh.url);
+        }
+        std::vector<bool> settled(batch.size(), false);
+        try {
+            client_.get_many(urls, REFRESH_CONCURRENCY, [&](size_t j, std::string&& body, const std::string& error) {
+                settled[j] = true;
+                ++refreshes_;
+                if (error.empty()) {
+                    complete(batch[j].url, batch[j].generation, *batch[j].promise, std::move(body));
+                } else {
+                    fail(batch[j].url, batch[j].generation, *batch[j].promise, error);
+                }
+            });
+        } catch (const std::exception& e) {
+            for (size_t j = 0; j < batch.size(); ++j) {
+                if (!settled[j]) {
+                    fail(batch[j].url, batch[j].generation, *batch[j].promise, e.what());
+                }
+            }
+        }
+    }
+}
+
+} // namespace crypto_wallet
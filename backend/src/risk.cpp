@@ -0,0 +1,242 @@
+#include "risk.h"
+#include <sstream>
+#include <algorithm>
+
+namespace crypto_wallet {
+
+std::string RiskCheckResult::to_error_message() const {
+    std::ostringstream ss;
+    ss << RiskEngine::reason_to_string(reason) << ": ";
+
+    switch (reason) {
+        case RiskRejectReason::NONE:
+            ss << "accepted";
+            break;
+        case RiskRejectReason::UNKNOWN_PAIR:
+            ss << "trading pair is not listed";
+            break;
+        case RiskRejectReason::PAIR_INACTIVE:
+            ss << "trading pair is not active";
+            break;
+        case RiskRejectReason::BELOW_MIN_AMOUNT:
+            ss << "amount " << actual << " is below minimum " << limit;
+            break;
+        case RiskRejectReason::ABOVE_MAX_AMOUNT:
+            ss << "amount " << actual << " exceeds maximum " << limit;
+            break;
+        case RiskRejectReason::INSUFFICIENT_BALANCE:
+            ss << "required " << actual << " but only " << limit << " available";
+            break;
+        case RiskRejectReason::EXPOSURE_LIMIT:
+            ss << "open notional " << actual << " would exceed limit " << limit;
+            break;
+        case RiskRejectReason::RATE_LIMIT:
+            ss << "more than " << limit << " orders per second";
+            break;
+    }
+
+    return ss.str();
+}
+
+RiskEngine::RiskEngine() : default_limits_{1000000.0, 10.0, 20.0} {}
+
+const char* RiskEngine::reason_to_string(RiskRejectReason reason) {
+    switch (reason) {
+        case RiskRejectReason::NONE: return "NONE";
+        case RiskRejectReason::UNKNOWN_PAIR: return "UNKNOWN_PAIR";
+        case RiskRejectReason::PAIR_INACTIVE: return "PAIR_INACTIVE";
+        case RiskRejectReason::BELOW_MIN_AMOUNT: return "BELOW_MIN_AMOUNT";
+        case RiskRejectReason::ABOVE_MAX_AMOUNT: return "ABOVE_MAX_AMOUNT";
+        case RiskRejectReason::INSUFFICIENT_BALANCE: return "INSUFFICIENT_BALANCE";
+        case RiskRejectReason::EXPOSURE_LIMIT: return "EXPOSURE_LIMIT";
+        case RiskRejectReason::RATE_LIMIT: return "RATE_LIMIT";
+        default: return "UNKNOWN";
+    }
+}
+
+void RiskEngine::set_trading_pair(const TradingPair& pair) {
+    PairLimits limits{pair.min_amount, pair.max_amount, pair.is_active,
+                      asset_id(pair.base_asset), asset_id(pair.quote_asset)};
+
+    auto it = pair_ids_.find(pair.symbol);
+    if (it != pair_ids_.end()) {
+        pairs_[it->second] = limits;
+    } else {
+        pair_ids_[pair.symbol] = static_cast<uint32_t>(pairs_.size());
+        pairs_.push_back(limits);
+    }
+}
+
+void RiskEngine::set_default_limits(const WalletLimits& limits) {
+    default_limits_ = limits;
+}
+
+void RiskEngine::set_wallet_limits(const std::string& wallet_name, const WalletLimits& limits) {
+    WalletState& wallet = wallet_state(wallet_name);
+    wallet.limits = limits;
+    wallet.tokens = std::min(wallet.tokens, limits.max_order_burst);
+}
+
+void RiskEngine::set_default_balances(const std::map<std::string, double>& balances) {
+    for (const auto& balance : balances) {
+        uint32_t id = asset_id(balance.first);
+        default_balances_[id] = balance.second;
+    }
+}
+
+RiskCheckResult RiskEngine::check_order(const Order& order, double reference_price) {
+    const PairLimits* pair = find_pair(order.pair);
+    if (!pair) {
+        return {RiskRejectReason::UNKNOWN_PAIR, 0.0, 0.0};
+    }
+
+    WalletState& wallet = wallet_state(order.wallet_name);
+
+    // Token bucket refill; every checked order costs one token
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - wallet.last_refill).count();
+    wallet.last_refill = now;
+    wallet.tokens = std::min(wallet.limits.max_order_burst,
+                             wallet.tokens + elapsed * wallet.limits.max_orders_per_second);
+    if (wallet.tokens < 1.0) {
+        return {RiskRejectReason::RATE_LIMIT, wallet.limits.max_orders_per_second, 0.0};
+    }
+    wallet.tokens -= 1.0;
+
+    if (!pair->is_active) {
+        return {RiskRejectReason::PAIR_INACTIVE, 0.0, 0.0};
+    }
+
+    if (order.amount < pair->min_amount) {
+        return {RiskRejectReason::BELOW_MIN_AMOUNT, pair->min_amount, order.amount};
+    }
+
+    if (order.amount > pair->max_amount) {
+        return {RiskRejectReason::ABOVE_MAX_AMOUNT, pair->max_amount, order.amount};
+    }
+
+    double notional = order.amount * reference_price;
+    double exposure = wallet.open_notional + notional;
+    if (exposure > wallet.limits.max_open_notional) {
+        return {RiskRejectReason::EXPOSURE_LIMIT, wallet.limits.max_open_notional, exposure};
+    }
+
+    if (order.side == OrderSide::BUY) {
+        double available = wallet.balances[pair->quote_asset] - wallet.reserved[pair->quote_asset];
+        if (notional > available) {
+            return {RiskRejectReason::INSUFFICIENT_BALANCE, available, notional};
+        }
+    } else {
+        double available = wallet.balances[pair->base_asset] - wallet.reserved[pair->base_asset];
+        if (order.amount > available) {
+            return {RiskRejectReason::INSUFFICIENT_BALANCE, available, order.amount};
+        }
+    }
+
+    return {RiskRejectReason::NONE, 0.0, 0.0};
+}
+
+void RiskEngine::on_order_resting(const Order& order) {
+    apply_reservation(order, 1.0);
+}
+
+void RiskEngine::on_order_released(const Order& order) {
+    apply_reservation(order, -1.0);
+}
+
+void RiskEngine::on_order_filled(const Order& order) {
+    const PairLimits* pair = find_pair(order.pair);
+    if (!pair) {
+        return;
+    }
+
+    WalletState& wallet = wallet_state(order.wallet_name);
+    double quote_amount = order.filled_amount * order.price;
+
+    if (order.side == OrderSide::BUY) {
+        wallet.balances[pair->base_asset] += order.filled_amount;
+        wallet.balances[pair->quote_asset] -= quote_amount;
+    } else {
+        wallet.balances[pair->base_asset] -= order.filled_amount;
+        wallet.balances[pair->quote_asset] += quote_amount;
+    }
+}
+
+std::map<std::string, double> RiskEngine::get_balances(const std::string& wallet_name) const {
+    // Read-only lookup: unknown wallets report the defaults without gaining a row
+    auto it = wallet_ids_.find(wallet_name);
+    const std::vector<double>& row =
+        it != wallet_ids_.end() ? wallets_[it->second].balances : default_balances_;
+    std::map<std::string, double> balances;
+
+    for (size_t i = 0; i < assets_.size(); ++i) {
+        balances[assets_[i]] = row[i];
+    }
+
+    return balances;
+}
+
+uint32_t RiskEngine::asset_id(const std::string& asset) {
+    auto it = asset_ids_.find(asset);
+    if (it != asset_ids_.end()) {
+        return it->second;
+    }
+
+    // New assets widen every wallet row so checks can index without bounds tests
+    uint32_t id = static_cast<uint32_t>(assets_.size());
+    asset_ids_[asset] = id;
+    assets_.push_back(asset);
+    default_balances_.push_back(0.0);
+    for (auto& wallet : wallets_) {
+        wallet.balances.push_back(0.0);
+        wallet.reserved.push_back(0.0);
+    }
+
+    return id;
+}
+
+RiskEngine::WalletState& RiskEngine::wallet_state(const std::string& wallet_name) {
+    auto it = wallet_ids_.find(wallet_name);
+    if (it != wallet_ids_.end()) {
+        return wallets_[it->second];
+    }
+
+    WalletState wallet;
+    wallet.limits = default_limits_;
+    wallet.balances = default_balances_;
+    wallet.reserved.assign(assets_.size(), 0.0);
+    wallet.open_notional = 0.0;
+    wallet.tokens = default_limits_.max_order_burst;
+    wallet.last_refill = std::chrono::steady_clock::now();
+
+    wallet_ids_[wallet_name] = static_cast<uint32_t>(wallets_.size());
+    wallets_.push_back(std::move(wallet));
+    return wallets_.back();
+}
+
+const RiskEngine::PairLimits* RiskEngine::find_pair(const std::string& pair) const {
+    auto it = pair_ids_.find(pair);
+    if (it == pair_ids_.end()) {
+        return nullptr;
+    }
+    return &pairs_[it->second];
+}
+
+void RiskEngine::apply_reservation(const Order& order, double sign) {
+    const PairLimits* pair = find_pair(order.pair);
+    if (!pair) {
+        return;
+    }
+
+    WalletState& wallet = wallet_state(order.wallet_name);
+    double notional = order.remaining_amount * order.price;
+
+    wallet.open_notional += sign * notional;
+    if (order.side == OrderSide::BUY) {
+        wallet.reserved[pair->quote_asset] += sign * notional;
+    } else {
+        wallet.reserved[pair->base_asset] += sign * order.remaining_amount;
+    }
+}
+
+} // namespace crypto_wallet
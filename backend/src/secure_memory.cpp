@@ -0,0 +1,34 @@
+#include "secure_memory.h"
+#include "error.h"
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace crypto_wallet {
+
+LockedBuffer::LockedBuffer(size_t size) : size_(size), locked_(false) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    mapped_size_ = (std::max<size_t>(size, 1) + page - 1) / page * page;
+
+    void* mapping = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw WalletError::crypto("Failed to allocate secure memory");
+    }
+    data_ = static_cast<uint8_t*>(mapping);
+
+    locked_ = mlock(data_, mapped_size_) == 0;
+#ifdef MADV_DONTDUMP
+    madvise(data_, mapped_size_, MADV_DONTDUMP);
+#endif
+}
+
+LockedBuffer::~LockedBuffer() {
+    OPENSSL_cleanse(data_, mapped_size_);
+    if (locked_) {
+        munlock(data_, mapped_size_);
+    }
+    munmap(data_, mapped_size_);
+}
+
+} // namespace crypto_wallet
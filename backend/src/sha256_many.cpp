@@ -0,0 +1,421 @@
+#include "crypto.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRYPTO_WALLET_SHA256_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+namespace crypto_wallet {
+
+static constexpr uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static constexpr uint32_t SHA256_INIT[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// One message split into the blocks read straight from the caller's buffer
+// and the one or two padded blocks at the end
+struct Sha256Lane {
+    const uint8_t* data;
+    size_t full_blocks;
+    size_t total_blocks;
+    alignas(16) uint8_t tail[128];
+
+    void prepare(const uint8_t* message, size_t size) {
+        data = message;
+        full_blocks = size / 64;
+        size_t rest = size % 64;
+        size_t tail_blocks = rest + 9 <= 64 ? 1 : 2;
+        total_blocks = full_blocks + tail_blocks;
+
+        if (rest > 0) {
+            std::memcpy(tail, message + full_blocks * 64, rest);
+        }
+        tail[rest] = 0x80;
+        size_t length_offset = tail_blocks * 64 - 8;
+        std::memset(tail + rest + 1, 0, length_offset - rest - 1);
+        uint64_t bits = static_cast<uint64_t>(size) * 8;
+        for (int i = 7; i >= 0; --i) {
+            tail[length_offset + i] = static_cast<uint8_t>(bits);
+            bits >>= 8;
+        }
+    }
+
+    const uint8_t* block(size_t index) const {
+        return index < full_blocks ? data + index * 64 : tail + (index - full_blocks) * 64;
+    }
+};
+
+static void store_digest(const uint32_t* state, uint8_t* out) {
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        out[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        out[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        out[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+#ifdef CRYPTO_WALLET_SHA256_X86
+
+// SHA extensions. The round instructions have a long latency, so LANES
+// messages with the same block count are interleaved to keep them busy.
+template <int LANES>
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(const Sha256Lane* lanes, std::array<uint8_t, 32>* const* out) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The round instructions want the state as ABEF / CDGH
+    __m128i state0[LANES];
+    __m128i state1[LANES];
+    for (int n = 0; n < LANES; ++n) {
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_INIT)), 0xB1);
+        state1[n] = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_INIT + 4)), 0x1B);
+        state0[n] = _mm_alignr_epi8(tmp, state1[n], 8);
+        state1[n] = _mm_blend_epi16(state1[n], tmp, 0xF0);
+    }
+
+    for (size_t b = 0; b < lanes[0].total_blocks; ++b) {
+        __m128i abef[LANES];
+        __m128i cdgh[LANES];
+        __m128i w[LANES][4];
+        for (int n = 0; n < LANES; ++n) {
+            abef[n] = state0[n];
+            cdgh[n] = state1[n];
+            const uint8_t* block = lanes[n].block(b);
+            for (int i = 0; i < 4; ++i) {
+                w[n][i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i)), byte_swap);
+            }
+        }
+
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; ++i) {
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_K + 4 * i));
+            for (int n = 0; n < LANES; ++n) {
+                __m128i msg = _mm_add_epi32(w[n][i & 3], k);
+                state1[n] = _mm_sha256rnds2_epu32(state1[n], state0[n], msg);
+                state0[n] = _mm_sha256rnds2_epu32(state0[n], state1[n], _mm_shuffle_epi32(msg, 0x0E));
+                if (i < 12) {
+                    // Schedule words 4(i+4)..4(i+4)+3 into the slot just consumed
+                    __m128i next = _mm_sha256msg1_epu32(w[n][i & 3], w[n][(i + 1) & 3]);
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(w[n][(i + 3) & 3], w[n][(i + 2) & 3], 4));
+                    w[n][i & 3] = _mm_sha256msg2_epu32(next, w[n][(i + 3) & 3]);
+                }
+            }
+        }
+
+        for (int n = 0; n < LANES; ++n) {
+            state0[n] = _mm_add_epi32(state0[n], abef[n]);
+            state1[n] = _mm_add_epi32(state1[n], cdgh[n]);
+        }
+    }
+
+    for (int n = 0; n < LANES; ++n) {
+        __m128i tmp = _mm_shuffle_epi32(state0[n], 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(state1[n], 0xB1);
+        alignas(16) uint32_t state[8];
+        _mm_store_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(tmp, dchg, 0xF0));
+        _mm_store_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, tmp, 8));
+        store_digest(state, out[n]->data());
+    }
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_many_shani(const uint8_t* const* data, const size_t* sizes, size_t count,
+                              std::array<uint8_t, 32>* out) {
+    Sha256Lane lanes[2];
+    std::array<uint8_t, 32>* outputs[2];
+    size_t i = 0;
+    while (i < count) {
+        lanes[0].prepare(data[i], sizes[i]);
+        outputs[0] = &out[i];
+        if (i + 1 < count) {
+            lanes[1].prepare(data[i + 1], sizes[i + 1]);
+            if (lanes[1].total_blocks == lanes[0].total_blocks) {
+                outputs[1] = &out[i + 1];
+                sha256_blocks_shani<2>(lanes, outputs);
+                i += 2;
+                continue;
+            }
+        }
+        sha256_blocks_shani<1>(lanes, outputs);
+        ++i;
+    }
+}
+
+// AVX2: eight messages side by side, one per 32-bit lane
+
+#define SHA256_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+// rows[j] holds eight words of message j; afterwards rows[t] holds word t
+// of every message
+__attribute__((target("avx2")))
+static inline void transpose8(__m256i* rows) {
+    __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void sha256_block_avx2(__m256i* state, const uint8_t* const* blocks) {
+    const __m256i byte_swap = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    __m256i w[16];
+    for (int half = 0; half < 2; ++half) {
+        for (int j = 0; j < 8; ++j) {
+            w[8 * half + j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[j] + 32 * half));
+        }
+        transpose8(w + 8 * half);
+    }
+    for (int t = 0; t < 16; ++t) {
+        w[t] = _mm256_shuffle_epi8(w[t], byte_swap);
+    }
+
+    __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+#pragma GCC unroll 64
+    for (int t = 0; t < 64; ++t) {
+        if (t >= 16) {
+            __m256i w15 = w[(t - 15) & 15];
+            __m256i w2 = w[(t - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR(w15, 7), SHA256_ROTR(w15, 18)),
+                                          _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR(w2, 17), SHA256_ROTR(w2, 19)),
+                                          _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0),
+                                         _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+
+        __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR(e, 6), SHA256_ROTR(e, 11)),
+                                          SHA256_ROTR(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                                      _mm256_add_epi32(ch, _mm256_add_epi32(
+                                          _mm256_set1_epi32(static_cast<int>(SHA256_K[t])), w[t & 15])));
+        __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR(a, 2), SHA256_ROTR(a, 13)),
+                                          SHA256_ROTR(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(sigma0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    state[0] = _mm256_add_epi32(state[0], a);
+    state[1] = _mm256_add_epi32(state[1], b);
+    state[2] = _mm256_add_epi32(state[2], c);
+    state[3] = _mm256_add_epi32(state[3], d);
+    state[4] = _mm256_add_epi32(state[4], e);
+    state[5] = _mm256_add_epi32(state[5], f);
+    state[6] = _mm256_add_epi32(state[6], g);
+    state[7] = _mm256_add_epi32(state[7], h);
+}
+
+#undef SHA256_ROTR
+
+__attribute__((target("avx2")))
+static void sha256_many_avx2(const uint8_t* const* data, const size_t* sizes, size_t count,
+                             std::array<uint8_t, 32>* out) {
+    Sha256Lane lanes[8];
+
+    for (size_t first = 0; first < count; first += 8) {
+        size_t lane_count = std::min<size_t>(8, count - first);
+        size_t max_blocks = 0;
+        for (size_t j = 0; j < lane_count; ++j) {
+            lanes[j].prepare(data[first + j], sizes[first + j]);
+            max_blocks = std::max(max_blocks, lanes[j].total_blocks);
+        }
+
+        __m256i state[8];
+        for (int i = 0; i < 8; ++i) {
+            state[i] = _mm256_set1_epi32(static_cast<int>(SHA256_INIT[i]));
+        }
+
+        // Lanes that are finished or unused hash throwaway blocks; each
+        // digest is read out right after its message's last block
+        const uint8_t* blocks[8];
+        for (size_t b = 0; b < max_blocks; ++b) {
+            for (size_t j = 0; j < 8; ++j) {
+                blocks[j] = j < lane_count && b < lanes[j].total_blocks ? lanes[j].block(b) : lanes[0].tail;
+            }
+            sha256_block_avx2(state, blocks);
+
+            alignas(32) uint32_t words[8][8];
+            bool stored = false;
+            for (size_t j = 0; j < lane_count; ++j) {
+                if (lanes[j].total_blocks != b + 1) {
+                    continue;
+                }
+                if (!stored) {
+                    for (int i = 0; i < 8; ++i) {
+                        _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+                    }
+                    stored = true;
+                }
+                uint32_t digest_state[8];
+                for (int i = 0; i < 8; ++i) {
+                    digest_state[i] = words[i][j];
+                }
+                store_digest(digest_state, out[first + j].data());
+            }
+        }
+    }
+}
+
+static bool cpu_has_sha_ni() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & (1u << 29))) {
+        return false;
+    }
+    return __builtin_cpu_supports("sse4.1");
+}
+
+#endif // CRYPTO_WALLET_SHA256_X86
+
+bool Crypto::sha256_kernel_supported(Sha256Kernel kernel) {
+    switch (kernel) {
+    case Sha256Kernel::AUTO:
+    case Sha256Kernel::SCALAR:
+        return true;
+#ifdef CRYPTO_WALLET_SHA256_X86
+    case Sha256Kernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case Sha256Kernel::SHA_NI: {
+        static const bool supported = cpu_has_sha_ni();
+        return supported;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+Sha256Kernel Crypto::sha256_best_kernel() {
+    static const Sha256Kernel kernel = [] {
+        if (sha256_kernel_supported(Sha256Kernel::SHA_NI)) {
+            return Sha256Kernel::SHA_NI;
+        }
+        if (sha256_kernel_supported(Sha256Kernel::AVX2)) {
+            return Sha256Kernel::AVX2;
+        }
+        return Sha256Kernel::SCALAR;
+    }();
+    return kernel;
+}
+
+// What AUTO uses for a message of `size` bytes. The SIMD kernels only win
+// while per-call overhead dominates: against an OpenSSL that itself uses SHA
+// extensions, AVX2 breaks even at two blocks and loses on long inputs, and
+// SHA-NI is still ahead at two blocks but not beyond.
+static Sha256Kernel auto_kernel(size_t size) {
+    size_t blocks = (size + 9 + 63) / 64;
+    Sha256Kernel best = Crypto::sha256_best_kernel();
+    if (blocks == 1) {
+        return best;
+    }
+    if (blocks == 2 && best == Sha256Kernel::SHA_NI) {
+        return best;
+    }
+    return Sha256Kernel::SCALAR;
+}
+
+static void sha256_run(const uint8_t* const* data, const size_t* sizes, size_t count,
+                       std::array<uint8_t, 32>* out, Sha256Kernel kernel) {
+    switch (kernel) {
+#ifdef CRYPTO_WALLET_SHA256_X86
+    case Sha256Kernel::SHA_NI:
+        sha256_many_shani(data, sizes, count, out);
+        return;
+    case Sha256Kernel::AVX2:
+        sha256_many_avx2(data, sizes, count, out);
+        return;
+#endif
+    default:
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = Crypto::sha256(data[i], sizes[i]);
+        }
+        return;
+    }
+}
+
+void Crypto::sha256_many(const uint8_t* const* data, const size_t* sizes, size_t count,
+                         std::array<uint8_t, 32>* out, Sha256Kernel kernel) {
+    if (kernel != Sha256Kernel::AUTO) {
+        if (!sha256_kernel_supported(kernel)) {
+            throw WalletError::crypto("SHA256 kernel not supported on this CPU");
+        }
+        sha256_run(data, sizes, count, out, kernel);
+        return;
+    }
+
+    // Consecutive messages that want the same kernel go in one call, so a
+    // batch of same-sized messages is still a single run
+    size_t first = 0;
+    while (first < count) {
+        Sha256Kernel run_kernel = auto_kernel(sizes[first]);
+        size_t end = first + 1;
+        while (end < count && auto_kernel(sizes[end]) == run_kernel) {
+            ++end;
+        }
+        sha256_run(data + first, sizes + first, end - first, out + first, run_kernel);
+        first = end;
+    }
+}
+
+std::vector<std::array<uint8_t, 32>> Crypto::sha256_many(const std::vector<std::vector<uint8_t>>& messages) {
+    std::vector<const uint8_t*> data(messages.size());
+    std::vector<size_t> sizes(messages.size());
+    for (size_t i = 0; i < messages.size(); ++i) {
+        data[i] = messages[i].data();
+        sizes[i] = messages[i].size();
+    }
+
+    std::vector<std::array<uint8_t, 32>> digests(messages.size());
+    sha256_many(data.data(), sizes.data(), messages.size(), digests.data());
+    return digests;
+}
+
+} // namespace crypto_wallet
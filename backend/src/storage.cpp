@@ -1,4 +1,10 @@
 #include "storage.h"
+#include "durable_writer.h"
+#include "wallet_cache.h"
+#include "wallet_catalog.h"
+#include "wallet_crypto.h"
+#include <algorithm>
+#include <mutex>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -7,58 +13,189 @@
 namespace crypto_wallet {
 
 std::filesystem::path WalletStorage::get_wallet_dir() {
-    auto home_dir = std::filesystem::path(std::getenv("HOME"));
-    auto wallet_dir = home_dir / ".crypto-wallet";
-    ensure_wallet_dir_exists();
+    // Created on first use only; this sits on every load and save
+    static const std::filesystem::path wallet_dir = [] {
+        ensure_wallet_dir_exists();
+        return std::filesystem::path(std::getenv("HOME")) / ".crypto-wallet";
+    }();
     return wallet_dir;
 }
 
 std::filesystem::path WalletStorage::get_wallet_path(const std::string& name) {
+    auto wallet_dir = get_wallet_dir();
+    return wallet_dir / (name + ".wallet");
+}
+
+std::filesystem::path WalletStorage::get_legacy_wallet_path(const std::string& name) {
     auto wallet_dir = get_wallet_dir();
     return wallet_dir / (name + ".json");
 }
 
+// Serializes in-place changes to a wallet file within this process, and
+// keeps them off the rename of a save. Striped by path: wallets sharing a
+// stripe only contend for the length of an append or a rename.
+static std::mutex& wallet_file_mutex(const std::filesystem::path& path) {
+    static std::mutex stripes[64];
+    return stripes[std::hash<std::string>()(path.string()) % 64];
+}
+
+// Checkpoint appends to path on the writer thread
+static void schedule_append_sync(const std::filesystem::path& path) {
+    DurableWriter::shared().schedule_sync(path, [path] {
+        std::lock_guard<std::mutex> lock(wallet_file_mutex(path));
+        WalletFile::open(path, WalletFile::APPEND).sync();
+    });
+}
+
+static WalletCatalog& catalog();
+static CatalogEntry catalog_entry_for(const Wallet& wallet, const std::string& file);
+
+// Key for an encrypted wallet file, null for a plaintext one
+static std::shared_ptr<const WalletKey> key_for(const std::string& name, const WalletFile& file) {
+    if (!file.encrypted()) {
+        return nullptr;
+    }
+    auto key = WalletKeyring::shared().get(name, file.kdf_params());
+    if (!key) {
+        throw WalletError::wallet_locked(name);
+    }
+    return key;
+}
+
 void WalletStorage::save(const Wallet& wallet) {
+    std::shared_ptr<const WalletKey> key;
+    if (wallet.encrypted) {
+        key = WalletKeyring::shared().get(wallet.name);
+        if (!key) {
+            throw WalletError::wallet_locked(wallet.name);
+        }
+    }
+    // An append still writing through a mapping of the old file when the
+    // rename lands would be lost, so the rename waits for it. Saves of other
+    // wallets are not held up and can share the batch.
     auto path = get_wallet_path(wallet.name);
+    DurableWriter::shared().replace(path, WalletFile::encode(wallet, key.get()), &wallet_file_mutex(path));
+    catalog().upsert(catalog_entry_for(wallet, wallet.name + ".wallet"));
+    WalletCache::shared().refresh(wallet);
+}
+
+Wallet WalletStorage::load(const std::string& name) {
+    auto path = get_wallet_path(name);
     
-    nlohmann::json j;
-    j["name"] = wallet.name;
-    j["seed_phrase"] = wallet.seed_phrase;
-    j["addresses"] = wallet.addresses;
+    if (!std::filesystem::exists(path)) {
+        if (!convert_legacy(name)) {
+            throw WalletError::wallet_not_found(name);
+        }
+    }
     
-    // Convert time_point to string
-    auto time_t = std::chrono::system_clock::to_time_t(wallet.created_at);
-    j["created_at"] = std::to_string(time_t);
+    auto file = WalletFile::open(path);
+    return file.to_wallet(key_for(name, file).get());
+}
+
+// Appends the address next_address picks from the open file, which it
+// sees under the file mutex together with the file's key
+static std::string append_to_file(
+    const std::string& name, WalletFile::Chain chain,
+    const std::function<std::string(const WalletFile&, const WalletKey*)>& next_address) {
+    auto path = WalletStorage::get_wallet_path(name);
     
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        throw WalletError::storage("Failed to open wallet file for writing");
+    if (!std::filesystem::exists(path)) {
+        if (!WalletStorage::convert_legacy(name)) {
+            throw WalletError::wallet_not_found(name);
+        }
     }
     
-    file << j.dump(4);
-    file.close();
+    std::string address;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(wallet_file_mutex(path));
+        auto file = WalletFile::open(path, WalletFile::APPEND);
+        auto key = key_for(name, file);
+        address = next_address(file, key.get());
+        file.append_address(chain, address, key.get());
+        count = file.address_count(WalletFile::RECEIVE) + file.address_count(WalletFile::CHANGE);
+    }
+    catalog().set_address_count(name, static_cast<uint32_t>(count));
+    WalletCache::shared().invalidate(name);
+    
+    // Addresses are re-derivable from the seed, so an append does not wait
+    // for the disk; bursts of appends share one sync per batch
+    schedule_append_sync(path);
+    return address;
 }
 
-Wallet WalletStorage::load(const std::string& name) {
+void WalletStorage::append_address(const std::string& name, WalletFile::Chain chain,
+                                   const std::string& address) {
+    append_to_file(name, chain, [&name, &address](const WalletFile& file, const WalletKey* key) {
+        // A repeated address would list its outputs twice and shift the
+        // index every later address is derived from
+        if (file.contains_address(address, key)) {
+            throw WalletError::storage("Wallet '" + name + "' already holds address " + address);
+        }
+        return address;
+    });
+}
+
+std::string WalletStorage::append_next_address(const std::string& name, WalletFile::Chain chain,
+                                               const std::function<std::string(uint32_t)>& derive) {
+    // The index is one past the last in the file, so the address cannot be
+    // there yet and needs no duplicate check
+    return append_to_file(name, chain, [chain, &derive](const WalletFile& file, const WalletKey*) {
+        return derive(static_cast<uint32_t>(file.address_count(chain)));
+    });
+}
+
+void WalletStorage::unlock(const std::string& name, const std::string& password) {
     auto path = get_wallet_path(name);
-    
     if (!std::filesystem::exists(path)) {
-        throw WalletError::wallet_not_found(name);
+        if (!convert_legacy(name)) {
+            throw WalletError::wallet_not_found(name);
+        }
     }
     
+    auto file = WalletFile::open(path);
+    if (!file.encrypted()) {
+        return;
+    }
+    auto key = derive_wallet_key(password, file.kdf_params());
+    if (!file.opens_with(key)) {
+        throw WalletError::invalid_password();
+    }
+    WalletKeyring::shared().store(name, std::move(key));
+}
+
+void WalletStorage::lock(const std::string& name) {
+    WalletKeyring::shared().lock(name);
+    WalletCache::shared().invalidate(name);
+}
+
+void WalletStorage::set_password(Wallet& wallet, const std::string& password) {
+    WalletKeyring::shared().store(wallet.name, derive_wallet_key(password, KdfParams::generate()));
+    wallet.encrypted = true;
+}
+
+// Reader for the JSON format used before the binary wallet file
+static Wallet load_legacy(const std::filesystem::path& path) {
     std::ifstream file(path);
     if (!file.is_open()) {
         throw WalletError::storage("Failed to open wallet file for reading");
     }
     
     nlohmann::json j;
-    file >> j;
+    try {
+        file >> j;
+    } catch (const nlohmann::json::exception& e) {
+        throw WalletError::serialization("Invalid legacy wallet file: " + std::string(e.what()));
+    }
     file.close();
     
     Wallet wallet;
     wallet.name = j["name"];
     wallet.seed_phrase = j["seed_phrase"];
     wallet.addresses = j["addresses"];
+    if (j.contains("change_addresses")) {
+        wallet.change_addresses = j["change_addresses"];
+    }
     
     // Convert string back to time_point
     auto time_t = std::stoll(j["created_at"].get<std::string>());
@@ -67,33 +204,133 @@ Wallet WalletStorage::load(const std::string& name) {
     return wallet;
 }
 
-std::vector<std::string> WalletStorage::list_wallets() {
-    auto wallet_dir = get_wallet_dir();
-    std::vector<std::string> wallets;
+static CatalogEntry catalog_entry_for(const Wallet& wallet, const std::string& file) {
+    CatalogEntry entry;
+    entry.name = wallet.name;
+    entry.file = file;
+    entry.created_at = std::chrono::system_clock::to_time_t(wallet.created_at);
+    entry.address_count = static_cast<uint32_t>(wallet.addresses.size() + wallet.change_addresses.size());
+    entry.modified_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    return entry;
+}
+
+// Full directory scan, only used to rebuild a missing or corrupt catalog
+static std::vector<CatalogEntry> scan_wallet_dir(const std::filesystem::path& wallet_dir) {
+    std::vector<CatalogEntry> entries;
+    std::vector<std::filesystem::path> legacy;
     
     try {
-        for (const auto& entry : std::filesystem::directory_iterator(wallet_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                auto filename = entry.path().stem().string();
-                wallets.push_back(filename);
+        for (const auto& dir_entry : std::filesystem::directory_iterator(wallet_dir)) {
+            auto path = dir_entry.path();
+            if (!dir_entry.is_regular_file()) {
+                continue;
+            }
+            if (path.extension() == ".json") {
+                legacy.push_back(path);
+                continue;
+            }
+            if (path.extension() != ".wallet") {
+                continue;
+            }
+            
+            try {
+                auto file = WalletFile::open(path);
+                CatalogEntry entry;
+                entry.name = file.name();
+                entry.file = path.filename().string();
+                entry.created_at = std::chrono::system_clock::to_time_t(file.created_at());
+                entry.address_count = static_cast<uint32_t>(
+                    file.address_count(WalletFile::RECEIVE) + file.address_count(WalletFile::CHANGE));
+                entry.modified_at = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::filesystem::last_write_time(path).time_since_epoch()).count();
+                entries.push_back(std::move(entry));
+            } catch (const WalletError& e) {
+                std::cerr << "Warning: skipping " << path << ": " << e.what() << std::endl;
             }
         }
     } catch (const std::filesystem::filesystem_error& e) {
         throw WalletError::storage("Failed to read wallet directory: " + std::string(e.what()));
     }
     
+    // Legacy files only count when they have not been converted yet
+    for (const auto& path : legacy) {
+        auto name = path.stem().string();
+        bool converted = std::any_of(entries.begin(), entries.end(),
+                                     [&name](const CatalogEntry& entry) { return entry.name == name; });
+        if (converted) {
+            continue;
+        }
+        try {
+            entries.push_back(catalog_entry_for(load_legacy(path), path.filename().string()));
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: skipping " << path << ": " << e.what() << std::endl;
+        }
+    }
+    
+    return entries;
+}
+
+static WalletCatalog& catalog() {
+    static WalletCatalog instance(WalletStorage::get_wallet_dir(), [] {
+        return scan_wallet_dir(WalletStorage::get_wallet_dir());
+    });
+    return instance;
+}
+
+bool WalletStorage::convert_legacy(const std::string& name) {
+    auto legacy_path = get_legacy_wallet_path(name);
+    if (!std::filesystem::exists(legacy_path)) {
+        return false;
+    }
+    
+    auto wallet = load_legacy(legacy_path);
+    WalletFile::write(get_wallet_path(name), wallet);
+    catalog().upsert(catalog_entry_for(wallet, name + ".wallet"));
+    
+    try {
+        std::filesystem::rename(legacy_path, legacy_path.string() + ".bak");
+    } catch (const std::filesystem::filesystem_error& e) {
+        throw WalletError::storage("Failed to retire legacy wallet file: " + std::string(e.what()));
+    }
+    return true;
+}
+
+std::vector<std::string> WalletStorage::list_wallets() {
+    std::vector<std::string> wallets;
+    for (auto& entry : catalog().find()) {
+        wallets.push_back(std::move(entry.name));
+    }
     return wallets;
 }
 
+std::vector<CatalogEntry> WalletStorage::find_wallets(const std::string& prefix, size_t offset, size_t limit) {
+    return catalog().find(prefix, offset, limit);
+}
+
+size_t WalletStorage::count_wallets(const std::string& prefix) {
+    return catalog().count(prefix);
+}
+
+void WalletStorage::rebuild_catalog() {
+    catalog().rebuild();
+}
+
 void WalletStorage::delete_wallet(const std::string& name) {
     auto path = get_wallet_path(name);
+    auto legacy_path = get_legacy_wallet_path(name);
     
-    if (!std::filesystem::exists(path)) {
+    if (!std::filesystem::exists(path) && !std::filesystem::exists(legacy_path)) {
         throw WalletError::wallet_not_found(name);
     }
     
+    // Unlist first: a crash in between leaves an unlisted file, which a
+    // catalog rebuild finds again, rather than a listing with no file
+    catalog().remove(name);
+    
     try {
         std::filesystem::remove(path);
+        std::filesystem::remove(legacy_path);
+        WalletCache::shared().invalidate(name);
     } catch (const std::filesystem::filesystem_error& e) {
         throw WalletError::storage("Failed to delete wallet: " + std::string(e.what()));
     }
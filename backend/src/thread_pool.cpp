@@ -0,0 +1,118 @@
+#include "thread_pool.h"
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+namespace crypto_wallet {
+
+ThreadPool::ThreadPool(size_t threads) : stopping_(false) {
+    threads = std::max<size_t>(threads, 1);
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged(std::move(task));
+    auto future = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(packaged));
+    }
+    cv_.notify_one();
+    return future;
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain,
+                              const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t blocks = (count + grain - 1) / grain;
+    if (blocks == 1) {
+        fn(0, count);
+        return;
+    }
+
+    // Helpers may start after the caller has finished every block, so the
+    // shared state is reference counted rather than living on this stack
+    struct State {
+        std::atomic<size_t> next_block{0};
+        std::atomic<size_t> done_blocks{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+
+    auto run_blocks = [state, blocks, grain, count, &fn]() {
+        size_t block;
+        while ((block = state->next_block.fetch_add(1)) < blocks) {
+            size_t begin = block * grain;
+            size_t end = std::min(begin + grain, count);
+            try {
+                fn(begin, end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->done_blocks.fetch_add(1) + 1 == blocks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    // fn is only dereferenced while blocks remain, and the caller does not
+    // return until every block is done, so capturing it by reference is safe
+    size_t helpers = std::min(blocks - 1, workers_.size());
+    for (size_t i = 0; i < helpers; ++i) {
+        submit(run_blocks);
+    }
+    run_blocks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state, blocks] { return state->done_blocks.load() == blocks; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+} // namespace crypto_wallet
@@ -0,0 +1,245 @@
+#include "trade_store.h"
+#include "error.h"
+#include <algorithm>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace crypto_wallet {
+
+// Column layout inside a chunk buffer, widest type first so every column
+// stays naturally aligned when capacity is a multiple of 8:
+//   timestamp | price | amount | fee | wallet_id | order_index | pair_id | side
+static constexpr size_t ROW_BYTES = 8 + 8 + 8 + 8 + 4 + 4 + 2 + 1;
+
+struct TradeStore::Chunk {
+    size_t capacity;
+    size_t count;
+    int64_t min_ts;
+    int64_t max_ts;
+    uint8_t* data;
+    size_t bytes;
+    bool mapped;
+
+    explicit Chunk(size_t rows)
+        : capacity(rows), count(0),
+          min_ts(std::numeric_limits<int64_t>::max()),
+          max_ts(std::numeric_limits<int64_t>::min()),
+          data(new uint8_t[rows * ROW_BYTES]), bytes(rows * ROW_BYTES), mapped(false) {}
+
+    ~Chunk() {
+        if (mapped) {
+            munmap(data, bytes);
+        } else {
+            delete[] data;
+        }
+    }
+
+    int64_t* timestamps() const { return reinterpret_cast<int64_t*>(data); }
+    double* prices() const { return reinterpret_cast<double*>(data + capacity * 8); }
+    double* amounts() const { return reinterpret_cast<double*>(data + capacity * 16); }
+    double* fees() const { return reinterpret_cast<double*>(data + capacity * 24); }
+    uint32_t* wallet_ids() const { return reinterpret_cast<uint32_t*>(data + capacity * 32); }
+    uint32_t* order_indexes() const { return reinterpret_cast<uint32_t*>(data + capacity * 36); }
+    uint16_t* pair_ids() const { return reinterpret_cast<uint16_t*>(data + capacity * 40); }
+    uint8_t* sides() const { return data + capacity * 42; }
+
+    bool overlaps(int64_t from, int64_t to) const {
+        return count > 0 && max_ts >= from && min_ts <= to;
+    }
+
+    TradeRow row(size_t i) const {
+        return {timestamps()[i], wallet_ids()[i], order_indexes()[i], pair_ids()[i],
+                sides()[i], prices()[i], amounts()[i], fees()[i]};
+    }
+};
+
+TradeStore::TradeStore(size_t chunk_rows)
+    : chunk_rows_((std::max<size_t>(chunk_rows, 8) + 7) & ~static_cast<size_t>(7)),
+      total_rows_(0), spill_enabled_(false) {}
+
+TradeStore::~TradeStore() = default;
+
+void TradeStore::enable_spill(const std::filesystem::path& directory) {
+    try {
+        std::filesystem::create_directories(directory);
+    } catch (const std::filesystem::filesystem_error& e) {
+        throw WalletError::storage("Failed to create trade spill directory: " + std::string(e.what()));
+    }
+    spill_dir_ = directory;
+    spill_enabled_ = true;
+}
+
+uint32_t TradeStore::intern_wallet(const std::string& wallet_name) {
+    auto it = wallet_ids_.find(wallet_name);
+    if (it != wallet_ids_.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(wallet_ids_.size());
+    wallet_ids_[wallet_name] = id;
+    return id;
+}
+
+uint16_t TradeStore::intern_pair(const std::string& pair) {
+    auto it = pair_ids_.find(pair);
+    if (it != pair_ids_.end()) {
+        return it->second;
+    }
+    uint16_t id = static_cast<uint16_t>(pair_names_.size());
+    pair_ids_[pair] = id;
+    pair_names_.push_back(pair);
+    return id;
+}
+
+const std::string& TradeStore::pair_name(uint16_t pair_id) const {
+    return pair_names_.at(pair_id);
+}
+
+void TradeStore::append(const TradeRow& row) {
+    if (chunks_.empty() || chunks_.back()->count == chunks_.back()->capacity) {
+        chunks_.push_back(std::make_unique<Chunk>(chunk_rows_));
+    }
+
+    Chunk& chunk = *chunks_.back();
+    int64_t min_ts = chunk.min_ts;
+    int64_t max_ts = chunk.max_ts;
+    size_t i = chunk.count++;
+    chunk.timestamps()[i] = row.timestamp;
+    chunk.prices()[i] = row.price;
+    chunk.amounts()[i] = row.amount;
+    chunk.fees()[i] = row.fee;
+    chunk.wallet_ids()[i] = row.wallet_id;
+    chunk.order_indexes()[i] = row.order_index;
+    chunk.pair_ids()[i] = row.pair_id;
+    chunk.sides()[i] = row.side;
+    chunk.min_ts = std::min(chunk.min_ts, row.timestamp);
+    chunk.max_ts = std::max(chunk.max_ts, row.timestamp);
+    ++total_rows_;
+
+    if (chunk.count == chunk.capacity && spill_enabled_) {
+        try {
+            seal(chunk, chunks_.size() - 1);
+        } catch (...) {
+            // The caller never records the row's order, so the row must not
+            // stay behind pointing at it; the next append retries the seal
+            --chunk.count;
+            --total_rows_;
+            chunk.min_ts = min_ts;
+            chunk.max_ts = max_ts;
+            throw;
+        }
+    }
+}
+
+std::vector<TradeRow> TradeStore::query_wallet(const std::string& wallet_name,
+                                               int64_t from, int64_t to) const {
+    std::vector<TradeRow> rows;
+    auto it = wallet_ids_.find(wallet_name);
+    if (it == wallet_ids_.end()) {
+        return rows;
+    }
+    uint32_t wallet_id = it->second;
+
+    for (const auto& chunk : chunks_) {
+        if (!chunk->overlaps(from, to)) {
+            continue;
+        }
+
+        const uint32_t* wallets = chunk->wallet_ids();
+        const int64_t* timestamps = chunk->timestamps();
+        for (size_t i = 0; i < chunk->count; ++i) {
+            if (wallets[i] == wallet_id && timestamps[i] >= from && timestamps[i] <= to) {
+                rows.push_back(chunk->row(i));
+            }
+        }
+    }
+
+    return rows;
+}
+
+TradeStats TradeStore::aggregate_pair(const std::string& pair, int64_t from, int64_t to) const {
+    TradeStats stats{0, 0.0, 0.0, 0.0,
+                     -std::numeric_limits<double>::infinity(),
+                     std::numeric_limits<double>::infinity()};
+
+    auto it = pair_ids_.find(pair);
+    if (it != pair_ids_.end()) {
+        uint16_t pair_id = it->second;
+
+        for (const auto& chunk : chunks_) {
+            if (!chunk->overlaps(from, to)) {
+                continue;
+            }
+
+            const int64_t* timestamps = chunk->timestamps();
+            const uint16_t* pairs = chunk->pair_ids();
+            const double* prices = chunk->prices();
+            const double* amounts = chunk->amounts();
+            for (size_t i = 0; i < chunk->count; ++i) {
+                if (pairs[i] != pair_id || timestamps[i] < from || timestamps[i] > to) {
+                    continue;
+                }
+                ++stats.trade_count;
+                stats.volume += amounts[i];
+                stats.notional += amounts[i] * prices[i];
+                stats.high = std::max(stats.high, prices[i]);
+                stats.low = std::min(stats.low, prices[i]);
+            }
+        }
+    }
+
+    if (stats.trade_count == 0) {
+        stats.high = 0.0;
+        stats.low = 0.0;
+    } else if (stats.volume > 0.0) {
+        stats.vwap = stats.notional / stats.volume;
+    }
+
+    return stats;
+}
+
+size_t TradeStore::memory_bytes() const {
+    size_t bytes = 0;
+    for (const auto& chunk : chunks_) {
+        if (!chunk->mapped) {
+            bytes += chunk->bytes;
+        }
+    }
+    return bytes;
+}
+
+void TradeStore::seal(Chunk& chunk, size_t chunk_number) {
+    auto path = spill_dir_ / ("trades_" + std::to_string(chunk_number) + ".col");
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw WalletError::storage("Failed to create trade spill file: " + path.string());
+    }
+
+    size_t written = 0;
+    while (written < chunk.bytes) {
+        ssize_t n = ::write(fd, chunk.data + written, chunk.bytes - written);
+        if (n <= 0) {
+            ::close(fd);
+            ::unlink(path.c_str());
+            throw WalletError::storage("Failed to write trade spill file: " + path.string());
+        }
+        written += static_cast<size_t>(n);
+    }
+
+    void* mapping = mmap(nullptr, chunk.bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    // The mapping keeps the inode alive, so the name can go right away and
+    // nothing is left behind if the process dies
+    ::unlink(path.c_str());
+    if (mapping == MAP_FAILED) {
+        throw WalletError::storage("Failed to map trade spill file: " + path.string());
+    }
+
+    delete[] chunk.data;
+    chunk.data = static_cast<uint8_t*>(mapping);
+    chunk.mapped = true;
+}
+
+} // namespace crypto_wallet
@@ -1,4 +1,5 @@
 #include "trading.h"
+#include "risk.h"
 #include "error.h"
 #include <iostream>
 #include <sstream>
@@ -8,7 +9,7 @@
 
 namespace crypto_wallet {
 
-TradingEngine::TradingEngine() {
+TradingEngine::TradingEngine() : risk_engine_(std::make_unique<RiskEngine>()) {
     // Initialize trading pairs
     trading_pairs_["BTC/USDT"] = {"BTC", "USDT", "BTC/USDT", 0.001, 100.0, 2, 6, true};
     trading_pairs_["ETH/USDT"] = {"ETH", "USDT", "ETH/USDT", 0.01, 1000.0, 2, 4, true};
@@ -20,11 +21,25 @@ TradingEngine::TradingEngine() {
     market_data_["ETH"] = {"ETH", 2850.0, 1.8, 800000000.0, 2950.0, 2750.0, std::chrono::system_clock::now()};
     market_data_["ADA"] = {"ADA", 0.45, -0.5, 50000000.0, 0.48, 0.42, std::chrono::system_clock::now()};
     market_data_["SOL"] = {"SOL", 100.0, 3.2, 200000000.0, 105.0, 95.0, std::chrono::system_clock::now()};
+    
+    // Initialize risk limit table
+    for (const auto& pair : trading_pairs_) {
+        risk_engine_->set_trading_pair(pair.second);
+    }
+    risk_engine_->set_default_balances({
+        {"BTC", 2.5},
+        {"ETH", 15.8},
+        {"ADA", 5000.0},
+        {"SOL", 25.0},
+        {"USDT", 10000.0}
+    });
 }
 
 TradingEngine::~TradingEngine() = default;
 
 std::string TradingEngine::place_order(const Order& order) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     Order new_order = order;
     new_order.order_id = generate_order_id();
     new_order.status = OrderStatus::PENDING;
@@ -48,20 +63,37 @@ std::string TradingEngine::place_order(const Order& order) {
         return new_order.order_id;
     }
     
+    // Pre-trade risk checks
+    auto risk = risk_engine_->check_order(new_order, reference_price(new_order));
+    if (!risk.ok()) {
+        new_order.status = OrderStatus::REJECTED;
+        new_order.error_message = risk.to_error_message();
+        orders_.push_back(new_order);
+        return new_order.order_id;
+    }
+    
     // Process the order
     process_order(new_order);
+    if (new_order.status == OrderStatus::FILLED) {
+        risk_engine_->on_order_filled(new_order);
+    } else if (new_order.status == OrderStatus::PENDING) {
+        risk_engine_->on_order_resting(new_order);
+    }
     orders_.push_back(new_order);
     
     return new_order.order_id;
 }
 
 bool TradingEngine::cancel_order(const std::string& order_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     auto it = std::find_if(orders_.begin(), orders_.end(),
         [&order_id](const Order& order) { return order.order_id == order_id; });
     
     if (it != orders_.end() && it->status == OrderStatus::PENDING) {
         it->status = OrderStatus::CANCELLED;
         it->updated_at = std::chrono::system_clock::now();
+        risk_engine_->on_order_released(*it);
         return true;
     }
     
@@ -69,6 +101,8 @@ bool TradingEngine::cancel_order(const std::string& order_id) {
 }
 
 std::vector<Order> TradingEngine::get_orders(const std::string& wallet_name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     std::vector<Order> wallet_orders;
     for (const auto& order : orders_) {
         if (order.wallet_name == wallet_name) {
@@ -79,6 +113,8 @@ std::vector<Order> TradingEngine::get_orders(const std::string& wallet_name) {
 }
 
 Order TradingEngine::get_order(const std::string& order_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     auto it = std::find_if(orders_.begin(), orders_.end(),
         [&order_id](const Order& order) { return order.order_id == order_id; });
     
@@ -91,6 +127,8 @@ Order TradingEngine::get_order(const std::string& order_id) {
 }
 
 std::vector<TradingPair> TradingEngine::get_trading_pairs() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     std::vector<TradingPair> pairs;
     for (const auto& pair : trading_pairs_) {
         pairs.push_back(pair.second);
@@ -99,6 +137,8 @@ std::vector<TradingPair> TradingEngine::get_trading_pairs() {
 }
 
 MarketData TradingEngine::get_market_data(const std::string& symbol) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     auto it = market_data_.find(symbol);
     if (it != market_data_.end()) {
         return it->second;
@@ -109,6 +149,8 @@ MarketData TradingEngine::get_market_data(const std::string& symbol) {
 }
 
 OrderBook TradingEngine::get_order_book(const std::string& pair) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
     OrderBook book;
     book.pair = pair;
     book.timestamp = std::chrono::system_clock::now();
@@ -144,53 +186,64 @@ OrderBook TradingEngine::get_order_book(const std::string& pair) {
 }
 
 std::vector<Trade> TradingEngine::get_trades(const std::string& wallet_name) {
+    return get_trades(wallet_name,
+                      std::chrono::system_clock::time_point::min(),
+                      std::chrono::system_clock::time_point::max());
+}
+
+std::vector<Trade> TradingEngine::get_trades(
+    const std::string& wallet_name,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    auto rows = trade_store_.query_wallet(wallet_name,
+                                          from.time_since_epoch().count(),
+                                          to.time_since_epoch().count());
+    
     std::vector<Trade> wallet_trades;
-    for (const auto& trade : trades_) {
-        // Find the order to check wallet name
-        auto order_it = std::find_if(orders_.begin(), orders_.end(),
-            [&trade](const Order& order) { return order.order_id == trade.order_id; });
-        
-        if (order_it != orders_.end() && order_it->wallet_name == wallet_name) {
-            wallet_trades.push_back(trade);
-        }
+    wallet_trades.reserve(rows.size());
+    for (const auto& row : rows) {
+        Trade trade;
+        trade.trade_id = "TRD" + std::to_string(row.timestamp);
+        trade.order_id = orders_[row.order_index].order_id;
+        trade.pair = trade_store_.pair_name(row.pair_id);
+        trade.side = static_cast<OrderSide>(row.side);
+        trade.amount = row.amount;
+        trade.price = row.price;
+        trade.fee = row.fee;
+        trade.timestamp = std::chrono::system_clock::time_point(
+            std::chrono::system_clock::duration(row.timestamp));
+        wallet_trades.push_back(std::move(trade));
     }
     return wallet_trades;
 }
 
+TradeStats TradingEngine::get_trade_stats(
+    const std::string& pair,
+    std::chrono::system_clock::time_point from,
+    std::chrono::system_clock::time_point to
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    return trade_store_.aggregate_pair(pair,
+                                       from.time_since_epoch().count(),
+                                       to.time_since_epoch().count());
+}
+
 std::map<std::string, double> TradingEngine::get_portfolio_balances(const std::string& wallet_name) {
-    std::map<std::string, double> balances;
-    
-    // Initialize with some default balances
-    balances["BTC"] = 2.5;
-    balances["ETH"] = 15.8;
-    balances["ADA"] = 5000.0;
-    balances["SOL"] = 25.0;
-    balances["USDT"] = 10000.0;
-    
-    // Calculate net balances from trades
-    for (const auto& trade : trades_) {
-        auto order_it = std::find_if(orders_.begin(), orders_.end(),
-            [&trade](const Order& order) { return order.order_id == trade.order_id; });
-        
-        if (order_it != orders_.end() && order_it->wallet_name == wallet_name) {
-            std::string base_asset = trade.pair.substr(0, trade.pair.find('/'));
-            std::string quote_asset = trade.pair.substr(trade.pair.find('/') + 1);
-            
-            if (trade.side == OrderSide::BUY) {
-                balances[base_asset] += trade.amount;
-                balances[quote_asset] -= trade.amount * trade.price;
-            } else {
-                balances[base_asset] -= trade.amount;
-                balances[quote_asset] += trade.amount * trade.price;
-            }
-        }
-    }
+    std::lock_guard<std::mutex> lock(mutex_);
     
-    return balances;
+    // Balances are maintained incrementally by the risk engine on every fill
+    return risk_engine_->get_balances(wallet_name);
 }
 
 double TradingEngine::get_portfolio_value(const std::string& wallet_name) {
-    auto balances = get_portfolio_balances(wallet_name);
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    // Not get_portfolio_balances, which would take mutex_ again
+    auto balances = risk_engine_->get_balances(wallet_name);
     double total_value = 0.0;
     
     for (const auto& balance : balances) {
@@ -217,6 +270,16 @@ std::string TradingEngine::generate_order_id() {
     return ss.str();
 }
 
+double TradingEngine::reference_price(const Order& order) const {
+    if (order.type != OrderType::MARKET) {
+        return order.price;
+    }
+    
+    std::string base_asset = order.pair.substr(0, order.pair.find('/'));
+    auto market_it = market_data_.find(base_asset);
+    return market_it != market_data_.end() ? market_it->second.price : 0.0;
+}
+
 void TradingEngine::process_order(Order& order) {
     // For market orders, fill immediately at current market price
     if (order.type == OrderType::MARKET) {
@@ -230,18 +293,7 @@ void TradingEngine::process_order(Order& order) {
             order.status = OrderStatus::FILLED;
             order.updated_at = std::chrono::system_clock::now();
             
-            // Create trade record
-            Trade trade;
-            trade.trade_id = "TRD" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-            trade.order_id = order.order_id;
-            trade.pair = order.pair;
-            trade.side = order.side;
-            trade.amount = order.amount;
-            trade.price = order.price;
-            trade.fee = order.amount * order.price * 0.001; // 0.1% fee
-            trade.timestamp = std::chrono::system_clock::now();
-            
-            trades_.push_back(trade);
+            record_trade(order);
         }
     }
     // For limit orders, add to order book for matching
@@ -263,23 +315,27 @@ void TradingEngine::process_order(Order& order) {
                 order.status = OrderStatus::FILLED;
                 order.updated_at = std::chrono::system_clock::now();
                 
-                // Create trade record
-                Trade trade;
-                trade.trade_id = "TRD" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-                trade.order_id = order.order_id;
-                trade.pair = order.pair;
-                trade.side = order.side;
-                trade.amount = order.amount;
-                trade.price = order.price;
-                trade.fee = order.amount * order.price * 0.001; // 0.1% fee
-                trade.timestamp = std::chrono::system_clock::now();
-                
-                trades_.push_back(trade);
+                record_trade(order);
             }
         }
     }
 }
 
+void TradingEngine::record_trade(const Order& order) {
+    TradeRow row;
+    row.timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+    row.wallet_id = trade_store_.intern_wallet(order.wallet_name);
+    // The order is appended to orders_ right after processing
+    row.order_index = static_cast<uint32_t>(orders_.size());
+    row.pair_id = trade_store_.intern_pair(order.pair);
+    row.side = static_cast<uint8_t>(order.side);
+    row.price = order.price;
+    row.amount = order.amount;
+    row.fee = order.amount * order.price * 0.001; // 0.1% fee
+    
+    trade_store_.append(row);
+}
+
 void TradingEngine::match_orders(const std::string& pair) {
     // In a real implementation, this would match buy and sell orders
     // For now, this is a placeholder
@@ -0,0 +1,361 @@
+#include "transaction_builder.h"
+#include "thread_pool.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <cstring>
+
+namespace crypto_wallet {
+
+static constexpr uint32_t TX_VERSION = 2;
+static constexpr uint32_t TX_LOCKTIME = 0;
+static constexpr uint32_t SEQUENCE_RBF = 0xfffffffd;  // Final for locktime, replaceable (BIP125)
+static constexpr uint32_t SIGHASH_ALL = 1;
+
+static constexpr uint8_t OP_0 = 0x00;
+static constexpr uint8_t OP_1 = 0x51;
+static constexpr uint8_t OP_DUP = 0x76;
+static constexpr uint8_t OP_EQUAL = 0x87;
+static constexpr uint8_t OP_EQUALVERIFY = 0x88;
+static constexpr uint8_t OP_HASH160 = 0xa9;
+static constexpr uint8_t OP_CHECKSIG = 0xac;
+
+// DER of a low-S signature plus the sighash byte
+static constexpr size_t MAX_SIGNATURE_SIZE = 72;
+// Pushes of the signature and the compressed key
+static constexpr size_t MAX_SCRIPT_SIG_SIZE = 1 + MAX_SIGNATURE_SIZE + 1 + 33;
+// Outpoint, empty script and sequence, as every other input appears in a
+// legacy sighash preimage
+static constexpr size_t UNSIGNED_INPUT_SIZE = 36 + 1 + 4;
+
+static size_t compact_size_length(uint64_t n) {
+    return n < 0xfd ? 1 : n <= 0xffff ? 3 : n <= 0xffffffff ? 5 : 9;
+}
+
+// Little-endian writes into a buffer sized in advance
+class ByteWriter {
+public:
+    ByteWriter(uint8_t* data, size_t size) : begin_(data), pos_(data), end_(data + size) {}
+
+    void put(const uint8_t* data, size_t size) {
+        if (static_cast<size_t>(end_ - pos_) < size) {
+            throw WalletError::serialization("Transaction buffer too small");
+        }
+        std::memcpy(pos_, data, size);
+        pos_ += size;
+    }
+
+    void put_byte(uint8_t value) { put(&value, 1); }
+
+    template <typename T>
+    void put_int(T value) {
+        uint8_t bytes[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+        put(bytes, sizeof(T));
+    }
+
+    void put_compact_size(uint64_t n) {
+        if (n < 0xfd) {
+            put_byte(static_cast<uint8_t>(n));
+        } else if (n <= 0xffff) {
+            put_byte(0xfd);
+            put_int(static_cast<uint16_t>(n));
+        } else if (n <= 0xffffffff) {
+            put_byte(0xfe);
+            put_int(static_cast<uint32_t>(n));
+        } else {
+            put_byte(0xff);
+            put_int(n);
+        }
+    }
+
+    size_t size() const { return pos_ - begin_; }
+
+private:
+    uint8_t* begin_;
+    uint8_t* pos_;
+    uint8_t* end_;
+};
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string to_hex(const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        hex[2 * i] = digits[data[i] >> 4];
+        hex[2 * i + 1] = digits[data[i] & 0x0f];
+    }
+    return hex;
+}
+
+// DER encoding of a compact r || s signature; returns the bytes written
+static size_t der_encode(const uint8_t* compact, uint8_t* out) {
+    auto put_integer = [](const uint8_t* value, uint8_t* at) {
+        size_t start = 0;
+        while (start < 31 && value[start] == 0) {
+            ++start;
+        }
+        // A set top bit would read as negative
+        size_t pad = value[start] & 0x80 ? 1 : 0;
+        size_t length = 32 - start;
+        at[0] = 0x02;
+        at[1] = static_cast<uint8_t>(length + pad);
+        at[2] = 0;
+        std::memcpy(at + 2 + pad, value + start, length);
+        return 2 + pad + length;
+    };
+    size_t length = put_integer(compact, out + 2);
+    length += put_integer(compact + 32, out + 2 + length);
+    out[0] = 0x30;
+    out[1] = static_cast<uint8_t>(length);
+    return 2 + length;
+}
+
+std::string SignedTransaction::hex() const {
+    return to_hex(raw.data(), raw.size());
+}
+
+std::vector<uint8_t> TransactionBuilder::output_script(const std::string& address, const std::string& network) {
+    bool testnet = network == "testnet";
+    auto wrong_network = [&address, testnet] {
+        return WalletError::invalid_address(address + " is not a " + (testnet ? "testnet" : "mainnet") + " address");
+    };
+
+    if (address.size() > 3 && address[2] == '1') {
+        char c0 = address[0] | 0x20;
+        char c1 = address[1] | 0x20;
+        if ((c0 == 'b' && c1 == 'c') || (c0 == 't' && c1 == 'b')) {
+            if ((c0 == 't') != testnet) {
+                throw wrong_network();
+            }
+            uint8_t program[40];
+            size_t written = 0;
+            int version = 0;
+            std::string hrp = testnet ? "tb" : "bc";
+            if (!Crypto::segwit_address_decode(address, hrp, version, program, sizeof(program), written)) {
+                throw WalletError::invalid_address(address);
+            }
+            std::vector<uint8_t> script;
+            script.reserve(2 + written);
+            script.push_back(version == 0 ? OP_0 : static_cast<uint8_t>(OP_1 + version - 1));
+            script.push_back(static_cast<uint8_t>(written));
+            script.insert(script.end(), program, program + written);
+            return script;
+        }
+    }
+
+    uint8_t payload[21];
+    size_t written = 0;
+    if (!Crypto::base58check_decode(address, payload, sizeof(payload), written) || written != sizeof(payload)) {
+        throw WalletError::invalid_address(address);
+    }
+    bool testnet_version = payload[0] == 0x6f || payload[0] == 0xc4;
+    bool mainnet_version = payload[0] == 0x00 || payload[0] == 0x05;
+    if ((testnet && mainnet_version) || (!testnet && testnet_version)) {
+        throw wrong_network();
+    }
+    std::vector<uint8_t> script;
+    switch (payload[0]) {
+    case 0x00:  // P2PKH, mainnet and testnet
+    case 0x6f:
+        script = {OP_DUP, OP_HASH160, 20};
+        script.insert(script.end(), payload + 1, payload + 21);
+        script.push_back(OP_EQUALVERIFY);
+        script.push_back(OP_CHECKSIG);
+        return script;
+    case 0x05:  // P2SH
+    case 0xc4:
+        script = {OP_HASH160, 20};
+        script.insert(script.end(), payload + 1, payload + 21);
+        script.push_back(OP_EQUAL);
+        return script;
+    default:
+        throw WalletError::invalid_address("unsupported version, " + address);
+    }
+}
+
+size_t TransactionBuilder::output_size(const std::vector<uint8_t>& script) {
+    return 8 + compact_size_length(script.size()) + script.size();
+}
+
+void TransactionBuilder::add_input(const std::string& txid, uint32_t vout, uint64_t value,
+                                   const std::array<uint8_t, 33>& public_key) {
+    Input input;
+    if (txid.size() != 64) {
+        throw WalletError::serialization("Invalid txid: " + txid);
+    }
+    // Explorers show txids byte-reversed
+    for (size_t i = 0; i < 32; ++i) {
+        int high = hex_value(txid[62 - 2 * i]);
+        int low = hex_value(txid[63 - 2 * i]);
+        if (high < 0 || low < 0) {
+            throw WalletError::serialization("Invalid txid: " + txid);
+        }
+        input.outpoint[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        input.outpoint[32 + i] = static_cast<uint8_t>(vout >> (8 * i));
+    }
+    input.value = value;
+
+    auto hash = Crypto::hash160(public_key.data(), public_key.size());
+    input.script_code = {OP_DUP, OP_HASH160, 20};
+    std::copy(hash.begin(), hash.end(), input.script_code.begin() + 3);
+    input.script_code[23] = OP_EQUALVERIFY;
+    input.script_code[24] = OP_CHECKSIG;
+    input.public_key = public_key;
+    inputs_.push_back(input);
+}
+
+void TransactionBuilder::add_output(std::vector<uint8_t> script, uint64_t value) {
+    outputs_.push_back(Output{std::move(script), value});
+}
+
+uint64_t TransactionBuilder::input_value() const {
+    uint64_t total = 0;
+    for (const auto& input : inputs_) {
+        total += input.value;
+    }
+    return total;
+}
+
+uint64_t TransactionBuilder::output_value() const {
+    uint64_t total = 0;
+    for (const auto& output : outputs_) {
+        total += output.value;
+    }
+    return total;
+}
+
+size_t TransactionBuilder::max_size() const {
+    size_t size = 4 + compact_size_length(inputs_.size()) + compact_size_length(outputs_.size()) + 4;
+    size += inputs_.size() * (36 + compact_size_length(MAX_SCRIPT_SIG_SIZE) + MAX_SCRIPT_SIG_SIZE + 4);
+    for (const auto& output : outputs_) {
+        size += output_size(output.script);
+    }
+    return size;
+}
+
+SignedTransaction TransactionBuilder::sign(const LockedBuffer& keys) const {
+    if (inputs_.empty() || outputs_.empty()) {
+        throw WalletError::crypto("A transaction needs inputs and outputs");
+    }
+    if (keys.size() < 32 * inputs_.size()) {
+        throw WalletError::crypto("Missing signing keys");
+    }
+    uint64_t in = input_value();
+    uint64_t out = output_value();
+    if (out > in) {
+        throw WalletError::crypto("Outputs exceed inputs");
+    }
+
+    // The preimage pieces every input shares
+    uint8_t head[4 + 9];
+    ByteWriter head_writer(head, sizeof(head));
+    head_writer.put_int(TX_VERSION);
+    head_writer.put_compact_size(inputs_.size());
+    size_t head_size = head_writer.size();
+
+    std::vector<uint8_t> unsigned_inputs(inputs_.size() * UNSIGNED_INPUT_SIZE);
+    ByteWriter inputs_writer(unsigned_inputs.data(), unsigned_inputs.size());
+    for (const auto& input : inputs_) {
+        inputs_writer.put(input.outpoint.data(), input.outpoint.size());
+        inputs_writer.put_byte(0);
+        inputs_writer.put_int(SEQUENCE_RBF);
+    }
+
+    size_t tail_size = compact_size_length(outputs_.size()) + 4;
+    for (const auto& output : outputs_) {
+        tail_size += output_size(output.script);
+    }
+    std::vector<uint8_t> tail(tail_size);
+    ByteWriter tail_writer(tail.data(), tail.size());
+    tail_writer.put_compact_size(outputs_.size());
+    for (const auto& output : outputs_) {
+        tail_writer.put_int(output.value);
+        tail_writer.put_compact_size(output.script.size());
+        tail_writer.put(output.script.data(), output.script.size());
+    }
+    tail_writer.put_int(TX_LOCKTIME);
+
+    uint8_t sequence[4];
+    uint8_t sighash_type[4];
+    for (size_t i = 0; i < 4; ++i) {
+        sequence[i] = static_cast<uint8_t>(SEQUENCE_RBF >> (8 * i));
+        sighash_type[i] = static_cast<uint8_t>(SIGHASH_ALL >> (8 * i));
+    }
+
+    std::vector<std::array<uint8_t, MAX_SIGNATURE_SIZE>> signatures(inputs_.size());
+    std::vector<uint8_t> signature_sizes(inputs_.size());
+    ThreadPool::shared().parallel_for(inputs_.size(), 4, [&](size_t begin, size_t end) {
+        struct WipedKey {
+            std::array<uint8_t, 32> bytes;
+            ~WipedKey() { OPENSSL_cleanse(bytes.data(), bytes.size()); }
+        } key;
+        std::array<uint8_t, 32>& secret_key = key.bytes;
+        Sha256Ctx ctx;
+        for (size_t i = begin; i < end; ++i) {
+            const Input& input = inputs_[i];
+            std::memcpy(secret_key.data(), keys.data() + 32 * i, 32);
+            auto public_key = Crypto::derive_public_key(secret_key);
+            if (!std::equal(public_key.begin(), public_key.end(), input.public_key.begin())) {
+                throw WalletError::crypto("Signing key does not match input " + std::to_string(i));
+            }
+
+            // The transaction with this input's script replaced by the
+            // scriptPubKey it spends and every other script empty
+            uint8_t script_length = static_cast<uint8_t>(input.script_code.size());
+            ctx.init();
+            ctx.update(head, head_size);
+            ctx.update(unsigned_inputs.data(), i * UNSIGNED_INPUT_SIZE);
+            ctx.update(input.outpoint.data(), input.outpoint.size());
+            ctx.update(&script_length, 1);
+            ctx.update(input.script_code.data(), input.script_code.size());
+            ctx.update(sequence, sizeof(sequence));
+            ctx.update(unsigned_inputs.data() + (i + 1) * UNSIGNED_INPUT_SIZE,
+                       (inputs_.size() - i - 1) * UNSIGNED_INPUT_SIZE);
+            ctx.update(tail.data(), tail.size());
+            ctx.update(sighash_type, sizeof(sighash_type));
+            auto first = ctx.final();
+            auto digest = Crypto::sha256(first.data(), first.size());
+
+            auto compact = Crypto::sign_hash(digest, secret_key);
+            size_t size = der_encode(compact.data(), signatures[i].data());
+            signatures[i][size] = static_cast<uint8_t>(SIGHASH_ALL);
+            signature_sizes[i] = static_cast<uint8_t>(size + 1);
+        }
+    });
+
+    SignedTransaction result;
+    result.raw.resize(max_size());
+    ByteWriter writer(result.raw.data(), result.raw.size());
+    writer.put(head, head_size);
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+        const Input& input = inputs_[i];
+        writer.put(input.outpoint.data(), input.outpoint.size());
+        writer.put_compact_size(1 + signature_sizes[i] + 1 + input.public_key.size());
+        writer.put_byte(signature_sizes[i]);
+        writer.put(signatures[i].data(), signature_sizes[i]);
+        writer.put_byte(static_cast<uint8_t>(input.public_key.size()));
+        writer.put(input.public_key.data(), input.public_key.size());
+        writer.put(sequence, sizeof(sequence));
+    }
+    writer.put(tail.data(), tail.size());
+    result.raw.resize(writer.size());
+
+    auto hash = Crypto::double_sha256(result.raw.data(), result.raw.size());
+    std::reverse(hash.begin(), hash.end());
+    result.txid = to_hex(hash.data(), hash.size());
+    result.fee = in - out;
+    result.size = result.raw.size();
+    return result;
+}
+
+} // namespace crypto_wallet
@@ -0,0 +1,676 @@
+#include "utxo_index.h"
+#include "durable_writer.h"
+#include "checksum.h"
+#include "storage.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <unistd.h>
+
+namespace crypto_wallet {
+
+static constexpr char INDEX_MAGIC[4] = {'C', 'U', 'T', 'X'};
+static constexpr uint16_t INDEX_VERSION = 1;
+
+// magic, version, reserved, entry count, CRC32C of the entries
+static constexpr size_t INDEX_HEADER_SIZE = 16;
+
+static constexpr char LOG_MAGIC[4] = {'C', 'U', 'T', 'L'};
+static constexpr uint16_t LOG_VERSION = 1;
+
+// magic, version, reserved; each record is then its size, the CRC32C of
+// the entry and the entry
+static constexpr size_t LOG_HEADER_SIZE = 8;
+static constexpr size_t LOG_RECORD_HEADER_SIZE = 8;
+
+// The log is folded into a new snapshot once it is larger than both this
+// and the snapshot, so replay stays proportional to the index
+static constexpr size_t LOG_COMPACT_MIN_SIZE = 1 << 20;
+
+template <typename T>
+static void put(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void put_string(std::vector<uint8_t>& out, const std::string& value) {
+    put<uint16_t>(out, static_cast<uint16_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// Bounds-checked reader over the entry section
+struct IndexReader {
+    const uint8_t* p;
+    const uint8_t* end;
+
+    template <typename T>
+    bool get(T& value) {
+        if (static_cast<size_t>(end - p) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool get_string(std::string& value) {
+        uint16_t size;
+        if (!get(size) || static_cast<size_t>(end - p) < size) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(p), size);
+        p += size;
+        return true;
+    }
+
+    // A u32 count followed by that many items
+    template <typename T, typename Fn>
+    bool get_list(std::vector<T>& items, Fn get_item) {
+        uint32_t count;
+        if (!get(count) || count > static_cast<size_t>(end - p)) {
+            return false;
+        }
+        items.resize(count);
+        for (auto& item : items) {
+            if (!get_item(item)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static void put_transaction(std::vector<uint8_t>& out, const IndexedTransaction& tx) {
+    put_string(out, tx.txid);
+    put(out, tx.block_height);
+    put(out, tx.block_time);
+    put(out, tx.amount);
+}
+
+static void put_utxo(std::vector<uint8_t>& out, const IndexedUtxo& utxo) {
+    put_string(out, utxo.txid);
+    put(out, utxo.vout);
+    put(out, utxo.value);
+    put(out, utxo.block_height);
+}
+
+UtxoIndex::UtxoIndex(const std::filesystem::path& path)
+    : path_(path), log_path_(path.string() + ".log"), log_fd_(-1) {
+    // Writes and queued log syncs go through the DurableWriter, which has
+    // to outlive this
+    DurableWriter::shared();
+
+    if (std::filesystem::exists(path_) && !read_file()) {
+        // Everything here can be fetched again
+        std::cerr << "Warning: discarding corrupt UTXO index " << path_ << std::endl;
+        entries_.clear();
+    }
+    std::lock_guard<std::mutex> lock(file_mutex_);
+    open_log();
+}
+
+UtxoIndex::~UtxoIndex() {
+    DurableWriter::shared().flush();
+    ::close(log_fd_);
+}
+
+UtxoIndex& UtxoIndex::for_network(const std::string& network) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::unique_ptr<UtxoIndex>> indexes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& index = indexes[network];
+    if (!index) {
+        index = std::make_unique<UtxoIndex>(WalletStorage::get_wallet_dir() / ("utxo-" + network + ".idx"));
+    }
+    return *index;
+}
+
+void UtxoIndex::sync(const NetworkClient& client, const std::vector<std::string>& addresses) {
+    // Claim the addresses for the whole sync. Each result is computed from
+    // the entry read below, so two syncs of one address must not overlap;
+    // syncs of other addresses carry on.
+    struct Claim {
+        UtxoIndex& index;
+        const std::vector<std::string>& addresses;
+
+        Claim(UtxoIndex& index, const std::vector<std::string>& addresses) : index(index), addresses(addresses) {
+            std::unique_lock<std::mutex> lock(index.mutex_);
+            index.sync_done_.wait(lock, [&] {
+                return std::none_of(addresses.begin(), addresses.end(),
+                                    [&](const std::string& address) { return index.syncing_.count(address) > 0; });
+            });
+            index.syncing_.insert(addresses.begin(), addresses.end());
+        }
+        ~Claim() {
+            {
+                std::lock_guard<std::mutex> lock(index.mutex_);
+                for (const auto& address : addresses) {
+                    index.syncing_.erase(address);
+                }
+            }
+            index.sync_done_.notify_all();
+        }
+    } claim(*this, addresses);
+
+    // Cheap change detection: one stats request per address, usually
+    // answered by the response cache
+    auto stats = client.get_address_stats(addresses);
+
+    struct Work {
+        const std::string* address;
+        Entry entry;
+        std::string after;  // Page cursor; empty for the first page
+        std::vector<ChainTransaction> fresh;    // Confirmed, newest first
+        std::vector<ChainTransaction> mempool;
+        bool found_tip = false;
+        bool failed = false;
+    };
+    std::vector<Work> work;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++syncs_;
+        addresses_checked_ += addresses.size();
+        for (size_t i = 0; i < addresses.size(); ++i) {
+            auto it = entries_.find(addresses[i]);
+            size_t indexed = it == entries_.end() ? 0 : it->second.history.size();
+            int64_t indexed_balance = it == entries_.end() ? 0 : it->second.confirmed_balance;
+            bool has_pending = it != entries_.end() && (!it->second.pending.empty() ||
+                                                        !it->second.pending_spent.empty() ||
+                                                        !it->second.local_spent.empty());
+            // A reorg can keep the count but rarely the amounts
+            if (stats[i].confirmed_tx_count() == indexed && stats[i].confirmed_satoshis == indexed_balance &&
+                stats[i].mempool_tx_count == 0 && !has_pending) {
+                continue;
+            }
+            Work item;
+            item.address = &addresses[i];
+            if (it != entries_.end()) {
+                item.entry = it->second;
+            }
+            work.push_back(std::move(item));
+        }
+    }
+    if (work.empty()) {
+        return;
+    }
+
+    // Page backwards through each changed address until its tip turns up
+    // or its history ends; all addresses advance one page per round
+    std::vector<Work*> active;
+    for (auto& item : work) {
+        active.push_back(&item);
+    }
+    uint64_t pages_fetched = 0;
+    while (!active.empty()) {
+        std::vector<std::string> page_addresses;
+        std::vector<std::string> afters;
+        for (Work* item : active) {
+            page_addresses.push_back(*item->address);
+            afters.push_back(item->after);
+        }
+        auto pages = client.get_transaction_pages(page_addresses, afters);
+        pages_fetched += pages.size();
+
+        std::vector<Work*> next;
+        for (size_t j = 0; j < pages.size(); ++j) {
+            Work& item = *active[j];
+            if (!pages[j].ok()) {
+                std::cerr << "Error syncing address " << *item.address << ": " << pages[j].error << std::endl;
+                item.failed = true;
+                continue;
+            }
+
+            size_t confirmed_in_page = 0;
+            for (auto& tx : pages[j].transactions) {
+                if (!tx.confirmed) {
+                    if (item.after.empty()) {
+                        item.mempool.push_back(std::move(tx));
+                    }
+                    continue;
+                }
+                ++confirmed_in_page;
+                if (!item.entry.tip_txid.empty() && tx.txid == item.entry.tip_txid) {
+                    item.found_tip = true;
+                    break;
+                }
+                item.fresh.push_back(std::move(tx));
+            }
+
+            if (!item.found_tip && confirmed_in_page == NetworkClient::TRANSACTION_PAGE_SIZE) {
+                item.after = item.fresh.back().txid;
+                next.push_back(&item);
+            }
+        }
+        active.swap(next);
+    }
+
+    uint64_t fetched = 0;
+    uint64_t rebuilds = 0;
+    for (auto& item : work) {
+        if (item.failed) {
+            continue;
+        }
+        Entry& entry = item.entry;
+        if (!entry.tip_txid.empty() && !item.found_tip) {
+            // The tip left the chain; what was fetched is the whole history
+            entry.tip_txid.clear();
+            entry.history.clear();
+            entry.utxos.clear();
+            entry.confirmed_balance = 0;
+            ++rebuilds;
+        }
+        for (auto tx = item.fresh.rbegin(); tx != item.fresh.rend(); ++tx) {
+            apply_confirmed(entry, *item.address, *tx);
+        }
+        if (!item.fresh.empty()) {
+            entry.tip_txid = item.fresh.front().txid;
+        }
+        set_pending(entry, *item.address, item.mempool);
+        ++fetched;
+    }
+
+    std::vector<uint8_t> records;
+    for (const auto& item : work) {
+        if (item.failed) {
+            continue;
+        }
+        size_t start = records.size();
+        records.resize(start + LOG_RECORD_HEADER_SIZE);
+        put_entry(records, *item.address, item.entry);
+        uint32_t size = static_cast<uint32_t>(records.size() - start - LOG_RECORD_HEADER_SIZE);
+        uint32_t crc = crc32c(0, records.data() + start + LOG_RECORD_HEADER_SIZE, size);
+        std::memcpy(records.data() + start, &size, sizeof(size));
+        std::memcpy(records.data() + start + 4, &crc, sizeof(crc));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& item : work) {
+            if (item.failed) {
+                continue;
+            }
+            // Spends marked while the pages were fetched are only in the
+            // live entry; keep those the fetched state does not show yet
+            Entry& current = entries_[*item.address];
+            item.entry.local_spent = std::move(current.local_spent);
+            drop_seen_local_spends(item.entry);
+            current = std::move(item.entry);
+        }
+        addresses_fetched_ += fetched;
+        pages_fetched_ += pages_fetched;
+        rebuilds_ += rebuilds;
+    }
+    // Still under the claim, so the records of an address reach the log in
+    // the order its syncs ran
+    if (!records.empty()) {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        append_log(records);
+    }
+}
+
+void UtxoIndex::apply_confirmed(Entry& entry, const std::string& address, const ChainTransaction& tx) {
+    int64_t amount = 0;
+    for (const auto& input : tx.inputs) {
+        if (input.prev_address != address) {
+            continue;
+        }
+        amount -= static_cast<int64_t>(input.prev_value);
+        auto spent = std::find_if(entry.utxos.begin(), entry.utxos.end(), [&](const IndexedUtxo& utxo) {
+            return utxo.vout == input.prev_vout && utxo.txid == input.prev_txid;
+        });
+        if (spent != entry.utxos.end()) {
+            *spent = std::move(entry.utxos.back());
+            entry.utxos.pop_back();
+        }
+    }
+    for (size_t i = 0; i < tx.outputs.size(); ++i) {
+        if (tx.outputs[i].address != address) {
+            continue;
+        }
+        amount += static_cast<int64_t>(tx.outputs[i].value);
+        entry.utxos.push_back(IndexedUtxo{tx.txid, static_cast<uint32_t>(i), tx.outputs[i].value, tx.block_height});
+    }
+    entry.confirmed_balance += amount;
+    entry.history.push_back(IndexedTransaction{tx.txid, tx.block_height, tx.block_time, amount});
+}
+
+void UtxoIndex::set_pending(Entry& entry, const std::string& address,
+                            const std::vector<ChainTransaction>& mempool) {
+    entry.pending.clear();
+    entry.pending_utxos.clear();
+    entry.pending_spent.clear();
+    entry.pending_balance = 0;
+
+    for (const auto& tx : mempool) {
+        int64_t amount = 0;
+        for (const auto& input : tx.inputs) {
+            if (input.prev_address == address) {
+                amount -= static_cast<int64_t>(input.prev_value);
+                entry.pending_spent.push_back(Outpoint{input.prev_txid, input.prev_vout});
+            }
+        }
+        for (size_t i = 0; i < tx.outputs.size(); ++i) {
+            if (tx.outputs[i].address == address) {
+                amount += static_cast<int64_t>(tx.outputs[i].value);
+                entry.pending_utxos.push_back(IndexedUtxo{tx.txid, static_cast<uint32_t>(i), tx.outputs[i].value, 0});
+            }
+        }
+        entry.pending_balance += amount;
+        entry.pending.push_back(IndexedTransaction{tx.txid, 0, 0, amount});
+    }
+}
+
+bool UtxoIndex::is_spent(const Entry& entry, const std::string& txid, uint32_t vout) {
+    auto matches = [&](const auto& outpoint) { return outpoint.vout == vout && outpoint.txid == txid; };
+    return std::any_of(entry.pending_spent.begin(), entry.pending_spent.end(), matches) ||
+           std::any_of(entry.local_spent.begin(), entry.local_spent.end(), matches);
+}
+
+void UtxoIndex::drop_seen_local_spends(Entry& entry) {
+    auto seen = [&entry](const IndexedUtxo& spent) {
+        auto matches = [&spent](const auto& outpoint) {
+            return outpoint.vout == spent.vout && outpoint.txid == spent.txid;
+        };
+        // In the mempool's spends, or gone from the outputs altogether
+        return std::any_of(entry.pending_spent.begin(), entry.pending_spent.end(), matches) ||
+               (std::none_of(entry.utxos.begin(), entry.utxos.end(), matches) &&
+                std::none_of(entry.pending_utxos.begin(), entry.pending_utxos.end(), matches));
+    };
+    entry.local_spent.erase(std::remove_if(entry.local_spent.begin(), entry.local_spent.end(), seen),
+                            entry.local_spent.end());
+}
+
+int64_t UtxoIndex::balance(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(address);
+    if (it == entries_.end()) {
+        return 0;
+    }
+    int64_t balance = it->second.confirmed_balance + it->second.pending_balance;
+    for (const auto& spent : it->second.local_spent) {
+        balance -= static_cast<int64_t>(spent.value);
+    }
+    return balance;
+}
+
+std::vector<IndexedUtxo> UtxoIndex::utxos(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<IndexedUtxo> result;
+    auto it = entries_.find(address);
+    if (it == entries_.end()) {
+        return result;
+    }
+
+    const Entry& entry = it->second;
+    for (const auto* set : {&entry.utxos, &entry.pending_utxos}) {
+        for (const auto& utxo : *set) {
+            if (!is_spent(entry, utxo.txid, utxo.vout)) {
+                result.push_back(utxo);
+            }
+        }
+    }
+    return result;
+}
+
+void UtxoIndex::mark_spent(const std::string& address, const std::string& txid, uint32_t vout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(address);
+    if (it == entries_.end()) {
+        return;
+    }
+    Entry& entry = it->second;
+    if (is_spent(entry, txid, vout)) {
+        return;
+    }
+    for (const auto* set : {&entry.utxos, &entry.pending_utxos}) {
+        for (const auto& utxo : *set) {
+            if (utxo.vout == vout && utxo.txid == txid) {
+                entry.local_spent.push_back(utxo);
+                return;
+            }
+        }
+    }
+}
+
+std::vector<IndexedTransaction> UtxoIndex::transactions(const std::string& address) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<IndexedTransaction> result;
+    auto it = entries_.find(address);
+    if (it == entries_.end()) {
+        return result;
+    }
+    result = it->second.pending;
+    result.insert(result.end(), it->second.history.rbegin(), it->second.history.rend());
+    return result;
+}
+
+UtxoIndexStats UtxoIndex::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    UtxoIndexStats stats{};
+    stats.addresses = entries_.size();
+    stats.syncs = syncs_;
+    stats.addresses_checked = addresses_checked_;
+    stats.addresses_fetched = addresses_fetched_;
+    stats.pages_fetched = pages_fetched_;
+    stats.rebuilds = rebuilds_;
+    stats.compactions = compactions_;
+    return stats;
+}
+
+void UtxoIndex::put_entry(std::vector<uint8_t>& out, const std::string& address, const Entry& entry) {
+    put_string(out, address);
+    put_string(out, entry.tip_txid);
+    put<uint32_t>(out, static_cast<uint32_t>(entry.history.size()));
+    for (const auto& tx : entry.history) {
+        put_transaction(out, tx);
+    }
+    put<uint32_t>(out, static_cast<uint32_t>(entry.utxos.size()));
+    for (const auto& utxo : entry.utxos) {
+        put_utxo(out, utxo);
+    }
+    put(out, entry.confirmed_balance);
+    put<uint32_t>(out, static_cast<uint32_t>(entry.pending.size()));
+    for (const auto& tx : entry.pending) {
+        put_transaction(out, tx);
+    }
+    put<uint32_t>(out, static_cast<uint32_t>(entry.pending_utxos.size()));
+    for (const auto& utxo : entry.pending_utxos) {
+        put_utxo(out, utxo);
+    }
+    put<uint32_t>(out, static_cast<uint32_t>(entry.pending_spent.size()));
+    for (const auto& outpoint : entry.pending_spent) {
+        put_string(out, outpoint.txid);
+        put(out, outpoint.vout);
+    }
+    put(out, entry.pending_balance);
+}
+
+template <typename Reader>
+bool UtxoIndex::get_entry(Reader& reader, std::string& address, Entry& entry) {
+    auto get_transaction = [&reader](IndexedTransaction& tx) {
+        return reader.get_string(tx.txid) && reader.get(tx.block_height) && reader.get(tx.block_time) &&
+               reader.get(tx.amount);
+    };
+    auto get_utxo = [&reader](IndexedUtxo& utxo) {
+        return reader.get_string(utxo.txid) && reader.get(utxo.vout) && reader.get(utxo.value) &&
+               reader.get(utxo.block_height);
+    };
+    auto get_outpoint = [&reader](Outpoint& outpoint) {
+        return reader.get_string(outpoint.txid) && reader.get(outpoint.vout);
+    };
+    return reader.get_string(address) && reader.get_string(entry.tip_txid) &&
+           reader.get_list(entry.history, get_transaction) && reader.get_list(entry.utxos, get_utxo) &&
+           reader.get(entry.confirmed_balance) && reader.get_list(entry.pending, get_transaction) &&
+           reader.get_list(entry.pending_utxos, get_utxo) && reader.get_list(entry.pending_spent, get_outpoint) &&
+           reader.get(entry.pending_balance);
+}
+
+bool UtxoIndex::read_file() {
+    std::ifstream file(path_, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < INDEX_HEADER_SIZE) {
+        return false;
+    }
+
+    uint16_t version;
+    uint32_t count;
+    uint32_t crc;
+    std::memcpy(&version, data.data() + 4, sizeof(version));
+    std::memcpy(&count, data.data() + 8, sizeof(count));
+    std::memcpy(&crc, data.data() + 12, sizeof(crc));
+    if (std::memcmp(data.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || version != INDEX_VERSION ||
+        crc32c(0, data.data() + INDEX_HEADER_SIZE, data.size() - INDEX_HEADER_SIZE) != crc) {
+        return false;
+    }
+
+    IndexReader reader{data.data() + INDEX_HEADER_SIZE, data.data() + data.size()};
+    std::unordered_map<std::string, Entry> entries;
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string address;
+        Entry entry;
+        if (!get_entry(reader, address, entry)) {
+            return false;
+        }
+        entries.emplace(std::move(address), std::move(entry));
+    }
+
+    entries_ = std::move(entries);
+    snapshot_size_ = data.size();
+    return true;
+}
+
+void UtxoIndex::write_file() {
+    std::vector<uint8_t> data(INDEX_HEADER_SIZE, 0);
+    uint32_t count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count = static_cast<uint32_t>(entries_.size());
+        for (const auto& item : entries_) {
+            put_entry(data, item.first, item.second);
+        }
+    }
+
+    uint16_t version = INDEX_VERSION;
+    uint32_t crc = crc32c(0, data.data() + INDEX_HEADER_SIZE, data.size() - INDEX_HEADER_SIZE);
+    std::memcpy(data.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    std::memcpy(data.data() + 4, &version, sizeof(version));
+    std::memcpy(data.data() + 8, &count, sizeof(count));
+    std::memcpy(data.data() + 12, &crc, sizeof(crc));
+
+    snapshot_size_ = data.size();
+    DurableWriter::shared().replace(path_, std::move(data));
+}
+
+void UtxoIndex::open_log() {
+    log_fd_ = ::open(log_path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (log_fd_ < 0) {
+        throw WalletError::storage("Failed to open " + log_path_.string());
+    }
+
+    std::ifstream file(log_path_, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Records replace whole entries, so replaying them in order over the
+    // snapshot gives the latest state of each address
+    size_t valid = 0;
+    uint16_t version = 0;
+    if (data.size() >= LOG_HEADER_SIZE) {
+        std::memcpy(&version, data.data() + 4, sizeof(version));
+    }
+    if (data.size() >= LOG_HEADER_SIZE && std::memcmp(data.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) == 0 &&
+        version == LOG_VERSION) {
+        valid = LOG_HEADER_SIZE;
+        while (data.size() - valid >= LOG_RECORD_HEADER_SIZE) {
+            uint32_t size;
+            uint32_t crc;
+            std::memcpy(&size, data.data() + valid, sizeof(size));
+            std::memcpy(&crc, data.data() + valid + 4, sizeof(crc));
+            const uint8_t* record = data.data() + valid + LOG_RECORD_HEADER_SIZE;
+            if (data.size() - valid - LOG_RECORD_HEADER_SIZE < size || crc32c(0, record, size) != crc) {
+                break;
+            }
+            IndexReader reader{record, record + size};
+            std::string address;
+            Entry entry;
+            if (!get_entry(reader, address, entry) || reader.p != reader.end) {
+                break;
+            }
+            entries_[address] = std::move(entry);
+            valid += LOG_RECORD_HEADER_SIZE + size;
+        }
+    }
+
+    if (valid == data.size()) {
+        log_size_ = valid;
+        if (valid > 0) {
+            return;
+        }
+    } else {
+        // A record torn by a crash, or a log this version cannot read; new
+        // records must not land behind it
+        std::cerr << "Warning: truncating UTXO index log " << log_path_ << " to " << valid << " bytes"
+                  << std::endl;
+    }
+    if (ftruncate(log_fd_, static_cast<off_t>(valid)) != 0) {
+        throw WalletError::storage("Failed to truncate " + log_path_.string());
+    }
+    log_size_ = valid;
+    if (valid == 0) {
+        std::vector<uint8_t> header(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC));
+        put<uint16_t>(header, LOG_VERSION);
+        put<uint16_t>(header, 0);
+        append_log(header);
+    }
+}
+
+void UtxoIndex::append_log(const std::vector<uint8_t>& records) {
+    size_t done = 0;
+    while (done < records.size()) {
+        ssize_t n = ::write(log_fd_, records.data() + done, records.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // The entries are still current in memory; cut the partial
+            // record so later ones stay readable
+            std::cerr << "Warning: failed to append to UTXO index log " << log_path_ << ": "
+                      << std::strerror(errno) << std::endl;
+            if (ftruncate(log_fd_, static_cast<off_t>(log_size_)) != 0) {
+                std::cerr << "Warning: failed to truncate " << log_path_ << std::endl;
+            }
+            return;
+        }
+        done += static_cast<size_t>(n);
+    }
+    log_size_ += records.size();
+
+    // Everything in the index can be fetched again, so syncs do not wait
+    // for the disk; a burst of them shares one fdatasync
+    int fd = log_fd_;
+    DurableWriter::shared().schedule_sync(log_path_, [fd] { ::fdatasync(fd); });
+
+    if (log_size_ > std::max(snapshot_size_, LOG_COMPACT_MIN_SIZE)) {
+        // Once the snapshot is durable the log is redundant. If the truncate
+        // is lost to a crash, replay may set an address back to an earlier
+        // state, which the next sync brings forward like any other.
+        write_file();
+        if (ftruncate(log_fd_, static_cast<off_t>(LOG_HEADER_SIZE)) != 0) {
+            throw WalletError::storage("Failed to truncate " + log_path_.string());
+        }
+        log_size_ = LOG_HEADER_SIZE;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++compactions_;
+    }
+}
+
+} // namespace crypto_wallet
@@ -2,12 +2,22 @@
 #include "storage.h"
 #include "network.h"
 #include "crypto.h"
+#include "thread_pool.h"
+#include "discovery.h"
+#include "utxo_index.h"
+#include "coin_selection.h"
+#include <openssl/crypto.h>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <atomic>
+#include <new>
+#include <random>
 
 namespace crypto_wallet {
 
-Wallet Wallet::create_new(const std::string& name) {
+Wallet Wallet::create_new(const std::string& name, const std::string& password) {
     Wallet wallet;
     wallet.name = name;
     wallet.seed_phrase = Crypto::generate_mnemonic();
@@ -17,17 +27,20 @@ Wallet Wallet::create_new(const std::string& name) {
     auto address = wallet.generate_address(0);
     wallet.addresses.push_back(address);
     
+    if (!password.empty()) {
+        WalletStorage::set_password(wallet, password);
+    }
+    
     // Save wallet
     wallet.save();
     
     return wallet;
 }
 
-Wallet Wallet::from_seed_phrase(const std::string& seed_phrase, const std::string& name) {
+Wallet Wallet::from_seed_phrase(const std::string& seed_phrase, const std::string& name,
+                                const std::string& password) {
     // Validate seed phrase
-    try {
-        Crypto::mnemonic_to_seed(seed_phrase);
-    } catch (...) {
+    if (!Crypto::validate_mnemonic(seed_phrase)) {
         throw WalletError::invalid_seed_phrase();
     }
     
@@ -40,6 +53,10 @@ Wallet Wallet::from_seed_phrase(const std::string& seed_phrase, const std::strin
     auto address = wallet.generate_address(0);
     wallet.addresses.push_back(address);
     
+    if (!password.empty()) {
+        WalletStorage::set_password(wallet, password);
+    }
+    
     // Save wallet
     wallet.save();
     
@@ -54,65 +71,301 @@ void Wallet::save() const {
     WalletStorage::save(*this);
 }
 
+const std::array<uint8_t, 64>& Wallet::seed() const {
+    // Concurrent first calls may both run the KDF; either result is fine
+    auto cached = std::atomic_load(&seed_cache_);
+    if (!cached) {
+        cached = std::make_shared<LockedBuffer>(sizeof(std::array<uint8_t, 64>));
+        new (cached->data()) std::array<uint8_t, 64>(Crypto::mnemonic_to_seed(seed_phrase));
+        std::atomic_store(&seed_cache_, cached);
+    }
+    return *reinterpret_cast<const std::array<uint8_t, 64>*>(cached->data());
+}
+
+// BIP44 external and internal (change) chains of the first Bitcoin account
+static const std::string RECEIVE_CHAIN_PATH = "m/44'/0'/0'/0";
+static const std::string CHANGE_CHAIN_PATH = "m/44'/0'/0'/1";
+
+bool Wallet::supports_network(const std::string& network) {
+    return network == "mainnet" || network == "mock";
+}
+
+static void require_supported_network(const std::string& network) {
+    if (!Wallet::supports_network(network)) {
+        throw WalletError::network("Wallet addresses are mainnet addresses; network '" + network +
+                                   "' is not supported");
+    }
+}
+
+static std::string address_of(const ExtendedKey& key) {
+    std::vector<uint8_t> public_key(key.public_key.begin(), key.public_key.end());
+    return Crypto::public_key_to_address(public_key, "mainnet");
+}
+
+static std::string address_for_child(const ExtendedKey& chain, uint32_t index) {
+    return address_of(chain.derive_child(index));
+}
+
 std::string Wallet::generate_address(uint32_t index) const {
-    auto seed = Crypto::mnemonic_to_seed(seed_phrase);
-    std::string derivation_path = "m/44'/0'/0'/0/" + std::to_string(index);
-    auto key = Crypto::derive_key_from_seed(seed, derivation_path);
+    auto chain = Crypto::derive_node_cached(seed(), RECEIVE_CHAIN_PATH);
+    return address_for_child(chain, index);
+}
+
+std::vector<std::string> Wallet::generate_addresses(uint32_t first, uint32_t count, bool change) const {
+    auto chain = Crypto::derive_node_cached(seed(), change ? CHANGE_CHAIN_PATH : RECEIVE_CHAIN_PATH);
     
-    // For demo purposes, generate a simple address
-    std::vector<uint8_t> address_bytes = {0x00}; // Mainnet prefix
-    address_bytes.insert(address_bytes.end(), key.begin(), key.begin() + 20);
-    address_bytes.insert(address_bytes.end(), {0x00, 0x00, 0x00, 0x00}); // Simple checksum
+    // Children are independent, so they are derived across the shared pool;
+    // each block's keys are then hashed into addresses together
+    std::vector<std::string> result(count);
+    ThreadPool::shared().parallel_for(count, 64, [&](size_t begin, size_t end) {
+        std::vector<std::array<uint8_t, 33>> public_keys(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            auto child = chain.derive_child(first + static_cast<uint32_t>(i));
+            OPENSSL_cleanse(child.secret_key.data(), child.secret_key.size());
+            public_keys[i - begin] = child.public_key;
+        }
+        auto addresses = Crypto::public_keys_to_addresses(public_keys.data(), public_keys.size(), "mainnet");
+        std::move(addresses.begin(), addresses.end(), result.begin() + static_cast<std::ptrdiff_t>(begin));
+    });
+    return result;
+}
+
+double Wallet::discover_addresses(const std::string& network) {
+    require_supported_network(network);
+    auto client = NetworkClient::create(network);
+    AddressDiscovery discovery(*this, *client);
+    auto result = discovery.run();
+    for (const auto* chain : {&result.receive, &result.change}) {
+        if (chain->truncated) {
+            std::cerr << "Warning: stopped discovery after " << chain->scanned << " "
+                      << (chain == &result.change ? "change" : "receive")
+                      << " addresses without finding a gap; later addresses were not scanned" << std::endl;
+        }
+    }
     
-    return Crypto::base58_encode(address_bytes);
+    // Never shrink what the wallet already handed out
+    if (result.receive.addresses.size() > addresses.size()) {
+        addresses = std::move(result.receive.addresses);
+    }
+    if (result.change.addresses.size() > change_addresses.size()) {
+        change_addresses = std::move(result.change.addresses);
+    }
+    save();
+    
+    return result.receive.balance + result.change.balance;
 }
 
 std::string Wallet::add_new_address() {
-    uint32_t index = static_cast<uint32_t>(addresses.size());
-    auto address = generate_address(index);
+    uint32_t index = 0;
+    auto address = WalletStorage::append_next_address(name, WalletFile::RECEIVE, [&](uint32_t next) {
+        index = next;
+        return generate_address(next);
+    });
+    // Another copy of the wallet may have added addresses meanwhile; list
+    // them too so positions stay child indexes
+    if (index > addresses.size()) {
+        auto missed = generate_addresses(static_cast<uint32_t>(addresses.size()),
+                                         index - static_cast<uint32_t>(addresses.size()));
+        addresses.insert(addresses.end(), missed.begin(), missed.end());
+    }
+    addresses.resize(index);
     addresses.push_back(address);
-    save();
     return address;
 }
 
 double Wallet::get_balance(const std::string& network) const {
+    require_supported_network(network);
     auto client = NetworkClient::create(network);
-    double total_balance = 0.0;
-    
-    for (const auto& address : addresses) {
-        try {
-            auto balance = client->get_balance(address);
-            total_balance += balance;
-        } catch (const WalletError& e) {
-            // Log error but continue with other addresses
-            std::cerr << "Error getting balance for address " << address << ": " << e.what() << std::endl;
-        }
+    auto& index = UtxoIndex::for_network(network);
+    
+    // Funds sent back as change count too
+    auto wallet_addresses = all_addresses();
+    
+    // Only addresses whose history moved are fetched; the rest is read
+    // from the local index
+    try {
+        index.sync(*client, wallet_addresses);
+    } catch (const WalletError& e) {
+        std::cerr << "Warning: balance may be out of date: " << e.what() << std::endl;
+    }
+    
+    int64_t total_satoshis = 0;
+    for (const auto& address : wallet_addresses) {
+        total_satoshis += index.balance(address);
     }
     
-    return total_balance;
+    return total_satoshis / 100000000.0;
+}
+
+std::vector<std::string> Wallet::all_addresses() const {
+    std::vector<std::string> result(addresses);
+    result.insert(result.end(), change_addresses.begin(), change_addresses.end());
+    return result;
+}
+
+std::string Wallet::change_address(const UtxoIndex& index) const {
+    for (const auto& address : change_addresses) {
+        if (index.transactions(address).empty()) {
+            return address;
+        }
+    }
+    // Numbered from the file, since every send from this snapshot, here or
+    // on another thread, would otherwise pick the same next index
+    return WalletStorage::append_next_address(name, WalletFile::CHANGE, [this](uint32_t next) {
+        return generate_addresses(next, 1, true).front();
+    });
+}
+
+// Rate the wallet expects to pay when it spends an output some other time,
+// in sat/vB. Above it branch and bound favours fewer inputs; below it,
+// spending more of them now.
+static constexpr double LONG_TERM_FEE_RATE = 10.0;
+
+static uint64_t fee_for(size_t size, double fee_rate) {
+    return static_cast<uint64_t>(std::ceil(size * fee_rate));
 }
 
 std::string Wallet::send_transaction(
     const std::string& to_address, 
     double amount, 
-    const std::string& network
+    const std::string& network,
+    uint32_t confirmation_target
 ) const {
-    // Validate address format
-    if (!is_valid_address(to_address)) {
-        throw WalletError::invalid_address("Invalid recipient address: " + to_address);
+    if (!(amount > 0) || amount > 21000000.0) {
+        throw WalletError::invalid_amount(std::to_string(amount));
+    }
+    return send_payouts({Payout{to_address, static_cast<uint64_t>(std::llround(amount * 100000000.0))}}, network,
+                        confirmation_target);
+}
+
+std::string Wallet::send_payouts(
+    const std::vector<Payout>& payouts,
+    const std::string& network,
+    uint32_t confirmation_target
+) const {
+    require_supported_network(network);
+    if (payouts.empty()) {
+        throw WalletError::invalid_amount("nothing to pay");
     }
     
-    // Check balance
-    auto balance = get_balance(network);
-    if (balance < amount) {
-        throw WalletError::insufficient_funds();
+    std::vector<std::vector<uint8_t>> scripts;
+    uint64_t total = 0;
+    size_t outputs_size = 0;
+    for (const auto& payout : payouts) {
+        // Checks the address and that it belongs to this network
+        scripts.push_back(TransactionBuilder::output_script(payout.address, network));
+        if (payout.amount < TransactionBuilder::DUST_LIMIT) {
+            throw WalletError::invalid_amount(std::to_string(payout.amount) + " satoshis to " + payout.address +
+                                              " is below the dust limit");
+        }
+        outputs_size += TransactionBuilder::output_size(scripts.back());
+        total += payout.amount;
     }
     
-    // Create transaction
+    // Coins come from the index, so a stale view would only be rejected
+    // on broadcast; unlike get_balance, a failed sync is an error here
     auto client = NetworkClient::create(network);
-    auto tx_hash = client->send_transaction(addresses[0], to_address, amount);
+    auto& index = UtxoIndex::for_network(network);
+    auto wallet_addresses = all_addresses();
+    index.sync(*client, wallet_addresses);
+    double fee_rate = client->estimate_fee_rate(confirmation_target);
+    
+    struct OwnedCoin {
+        IndexedUtxo utxo;
+        size_t address;  // Into wallet_addresses
+    };
+    std::vector<OwnedCoin> owned;
+    std::vector<CoinCandidate> candidates;
+    uint64_t input_fee = fee_for(TransactionBuilder::P2PKH_INPUT_SIZE, fee_rate);
+    uint64_t long_term_input_fee = fee_for(TransactionBuilder::P2PKH_INPUT_SIZE, LONG_TERM_FEE_RATE);
+    for (size_t i = 0; i < wallet_addresses.size(); ++i) {
+        for (auto& utxo : index.utxos(wallet_addresses[i])) {
+            candidates.push_back(CoinCandidate{utxo.value, input_fee, long_term_input_fee});
+            owned.push_back(OwnedCoin{std::move(utxo), i});
+        }
+    }
+    
+    CoinSelectionParams params;
+    params.target = total + fee_for(TransactionBuilder::TX_OVERHEAD_SIZE + outputs_size, fee_rate);
+    params.change_fee = fee_for(TransactionBuilder::P2PKH_OUTPUT_SIZE, fee_rate);
+    params.cost_of_change = params.change_fee + long_term_input_fee;
+    params.min_change = TransactionBuilder::DUST_LIMIT;
+    auto selection = select_coins(candidates, params);
+    
+    // Keys only for the coins being spent, checked against the addresses
+    // the index knows them by
+    TransactionBuilder builder;
+    LockedBuffer keys(32 * selection.selected.size());
+    auto receive_chain = Crypto::derive_node_cached(seed(), RECEIVE_CHAIN_PATH);
+    auto change_chain = Crypto::derive_node_cached(seed(), CHANGE_CHAIN_PATH);
+    for (size_t k = 0; k < selection.selected.size(); ++k) {
+        const OwnedCoin& coin = owned[selection.selected[k]];
+        bool change = coin.address >= addresses.size();
+        uint32_t child_index = static_cast<uint32_t>(change ? coin.address - addresses.size() : coin.address);
+        auto child = (change ? change_chain : receive_chain).derive_child(child_index);
+        if (address_of(child) != wallet_addresses[coin.address]) {
+            OPENSSL_cleanse(child.secret_key.data(), child.secret_key.size());
+            throw WalletError::crypto("Address " + wallet_addresses[coin.address] + " does not match the seed");
+        }
+        builder.add_input(coin.utxo.txid, coin.utxo.vout, coin.utxo.value, child.public_key);
+        std::memcpy(keys.data() + 32 * k, child.secret_key.data(), 32);
+        OPENSSL_cleanse(child.secret_key.data(), child.secret_key.size());
+    }
+    
+    // Change, if any, goes at a random position so it cannot be told from
+    // the payouts by where it sits
+    std::string change;
+    uint64_t change_value = 0;
+    std::vector<uint8_t> change_script;
+    if (selection.change) {
+        TransactionBuilder sized = builder;
+        for (const auto& script : scripts) {
+            sized.add_output(script, 0);
+        }
+        // Change addresses are P2PKH like every wallet address
+        uint64_t fee = fee_for(sized.max_size() + TransactionBuilder::P2PKH_OUTPUT_SIZE, fee_rate);
+        if (selection.value > total + fee && selection.value - total - fee >= TransactionBuilder::DUST_LIMIT) {
+            change_value = selection.value - total - fee;
+            change = change_address(index);
+            change_script = TransactionBuilder::output_script(change, network);
+        }
+    }
+    size_t change_position = scripts.size() + 1;
+    if (change_value > 0) {
+        std::random_device random;
+        change_position = std::uniform_int_distribution<size_t>(0, scripts.size())(random);
+    }
+    for (size_t i = 0; i <= scripts.size(); ++i) {
+        if (i == change_position) {
+            builder.add_output(change_script, change_value);
+        }
+        if (i < scripts.size()) {
+            builder.add_output(std::move(scripts[i]), payouts[i].amount);
+        }
+    }
+    
+    // Without change whatever is left over is fee, but never too little
+    if (selection.value < builder.output_value() + fee_for(builder.max_size(), fee_rate)) {
+        throw WalletError::insufficient_funds();
+    }
+    
+    auto signed_tx = builder.sign(keys);
+    auto txid = client->send_transaction(signed_tx.hex());
+    if (txid != signed_tx.txid) {
+        std::cerr << "Warning: node reported txid " << txid << " for " << signed_tx.txid << std::endl;
+    }
+    
+    // Keep the next payout off these coins until the index sees the spend
+    for (size_t i : selection.selected) {
+        const OwnedCoin& coin = owned[i];
+        index.mark_spent(wallet_addresses[coin.address], coin.utxo.txid, coin.utxo.vout);
+        client->forget_address(wallet_addresses[coin.address]);
+    }
+    if (change_value > 0) {
+        client->forget_address(change);
+    }
     
-    return tx_hash;
+    return txid;
 }
 
 bool Wallet::is_valid_address(const std::string& address) const {
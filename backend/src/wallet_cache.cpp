@@ -0,0 +1,223 @@
+#include "wallet_cache.h"
+#include "wallet_crypto.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace crypto_wallet {
+
+WalletCache::WalletCache(size_t capacity, size_t shards)
+    : hits_(0), misses_(0), evictions_(0), invalidations_(0), inotify_fd_(-1), wake_fd_(-1) {
+    shards = std::max<size_t>(shards, 1);
+    shard_capacity_ = std::max<size_t>(capacity / shards, 1);
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+WalletCache::~WalletCache() {
+    stop_watching();
+}
+
+WalletCache& WalletCache::shared() {
+    static WalletCache cache;
+    return cache;
+}
+
+WalletCache::Shard& WalletCache::shard_for(const std::string& name) {
+    return *shards_[std::hash<std::string>()(name) % shards_.size()];
+}
+
+std::shared_ptr<const Wallet> WalletCache::get(const std::string& name) {
+    Shard& shard = shard_for(name);
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(name);
+        // An encrypted wallet's snapshot holds its decrypted seed, so it is
+        // served only while the keyring still has the key; asking also
+        // counts as use against the keyring's idle timeout
+        if (it != shard.index.end() && it->second->second->encrypted && !WalletKeyring::shared().get(name)) {
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+            ++shard.generation;
+            ++invalidations_;
+            it = shard.index.end();
+        }
+        if (it != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            ++hits_;
+            return it->second->second;
+        }
+        generation = shard.generation;
+    }
+    ++misses_;
+
+    // Load outside the lock so a slow disk does not stall the whole shard
+    auto wallet = std::make_shared<const Wallet>(Wallet::load(name));
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(name);
+    if (it != shard.index.end()) {
+        // Another thread loaded it meanwhile
+        return it->second->second;
+    }
+    if (shard.generation == generation) {
+        insert_locked(shard, name, wallet);
+    }
+    return wallet;
+}
+
+void WalletCache::insert_locked(Shard& shard, const std::string& name,
+                                std::shared_ptr<const Wallet> wallet) {
+    shard.entries.emplace_front(name, std::move(wallet));
+    shard.index[name] = shard.entries.begin();
+    while (shard.entries.size() > shard_capacity_) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+        ++evictions_;
+    }
+}
+
+void WalletCache::refresh(const Wallet& wallet) {
+    Shard& shard = shard_for(wallet.name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.generation;
+    auto it = shard.index.find(wallet.name);
+    if (it != shard.index.end()) {
+        it->second->second = std::make_shared<const Wallet>(wallet);
+    }
+}
+
+void WalletCache::invalidate(const std::string& name) {
+    Shard& shard = shard_for(name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.generation;
+    auto it = shard.index.find(name);
+    if (it != shard.index.end()) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        ++invalidations_;
+    }
+}
+
+void WalletCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        ++shard->generation;
+        invalidations_ += shard->entries.size();
+        shard->entries.clear();
+        shard->index.clear();
+    }
+}
+
+WalletCacheStats WalletCache::stats() const {
+    WalletCacheStats stats{};
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.invalidations = invalidations_;
+    stats.capacity = shard_capacity_ * shards_.size();
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.size += shard->entries.size();
+    }
+    return stats;
+}
+
+#ifdef __linux__
+
+bool WalletCache::watch(const std::filesystem::path& directory) {
+    if (watcher_.joinable()) {
+        return true;
+    }
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    // Renames cover atomic replaces, attribute changes cover syncs of
+    // in-place appends, which inotify cannot see as writes through mmap
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB | IN_MODIFY;
+    if (inotify_fd_ < 0 || wake_fd_ < 0 || inotify_add_watch(inotify_fd_, directory.c_str(), mask) < 0) {
+        stop_watching();
+        return false;
+    }
+
+    // Anything cached before the watch started may already be stale
+    clear();
+    watcher_ = std::thread(&WalletCache::watch_loop, this);
+    return true;
+}
+
+void WalletCache::stop_watching() {
+    if (watcher_.joinable()) {
+        uint64_t one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) < 0) {
+            std::cerr << "Warning: failed to wake wallet cache watcher" << std::endl;
+        }
+        watcher_.join();
+    }
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);
+        inotify_fd_ = -1;
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+        wake_fd_ = -1;
+    }
+}
+
+void WalletCache::watch_loop() {
+    alignas(struct inotify_event) char buffer[4096];
+    pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+
+        ssize_t length;
+        while ((length = ::read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    clear();
+                    continue;
+                }
+                if (event->len == 0) {
+                    continue;
+                }
+                std::filesystem::path file(event->name);
+                auto extension = file.extension();
+                if (extension == ".wallet" || extension == ".json") {
+                    invalidate(file.stem().string());
+                }
+            }
+        }
+    }
+}
+
+#else
+
+bool WalletCache::watch(const std::filesystem::path&) {
+    return false;
+}
+
+void WalletCache::stop_watching() {}
+
+void WalletCache::watch_loop() {}
+
+#endif
+
+} // namespace crypto_wallet
@@ -0,0 +1,323 @@
+#include "wallet_catalog.h"
+#include "durable_writer.h"
+#include "checksum.h"
+#include "error.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace crypto_wallet {
+
+static constexpr char CATALOG_MAGIC[4] = {'C', 'W', 'C', 'T'};
+static constexpr uint16_t CATALOG_VERSION = 1;
+
+// magic, version, reserved, entry count, CRC32C of the entries
+static constexpr size_t CATALOG_HEADER_SIZE = 16;
+
+static int64_t now_seconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+static void put(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void put_string(std::vector<uint8_t>& out, const std::string& value) {
+    put<uint16_t>(out, static_cast<uint16_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// Bounds-checked reader over the entry section
+struct CatalogReader {
+    const uint8_t* p;
+    const uint8_t* end;
+
+    template <typename T>
+    bool get(T& value) {
+        if (static_cast<size_t>(end - p) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool get_string(std::string& value) {
+        uint16_t size;
+        if (!get(size) || static_cast<size_t>(end - p) < size) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(p), size);
+        p += size;
+        return true;
+    }
+};
+
+// Exclusive flock for the lifetime of the object
+class CatalogLock {
+public:
+    explicit CatalogLock(int fd) : fd_(fd) {
+        while (flock(fd_, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                throw WalletError::storage("Failed to lock wallet catalog");
+            }
+        }
+    }
+    ~CatalogLock() { flock(fd_, LOCK_UN); }
+
+private:
+    int fd_;
+};
+
+WalletCatalog::WalletCatalog(const std::filesystem::path& directory, Scanner scan)
+    : path_(directory / "catalog.idx"),
+      lock_path_(directory / "catalog.lock"),
+      scan_(std::move(scan)),
+      loaded_(false) {
+    // Queued count updates call back into this object, so the writer has
+    // to be created first and therefore outlive it
+    DurableWriter::shared();
+
+    lock_fd_ = ::open(lock_path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_fd_ < 0) {
+        throw WalletError::storage("Failed to open " + lock_path_.string());
+    }
+}
+
+WalletCatalog::~WalletCatalog() {
+    DurableWriter::shared().flush();
+    ::close(lock_fd_);
+}
+
+template <typename Fn>
+auto WalletCatalog::transaction(Fn fn) -> decltype(fn()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CatalogLock file_lock(lock_fd_);
+    refresh();
+    apply_pending_upserts();
+    return fn();
+}
+
+WalletCatalog::FileStamp WalletCatalog::stamp_of(const struct stat& st) {
+    FileStamp stamp;
+    stamp.inode = st.st_ino;
+    stamp.size = st.st_size;
+    stamp.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return stamp;
+}
+
+void WalletCatalog::refresh() {
+    struct stat st;
+    if (loaded_ && ::stat(path_.c_str(), &st) == 0 && stamp_of(st) == stamp_) {
+        return;
+    }
+    if (!read_file()) {
+        entries_ = scan_();
+        std::sort(entries_.begin(), entries_.end(),
+                  [](const CatalogEntry& a, const CatalogEntry& b) { return a.name < b.name; });
+        write_file();
+    }
+    loaded_ = true;
+}
+
+bool WalletCatalog::read_file() {
+    int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    std::vector<uint8_t> data;
+    bool ok = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= CATALOG_HEADER_SIZE;
+    if (ok) {
+        data.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::read(fd, data.data() + done, data.size() - done);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                ok = false;
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+    }
+    ::close(fd);
+    if (!ok) {
+        return false;
+    }
+
+    uint16_t version;
+    uint32_t count;
+    uint32_t crc;
+    std::memcpy(&version, data.data() + 4, sizeof(version));
+    std::memcpy(&count, data.data() + 8, sizeof(count));
+    std::memcpy(&crc, data.data() + 12, sizeof(crc));
+    if (std::memcmp(data.data(), CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 || version != CATALOG_VERSION ||
+        crc32c(0, data.data() + CATALOG_HEADER_SIZE, data.size() - CATALOG_HEADER_SIZE) != crc) {
+        return false;
+    }
+
+    std::vector<CatalogEntry> entries(count);
+    CatalogReader reader{data.data() + CATALOG_HEADER_SIZE, data.data() + data.size()};
+    for (auto& entry : entries) {
+        if (!reader.get_string(entry.name) || !reader.get_string(entry.file) ||
+            !reader.get(entry.created_at) || !reader.get(entry.address_count) ||
+            !reader.get(entry.modified_at)) {
+            return false;
+        }
+    }
+
+    entries_ = std::move(entries);
+    stamp_ = stamp_of(st);
+    return true;
+}
+
+void WalletCatalog::write_file() {
+    std::vector<uint8_t> data(CATALOG_HEADER_SIZE, 0);
+    for (const auto& entry : entries_) {
+        put_string(data, entry.name);
+        put_string(data, entry.file);
+        put(data, entry.created_at);
+        put(data, entry.address_count);
+        put(data, entry.modified_at);
+    }
+
+    uint16_t version = CATALOG_VERSION;
+    uint32_t count = static_cast<uint32_t>(entries_.size());
+    uint32_t crc = crc32c(0, data.data() + CATALOG_HEADER_SIZE, data.size() - CATALOG_HEADER_SIZE);
+    std::memcpy(data.data(), CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    std::memcpy(data.data() + 4, &version, sizeof(version));
+    std::memcpy(data.data() + 8, &count, sizeof(count));
+    std::memcpy(data.data() + 12, &crc, sizeof(crc));
+
+    atomic_write_file(path_, data.data(), data.size());
+
+    struct stat st;
+    if (::stat(path_.c_str(), &st) == 0) {
+        stamp_ = stamp_of(st);
+    }
+}
+
+// Queued upserts sit on top of whatever refresh() last read
+void WalletCatalog::apply_pending_upserts() {
+    for (const auto& pending : pending_upserts_) {
+        auto it = lower_bound(pending.first);
+        if (it != entries_.end() && it->name == pending.first) {
+            *it = pending.second;
+        } else {
+            entries_.insert(it, pending.second);
+        }
+    }
+}
+
+std::vector<CatalogEntry>::iterator WalletCatalog::lower_bound(const std::string& name) {
+    return std::lower_bound(entries_.begin(), entries_.end(), name,
+                            [](const CatalogEntry& entry, const std::string& key) { return entry.name < key; });
+}
+
+void WalletCatalog::upsert(const CatalogEntry& entry) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_upserts_[entry.name] = entry;
+        pending_counts_.erase(entry.name);
+    }
+    DurableWriter::shared().schedule_sync(path_, [this] { persist_pending(); });
+}
+
+bool WalletCatalog::remove(const std::string& name) {
+    return transaction([&] {
+        pending_counts_.erase(name);
+        pending_upserts_.erase(name);
+        auto it = lower_bound(name);
+        if (it == entries_.end() || it->name != name) {
+            return false;
+        }
+        entries_.erase(it);
+        write_file();
+        return true;
+    });
+}
+
+void WalletCatalog::set_address_count(const std::string& name, uint32_t count) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_counts_[name] = count;
+    }
+    DurableWriter::shared().schedule_sync(path_, [this] { persist_pending(); });
+}
+
+void WalletCatalog::persist_pending() {
+    transaction([&] {
+        if (pending_counts_.empty() && pending_upserts_.empty()) {
+            return;
+        }
+        int64_t now = now_seconds();
+        for (const auto& pending : pending_counts_) {
+            auto it = lower_bound(pending.first);
+            if (it != entries_.end() && it->name == pending.first) {
+                it->address_count = pending.second;
+                it->modified_at = now;
+            }
+        }
+        pending_counts_.clear();
+        pending_upserts_.clear();
+        write_file();
+    });
+}
+
+std::vector<CatalogEntry> WalletCatalog::find(const std::string& prefix, size_t offset, size_t limit) {
+    return transaction([&] {
+        std::vector<CatalogEntry> result;
+        for (auto it = lower_bound(prefix);
+             it != entries_.end() && result.size() < limit && it->name.compare(0, prefix.size(), prefix) == 0;
+             ++it) {
+            if (offset > 0) {
+                --offset;
+                continue;
+            }
+            result.push_back(*it);
+            // Counts not yet written out are still the current ones
+            auto pending = pending_counts_.find(it->name);
+            if (pending != pending_counts_.end()) {
+                result.back().address_count = pending->second;
+            }
+        }
+        return result;
+    });
+}
+
+size_t WalletCatalog::count(const std::string& prefix) {
+    return transaction([&] {
+        auto first = lower_bound(prefix);
+        auto last = first;
+        while (last != entries_.end() && last->name.compare(0, prefix.size(), prefix) == 0) {
+            ++last;
+        }
+        return static_cast<size_t>(last - first);
+    });
+}
+
+void WalletCatalog::rebuild() {
+    transaction([&] {
+        entries_ = scan_();
+        std::sort(entries_.begin(), entries_.end(),
+                  [](const CatalogEntry& a, const CatalogEntry& b) { return a.name < b.name; });
+        pending_counts_.clear();
+        pending_upserts_.clear();
+        write_file();
+    });
+}
+
+} // namespace crypto_wallet
@@ -0,0 +1,145 @@
+#include "wallet_crypto.h"
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+namespace crypto_wallet {
+
+static constexpr uint8_t DEFAULT_LOG2_N = 15;
+static constexpr uint8_t DEFAULT_R = 8;
+static constexpr uint8_t DEFAULT_P = 1;
+
+// Highest cost accepted from a file, so a crafted header cannot make
+// unlocking allocate gigabytes
+static constexpr uint8_t MAX_LOG2_N = 20;
+
+KdfParams KdfParams::generate() {
+    KdfParams params;
+    if (RAND_bytes(params.salt.data(), static_cast<int>(params.salt.size())) != 1) {
+        throw WalletError::crypto("Failed to generate salt");
+    }
+    params.log2_n = DEFAULT_LOG2_N;
+    params.r = DEFAULT_R;
+    params.p = DEFAULT_P;
+    return params;
+}
+
+WalletKey derive_wallet_key(const std::string& password, const KdfParams& params) {
+    if (params.log2_n == 0 || params.log2_n > MAX_LOG2_N || params.r == 0 || params.p == 0) {
+        throw WalletError::crypto("Unsupported key derivation parameters");
+    }
+
+    WalletKey key{params, std::make_shared<LockedBuffer>(WALLET_KEY_SIZE)};
+    uint64_t n = uint64_t(1) << params.log2_n;
+    // scrypt needs 128 * r * N bytes, plus headroom
+    uint64_t max_memory = 128 * uint64_t(params.r) * n * (params.p + 1) + (1u << 20);
+    if (EVP_PBE_scrypt(password.data(), password.size(), params.salt.data(), params.salt.size(),
+                       n, params.r, params.p, max_memory, key.key->data(), WALLET_KEY_SIZE) != 1) {
+        throw WalletError::crypto("Key derivation failed");
+    }
+    return key;
+}
+
+// One cipher context per thread, reset for each chunk
+static EVP_CIPHER_CTX* cipher_context() {
+    struct Holder {
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        ~Holder() { EVP_CIPHER_CTX_free(ctx); }
+    };
+    thread_local Holder holder;
+    if (!holder.ctx) {
+        throw WalletError::crypto("Failed to create cipher context");
+    }
+    return holder.ctx;
+}
+
+void aead_seal(const uint8_t* key, const uint8_t* aad, size_t aad_size,
+               const uint8_t* plaintext, size_t size, uint8_t* out) {
+    uint8_t* nonce = out;
+    uint8_t* ciphertext = out + GCM_NONCE_SIZE;
+    uint8_t* tag = ciphertext + size;
+    if (RAND_bytes(nonce, GCM_NONCE_SIZE) != 1) {
+        throw WalletError::crypto("Failed to generate nonce");
+    }
+
+    EVP_CIPHER_CTX* ctx = cipher_context();
+    int length = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, nonce) == 1 &&
+              (aad_size == 0 || EVP_EncryptUpdate(ctx, nullptr, &length, aad, static_cast<int>(aad_size)) == 1) &&
+              (size == 0 || EVP_EncryptUpdate(ctx, ciphertext, &length, plaintext, static_cast<int>(size)) == 1) &&
+              EVP_EncryptFinal_ex(ctx, ciphertext + size, &length) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_SIZE, tag) == 1;
+    if (!ok) {
+        throw WalletError::crypto("Encryption failed");
+    }
+}
+
+bool aead_open(const uint8_t* key, const uint8_t* aad, size_t aad_size,
+               const uint8_t* sealed, size_t sealed_size, uint8_t* plaintext) {
+    if (sealed_size < GCM_OVERHEAD) {
+        return false;
+    }
+    size_t size = sealed_size - GCM_OVERHEAD;
+    const uint8_t* nonce = sealed;
+    const uint8_t* ciphertext = sealed + GCM_NONCE_SIZE;
+    uint8_t tag[GCM_TAG_SIZE];
+    std::memcpy(tag, ciphertext + size, GCM_TAG_SIZE);
+
+    EVP_CIPHER_CTX* ctx = cipher_context();
+    int length = 0;
+    return EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, nonce) == 1 &&
+           (aad_size == 0 || EVP_DecryptUpdate(ctx, nullptr, &length, aad, static_cast<int>(aad_size)) == 1) &&
+           (size == 0 || EVP_DecryptUpdate(ctx, plaintext, &length, ciphertext, static_cast<int>(size)) == 1) &&
+           EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_SIZE, tag) == 1 &&
+           EVP_DecryptFinal_ex(ctx, plaintext + size, &length) == 1;
+}
+
+WalletKeyring::WalletKeyring(std::chrono::seconds idle_timeout) : idle_timeout_(idle_timeout) {}
+
+WalletKeyring& WalletKeyring::shared() {
+    static WalletKeyring keyring;
+    return keyring;
+}
+
+void WalletKeyring::store(const std::string& name, WalletKey key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[name] = Entry{std::make_shared<const WalletKey>(std::move(key)),
+                           std::chrono::steady_clock::now()};
+}
+
+std::shared_ptr<const WalletKey> WalletKeyring::get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - it->second.last_used > idle_timeout_) {
+        entries_.erase(it);
+        return nullptr;
+    }
+    it->second.last_used = now;
+    return it->second.key;
+}
+
+std::shared_ptr<const WalletKey> WalletKeyring::get(const std::string& name, const KdfParams& params) {
+    auto key = get(name);
+    // A key for an older file of the same name does not open this one
+    if (key && (key->params.salt != params.salt || key->params.log2_n != params.log2_n ||
+                key->params.r != params.r || key->params.p != params.p)) {
+        return nullptr;
+    }
+    return key;
+}
+
+void WalletKeyring::lock(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(name);
+}
+
+void WalletKeyring::lock_all() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+} // namespace crypto_wallet
@@ -0,0 +1,587 @@
+#include "wallet_file.h"
+#include "durable_writer.h"
+#include "checksum.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace crypto_wallet {
+
+static constexpr char WALLET_MAGIC[4] = {'C', 'W', 'L', 'T'};
+static constexpr size_t PAGE_SIZE = 4096;
+
+struct WalletFile::Header {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    int64_t created_at;       // Seconds since epoch
+    uint16_t name_size;       // A u32 in version 1; names never reach the high half
+    uint16_t flags;
+    uint32_t seed_size;       // Encrypted: encryption block and sealed phrase
+    uint64_t records_offset;
+    uint64_t records_size;    // Committed bytes of address records
+    uint32_t receive_count;
+    uint32_t change_count;
+    uint32_t records_crc;     // CRC32C of the committed records
+    uint32_t header_crc;      // CRC32C of the header up to here, name and seed
+    // Records known to be on disk as of the last sync(). Not covered by
+    // header_crc, so the header stays valid whichever value was persisted.
+    uint32_t synced_records_size;
+    uint32_t synced_records_crc;
+};
+
+static_assert(sizeof(WalletFile::Header) == 64, "wallet file header must stay 64 bytes");
+
+// Leads the seed section of an encrypted file, before the sealed phrase
+struct EncryptionBlock {
+    uint8_t salt[16];
+    uint8_t log2_n;
+    uint8_t r;
+    uint8_t p;
+    uint8_t reserved[13];
+};
+
+static_assert(sizeof(EncryptionBlock) == 32, "encryption block must stay 32 bytes");
+
+// Precedes each sealed frame of address records
+struct FrameHeader {
+    uint32_t size;            // Plaintext bytes
+    uint16_t receive_count;
+    uint16_t change_count;
+};
+
+// Associated data of a frame: which file, where in it, and its header
+struct FrameAad {
+    uint8_t salt[16];
+    uint64_t offset;          // From the start of the record section
+    FrameHeader header;
+};
+
+static_assert(sizeof(FrameAad) == 32, "frame AAD must have no padding");
+
+static constexpr size_t FRAME_CAPACITY = 64 * 1024;
+static constexpr size_t FRAME_OVERHEAD = sizeof(FrameHeader) + GCM_OVERHEAD;
+
+static size_t round_to_page(size_t size) {
+    return (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+static uint32_t header_checksum(const WalletFile::Header& header, const uint8_t* strings) {
+    uint32_t crc = crc32c(0, reinterpret_cast<const uint8_t*>(&header),
+                          offsetof(WalletFile::Header, header_crc));
+    return crc32c(crc, strings, header.name_size + header.seed_size);
+}
+
+static uint8_t* put_record(uint8_t* out, uint8_t chain, const std::string& address) {
+    out[0] = chain;
+    out[1] = static_cast<uint8_t>(address.size());
+    std::memcpy(out + 2, address.data(), address.size());
+    return out + 2 + address.size();
+}
+
+static void parse_records(const uint8_t* record, const uint8_t* end, Wallet& wallet) {
+    while (record < end) {
+        if (end - record < 2 || end - record < 2 + record[1] || record[0] > WalletFile::CHANGE) {
+            throw WalletError::storage("Wallet file has a malformed address record");
+        }
+        auto& chain = record[0] == WalletFile::RECEIVE ? wallet.addresses : wallet.change_addresses;
+        chain.emplace_back(reinterpret_cast<const char*>(record + 2), record[1]);
+        record += 2 + record[1];
+    }
+}
+
+static FrameAad frame_aad(const EncryptionBlock& block, uint64_t offset, const FrameHeader& header) {
+    FrameAad aad;
+    std::memcpy(aad.salt, block.salt, sizeof(aad.salt));
+    aad.offset = offset;
+    aad.header = header;
+    return aad;
+}
+
+static const EncryptionBlock& encryption_block(const uint8_t* data) {
+    const auto& header = *reinterpret_cast<const WalletFile::Header*>(data);
+    return *reinterpret_cast<const EncryptionBlock*>(data + sizeof(WalletFile::Header) + header.name_size);
+}
+
+static bool same_params(const KdfParams& params, const EncryptionBlock& block) {
+    return std::memcmp(params.salt.data(), block.salt, sizeof(block.salt)) == 0 &&
+           params.log2_n == block.log2_n && params.r == block.r && params.p == block.p;
+}
+
+// The seed is bound to the file's salt and the wallet name
+static std::vector<uint8_t> seed_aad(const EncryptionBlock& block, const char* name, size_t name_size) {
+    std::vector<uint8_t> aad(block.salt, block.salt + sizeof(block.salt));
+    aad.insert(aad.end(), name, name + name_size);
+    return aad;
+}
+
+std::vector<uint8_t> WalletFile::encode(const Wallet& wallet, const WalletKey* key, size_t spare_records) {
+    if (wallet.name.size() > UINT16_MAX) {
+        throw WalletError::storage("Wallet name too long for wallet file");
+    }
+    size_t plain_size = 0;
+    for (const auto* chain : {&wallet.addresses, &wallet.change_addresses}) {
+        for (const auto& address : *chain) {
+            if (address.size() > 255) {
+                throw WalletError::storage("Address too long for wallet file");
+            }
+            plain_size += 2 + address.size();
+        }
+    }
+
+    // Encrypted records are cut into frames at record boundaries
+    struct Frame {
+        size_t begin;
+        FrameHeader header;
+    };
+    std::vector<uint8_t> plain;
+    std::vector<Frame> frames;
+    size_t records_size = plain_size;
+    if (key) {
+        plain.resize(plain_size);
+        uint8_t* out = plain.data();
+        for (Chain chain : {RECEIVE, CHANGE}) {
+            for (const auto& address : chain == RECEIVE ? wallet.addresses : wallet.change_addresses) {
+                size_t offset = static_cast<size_t>(out - plain.data());
+                size_t record_size = 2 + address.size();
+                if (frames.empty() || frames.back().header.size + record_size > FRAME_CAPACITY) {
+                    frames.push_back(Frame{offset, FrameHeader{0, 0, 0}});
+                }
+                out = put_record(out, chain, address);
+                FrameHeader& frame = frames.back().header;
+                frame.size += static_cast<uint32_t>(record_size);
+                ++(chain == RECEIVE ? frame.receive_count : frame.change_count);
+            }
+        }
+        records_size = plain_size + frames.size() * FRAME_OVERHEAD;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, WALLET_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.header_size = sizeof(Header);
+    header.created_at = std::chrono::system_clock::to_time_t(wallet.created_at);
+    header.name_size = static_cast<uint16_t>(wallet.name.size());
+    header.flags = key ? FLAG_ENCRYPTED : 0;
+    header.seed_size = static_cast<uint32_t>(wallet.seed_phrase.size());
+    if (key) {
+        header.seed_size += sizeof(EncryptionBlock) + GCM_OVERHEAD;
+    }
+    header.records_offset = (sizeof(Header) + header.name_size + header.seed_size + 7) / 8 * 8;
+    header.records_size = records_size;
+    header.receive_count = static_cast<uint32_t>(wallet.addresses.size());
+    header.change_count = static_cast<uint32_t>(wallet.change_addresses.size());
+
+    std::vector<uint8_t> buffer(round_to_page(header.records_offset + records_size + spare_records), 0);
+    uint8_t* strings = buffer.data() + sizeof(Header);
+    std::memcpy(strings, wallet.name.data(), header.name_size);
+    uint8_t* records = buffer.data() + header.records_offset;
+
+    if (!key) {
+        std::memcpy(strings + header.name_size, wallet.seed_phrase.data(), header.seed_size);
+        uint8_t* record = records;
+        for (Chain chain : {RECEIVE, CHANGE}) {
+            for (const auto& address : chain == RECEIVE ? wallet.addresses : wallet.change_addresses) {
+                record = put_record(record, chain, address);
+            }
+        }
+    } else {
+        const uint8_t* secret = key->key->data();
+        EncryptionBlock block{};
+        std::memcpy(block.salt, key->params.salt.data(), sizeof(block.salt));
+        block.log2_n = key->params.log2_n;
+        block.r = key->params.r;
+        block.p = key->params.p;
+        std::memcpy(strings + header.name_size, &block, sizeof(block));
+
+        auto aad = seed_aad(block, wallet.name.data(), wallet.name.size());
+        aead_seal(secret, aad.data(), aad.size(),
+                  reinterpret_cast<const uint8_t*>(wallet.seed_phrase.data()), wallet.seed_phrase.size(),
+                  strings + header.name_size + sizeof(block));
+
+        uint64_t offset = 0;
+        for (const auto& frame : frames) {
+            FrameAad frame_data = frame_aad(block, offset, frame.header);
+            std::memcpy(records + offset, &frame.header, sizeof(FrameHeader));
+            aead_seal(secret, reinterpret_cast<const uint8_t*>(&frame_data), sizeof(frame_data),
+                      plain.data() + frame.begin, frame.header.size,
+                      records + offset + sizeof(FrameHeader));
+            offset += FRAME_OVERHEAD + frame.header.size;
+        }
+    }
+
+    header.records_crc = crc32c(0, records, records_size);
+    header.header_crc = header_checksum(header, strings);
+    // Whole files are only written through a synced replace
+    header.synced_records_size = static_cast<uint32_t>(records_size);
+    header.synced_records_crc = header.records_crc;
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+    return buffer;
+}
+
+void WalletFile::write(const std::filesystem::path& path, const Wallet& wallet, const WalletKey* key) {
+    auto buffer = encode(wallet, key);
+    atomic_write_file(path, buffer.data(), buffer.size());
+}
+
+bool WalletFile::is_wallet_file(const std::filesystem::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(WALLET_MAGIC)];
+    bool match = ::read(fd, magic, sizeof(magic)) == static_cast<ssize_t>(sizeof(magic)) &&
+                 std::memcmp(magic, WALLET_MAGIC, sizeof(magic)) == 0;
+    ::close(fd);
+    return match;
+}
+
+WalletFile WalletFile::open(const std::filesystem::path& path, Mode mode) {
+    // Readers open the file read-only so they raise no write events for
+    // directory watchers
+    int fd = ::open(path.c_str(), (mode == APPEND ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (fd < 0) {
+        throw WalletError::storage("Failed to open wallet file for reading");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw WalletError::storage("Wallet file is truncated");
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         mode == APPEND ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        throw WalletError::storage("Failed to map wallet file");
+    }
+    WalletFile file(fd, static_cast<uint8_t*>(mapping), size);
+
+    const Header& header = file.header();
+    if (std::memcmp(header.magic, WALLET_MAGIC, sizeof(WALLET_MAGIC)) != 0) {
+        throw WalletError::storage("Not a wallet file");
+    }
+    // Version 1 differs only in having no flags
+    if (header.version < 1 || header.version > VERSION || header.header_size != sizeof(Header) ||
+        (header.flags != 0 && (header.version < 2 || header.flags != FLAG_ENCRYPTED))) {
+        throw WalletError::storage("Unsupported wallet file version " + std::to_string(header.version));
+    }
+    uint64_t strings_end = sizeof(Header) + uint64_t(header.name_size) + header.seed_size;
+    if ((header.flags & FLAG_ENCRYPTED) && header.seed_size < sizeof(EncryptionBlock) + GCM_OVERHEAD) {
+        throw WalletError::storage("Wallet file is truncated");
+    }
+    if (strings_end > header.records_offset || header.records_offset > size ||
+        header.records_size > size - header.records_offset) {
+        throw WalletError::storage("Wallet file is truncated");
+    }
+    if (header_checksum(header, file.data_ + sizeof(Header)) != header.header_crc) {
+        throw WalletError::storage("Wallet file header checksum mismatch");
+    }
+    if (crc32c(0, file.data_ + header.records_offset, header.records_size) != header.records_crc) {
+        // Appends after the last sync may not have reached the disk before
+        // the header did; fall back to what the last sync made durable. A
+        // reader repairs only its private copy; an appender repairs the file
+        // before chaining new records onto it.
+        const uint8_t* records = file.data_ + header.records_offset;
+        if (header.synced_records_size > header.records_size ||
+            crc32c(0, records, header.synced_records_size) != header.synced_records_crc) {
+            throw WalletError::storage("Wallet file address checksum mismatch");
+        }
+        file.truncate_records(header.synced_records_size, header.synced_records_crc);
+    }
+
+    return file;
+}
+
+WalletFile::WalletFile(int fd, uint8_t* data, size_t size) : fd_(fd), data_(data), size_(size) {}
+
+WalletFile::WalletFile(WalletFile&& other) noexcept
+    : fd_(other.fd_), data_(other.data_), size_(other.size_) {
+    other.fd_ = -1;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+WalletFile& WalletFile::operator=(WalletFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(fd_, other.fd_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+    return *this;
+}
+
+WalletFile::~WalletFile() {
+    close();
+}
+
+void WalletFile::close() {
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+WalletFile::Header& WalletFile::header() const {
+    return *reinterpret_cast<Header*>(data_);
+}
+
+void WalletFile::seal_header() {
+    Header& h = header();
+    h.header_crc = header_checksum(h, data_ + sizeof(Header));
+}
+
+void WalletFile::truncate_records(uint64_t size, uint32_t crc) {
+    Header& h = header();
+    h.records_size = size;
+    h.records_crc = crc;
+    h.receive_count = 0;
+    h.change_count = 0;
+
+    const uint8_t* record = data_ + h.records_offset;
+    const uint8_t* end = record + size;
+    if (encrypted()) {
+        FrameHeader frame;
+        while (static_cast<size_t>(end - record) >= sizeof(frame)) {
+            std::memcpy(&frame, record, sizeof(frame));
+            if (static_cast<size_t>(end - record) < FRAME_OVERHEAD + frame.size) {
+                break;
+            }
+            h.receive_count += frame.receive_count;
+            h.change_count += frame.change_count;
+            record += FRAME_OVERHEAD + frame.size;
+        }
+    } else {
+        while (end - record >= 2 && end - record >= 2 + record[1]) {
+            ++(record[0] == RECEIVE ? h.receive_count : h.change_count);
+            record += 2 + record[1];
+        }
+    }
+    seal_header();
+}
+
+void WalletFile::sync() {
+    Header& h = header();
+    uint64_t size = h.records_size;
+    uint32_t crc = h.records_crc;
+    if (msync(data_, size_, MS_SYNC) != 0) {
+        throw WalletError::storage("Failed to sync wallet file: " + std::string(std::strerror(errno)));
+    }
+
+    // Persisted by the next sync; until then the previous checkpoint holds
+    h.synced_records_size = static_cast<uint32_t>(size);
+    h.synced_records_crc = crc;
+
+    // Writes through the mapping raise no inotify events; touching the
+    // times lets watchers see the change
+    futimens(fd_, nullptr);
+}
+
+template <typename Visit>
+void WalletFile::visit_records(const WalletKey* key, Visit visit) const {
+    const Header& h = header();
+    const uint8_t* record = data_ + h.records_offset;
+    const uint8_t* end = record + h.records_size;
+    if (!encrypted()) {
+        visit(record, end);
+        return;
+    }
+    if (!key) {
+        throw WalletError::wallet_locked(name());
+    }
+
+    // One frame in memory at a time
+    const EncryptionBlock& block = encryption_block(data_);
+    std::vector<uint8_t> plain;
+    while (record < end) {
+        FrameHeader frame;
+        if (static_cast<size_t>(end - record) < sizeof(frame)) {
+            throw WalletError::storage("Wallet file has a malformed address frame");
+        }
+        std::memcpy(&frame, record, sizeof(frame));
+        if (frame.size > FRAME_CAPACITY || static_cast<size_t>(end - record) < FRAME_OVERHEAD + frame.size) {
+            throw WalletError::storage("Wallet file has a malformed address frame");
+        }
+        FrameAad aad = frame_aad(block, static_cast<uint64_t>(record - (data_ + h.records_offset)), frame);
+        plain.resize(frame.size);
+        if (!aead_open(key->key->data(), reinterpret_cast<const uint8_t*>(&aad), sizeof(aad),
+                       record + sizeof(frame), frame.size + GCM_OVERHEAD, plain.data())) {
+            throw WalletError::crypto("Wallet file failed authentication");
+        }
+        if (!visit(plain.data(), plain.data() + plain.size())) {
+            return;
+        }
+        record += FRAME_OVERHEAD + frame.size;
+    }
+}
+
+Wallet WalletFile::to_wallet(const WalletKey* key) const {
+    const Header& h = header();
+    const char* strings = reinterpret_cast<const char*>(data_ + sizeof(Header));
+
+    Wallet wallet;
+    wallet.name.assign(strings, h.name_size);
+    wallet.created_at = std::chrono::system_clock::from_time_t(h.created_at);
+    wallet.addresses.reserve(h.receive_count);
+    wallet.change_addresses.reserve(h.change_count);
+
+    if (!encrypted()) {
+        wallet.seed_phrase.assign(strings + h.name_size, h.seed_size);
+    } else {
+        if (!key) {
+            throw WalletError::wallet_locked(wallet.name);
+        }
+        if (!open_seed(*key, wallet.seed_phrase)) {
+            throw WalletError::crypto("Wallet file failed authentication");
+        }
+        wallet.encrypted = true;
+    }
+    visit_records(key, [&wallet](const uint8_t* record, const uint8_t* end) {
+        parse_records(record, end, wallet);
+        return true;
+    });
+
+    if (wallet.addresses.size() != h.receive_count || wallet.change_addresses.size() != h.change_count) {
+        throw WalletError::storage("Wallet file address count mismatch");
+    }
+    return wallet;
+}
+
+bool WalletFile::contains_address(const std::string& address, const WalletKey* key) const {
+    bool found = false;
+    visit_records(key, [&](const uint8_t* record, const uint8_t* end) {
+        while (record < end) {
+            if (end - record < 2 || end - record < 2 + record[1] || record[0] > CHANGE) {
+                throw WalletError::storage("Wallet file has a malformed address record");
+            }
+            if (record[1] == address.size() && std::memcmp(record + 2, address.data(), address.size()) == 0) {
+                found = true;
+                return false;
+            }
+            record += 2 + record[1];
+        }
+        return true;
+    });
+    return found;
+}
+
+bool WalletFile::open_seed(const WalletKey& key, std::string& seed_phrase) const {
+    const Header& h = header();
+    const char* name = reinterpret_cast<const char*>(data_ + sizeof(Header));
+    const EncryptionBlock& block = encryption_block(data_);
+    if (!same_params(key.params, block)) {
+        return false;
+    }
+
+    const uint8_t* sealed = reinterpret_cast<const uint8_t*>(&block) + sizeof(block);
+    size_t sealed_size = h.seed_size - sizeof(block);
+    auto aad = seed_aad(block, name, h.name_size);
+    seed_phrase.assign(sealed_size - GCM_OVERHEAD, '\0');
+    return aead_open(key.key->data(), aad.data(), aad.size(), sealed, sealed_size,
+                     reinterpret_cast<uint8_t*>(&seed_phrase[0]));
+}
+
+bool WalletFile::opens_with(const WalletKey& key) const {
+    std::string seed_phrase;
+    return encrypted() && open_seed(key, seed_phrase);
+}
+
+void WalletFile::reserve_records(size_t extra) {
+    size_t needed = header().records_offset + header().records_size + extra;
+    if (needed <= size_) {
+        return;
+    }
+    // Grow geometrically so a long run of appends remaps rarely
+    size_t new_size = round_to_page(std::max(needed, size_ * 2));
+    if (ftruncate(fd_, static_cast<off_t>(new_size)) != 0) {
+        throw WalletError::storage("Failed to grow wallet file");
+    }
+    void* mapping = mremap(data_, size_, new_size, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED) {
+        throw WalletError::storage("Failed to remap wallet file");
+    }
+    data_ = static_cast<uint8_t*>(mapping);
+    size_ = new_size;
+}
+
+void WalletFile::append_address(Chain chain, const std::string& address, const WalletKey* key) {
+    if (address.size() > 255) {
+        throw WalletError::storage("Address too long for wallet file");
+    }
+    bool sealed = encrypted();
+    if (sealed && (!key || !same_params(key->params, encryption_block(data_)))) {
+        throw WalletError::wallet_locked(name());
+    }
+
+    size_t record_size = 2 + address.size();
+    size_t entry_size = sealed ? FRAME_OVERHEAD + record_size : record_size;
+    reserve_records(entry_size);
+
+    // Record first, then the header that commits it
+    Header& h = header();
+    uint8_t* entry = data_ + h.records_offset + h.records_size;
+    if (!sealed) {
+        put_record(entry, chain, address);
+    } else {
+        // A frame of its own; the next full save repacks small frames
+        uint8_t record[2 + 255];
+        put_record(record, chain, address);
+        FrameHeader frame{static_cast<uint32_t>(record_size), uint16_t(chain == RECEIVE), uint16_t(chain == CHANGE)};
+        FrameAad aad = frame_aad(encryption_block(data_), h.records_size, frame);
+        std::memcpy(entry, &frame, sizeof(frame));
+        aead_seal(key->key->data(), reinterpret_cast<const uint8_t*>(&aad), sizeof(aad),
+                  record, record_size, entry + sizeof(frame));
+    }
+
+    h.records_crc = crc32c(h.records_crc, entry, entry_size);
+    h.records_size += entry_size;
+    if (chain == RECEIVE) {
+        ++h.receive_count;
+    } else {
+        ++h.change_count;
+    }
+    seal_header();
+}
+
+size_t WalletFile::address_count(Chain chain) const {
+    return chain == RECEIVE ? header().receive_count : header().change_count;
+}
+
+std::string WalletFile::name() const {
+    return std::string(reinterpret_cast<const char*>(data_ + sizeof(Header)), header().name_size);
+}
+
+std::chrono::system_clock::time_point WalletFile::created_at() const {
+    return std::chrono::system_clock::from_time_t(header().created_at);
+}
+
+bool WalletFile::encrypted() const {
+    return (header().flags & FLAG_ENCRYPTED) != 0;
+}
+
+KdfParams WalletFile::kdf_params() const {
+    if (!encrypted()) {
+        throw WalletError::storage("Wallet file is not encrypted");
+    }
+    const EncryptionBlock& block = encryption_block(data_);
+    KdfParams params;
+    std::memcpy(params.salt.data(), block.salt, params.salt.size());
+    params.log2_n = block.log2_n;
+    params.r = block.r;
+    params.p = block.p;
+    return params;
+}
+
+} // namespace crypto_wallet
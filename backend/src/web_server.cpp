@@ -1,5 +1,9 @@
 #include "web_server.h"
 #include "wallet.h"
+#include "wallet_cache.h"
+#include "storage.h"
+#include "response_cache.h"
+#include "utxo_index.h"
 #include "trading.h"
 #include "error.h"
 #include <iostream>
@@ -8,16 +12,29 @@
 #include <chrono>
 #include <nlohmann/json.hpp>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
 #include <libpq-fe.h>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <cctype>
 
 namespace crypto_wallet {
 
-WebServer::WebServer() : port_(8080), running_(false), trading_engine_(std::make_unique<TradingEngine>()) {}
+WebServer::WebServer()
+    : port_(8080), running_(false), active_connections_(0),
+      trading_engine_(std::make_unique<TradingEngine>()) {}
+
+// Each connection holds a thread, so idle and slow clients are bounded
+static constexpr int MAX_CONNECTIONS = 256;
+static constexpr int IDLE_TIMEOUT_MS = 15000;     // Between keep-alive requests
+static constexpr int REQUEST_TIMEOUT_MS = 30000;  // From first byte to full request
+static constexpr int SEND_TIMEOUT_SECONDS = 30;
 
 WebServer::~WebServer() {
     stop();
@@ -29,6 +46,11 @@ void WebServer::start() {
     }
     
     running_ = true;
+    
+    // Wallets edited by the CLI while the server runs must not be served stale
+    if (!WalletCache::shared().watch(WalletStorage::get_wallet_dir())) {
+        std::cerr << "Warning: wallet directory watch unavailable, cached wallets only refresh on local writes" << std::endl;
+    }
     server_thread_ = std::make_unique<std::thread>(&WebServer::run_server, this);
     
     std::cout << "🌐 Web server started on port " << port_ << std::endl;
@@ -43,6 +65,7 @@ void WebServer::stop() {
     if (server_thread_ && server_thread_->joinable()) {
         server_thread_->join();
     }
+    WalletCache::shared().stop_watching();
 }
 
 void WebServer::run_server() {
@@ -74,7 +97,7 @@ void WebServer::run_server() {
     }
     
     // Listen for connections
-    if (listen(server_fd, 3) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         std::cerr << "Listen failed" << std::endl;
         return;
     }
@@ -84,7 +107,7 @@ void WebServer::run_server() {
     std::cout << "  GET /balance/{wallet_name}?network={network}" << std::endl;
     std::cout << "  POST /send" << std::endl;
     std::cout << "  GET /addresses/{wallet_name}" << std::endl;
-    std::cout << "  GET /transactions/{wallet_name}" << std::endl;
+    std::cout << "  GET /transactions/{wallet_name}?network={network}" << std::endl;
     std::cout << "  POST /trading/orders" << std::endl;
     std::cout << "  DELETE /trading/orders/{order_id}" << std::endl;
     std::cout << "  GET /trading/orders/{wallet_name}" << std::endl;
@@ -102,7 +125,21 @@ void WebServer::run_server() {
             continue;
         }
         
+        if (active_connections_.load() >= MAX_CONNECTIONS) {
+            static const std::string busy =
+                "HTTP/1.1 503 Service Unavailable\r\nContent-Type: application/json\r\n"
+                "Content-Length: 30\r\nConnection: close\r\n\r\n{\"error\":\"Too many connections\"}";
+            send(new_socket, busy.c_str(), busy.length(), MSG_DONTWAIT | MSG_NOSIGNAL);
+            close(new_socket);
+            continue;
+        }
+        
+        // A client that stops reading must not block its thread in send()
+        struct timeval send_timeout = {SEND_TIMEOUT_SECONDS, 0};
+        setsockopt(new_socket, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+        
         // Handle request in a separate thread
+        ++active_connections_;
         std::thread client_thread(&WebServer::handle_client, this, new_socket);
         client_thread.detach();
     }
@@ -110,12 +147,118 @@ void WebServer::run_server() {
     close(server_fd);
 }
 
+static constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+static constexpr size_t MAX_BODY_BYTES = 1024 * 1024;
+
+// Content-Length from a header block, 0 if absent
+static bool parse_content_length(const std::string& headers, size_t& length) {
+    length = 0;
+    std::string lower = headers;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    size_t pos = lower.find("\r\ncontent-length:");
+    if (pos == std::string::npos) {
+        return true;
+    }
+    pos += 17;
+    while (pos < lower.size() && (lower[pos] == ' ' || lower[pos] == '\t')) {
+        ++pos;
+    }
+    size_t digits = 0;
+    while (pos < lower.size() && std::isdigit(static_cast<unsigned char>(lower[pos]))) {
+        if (length > MAX_BODY_BYTES) {
+            return false;
+        }
+        length = length * 10 + static_cast<size_t>(lower[pos++] - '0');
+        ++digits;
+    }
+    return digits > 0 && length <= MAX_BODY_BYTES;
+}
+
+// Appends the next chunk from the socket, waiting at most until deadline
+static bool read_some(int client_socket, std::string& pending,
+                      std::chrono::steady_clock::time_point deadline) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    if (remaining <= 0) {
+        return false;
+    }
+    struct pollfd pfd = {client_socket, POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(remaining)) <= 0) {
+        return false;
+    }
+    char buffer[4096];
+    ssize_t valread = read(client_socket, buffer, sizeof(buffer));
+    if (valread <= 0) {
+        return false;
+    }
+    pending.append(buffer, static_cast<size_t>(valread));
+    return true;
+}
+
+bool WebServer::read_request(int client_socket, std::string& pending, std::string& request) {
+    // An idle keep-alive connection is dropped; once a request starts, it has
+    // a fixed budget so a client trickling bytes cannot hold the thread
+    auto started = std::chrono::steady_clock::now();
+    if (pending.empty() &&
+        !read_some(client_socket, pending, started + std::chrono::milliseconds(IDLE_TIMEOUT_MS))) {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(REQUEST_TIMEOUT_MS);
+
+    size_t header_end;
+    while ((header_end = pending.find("\r\n\r\n")) == std::string::npos) {
+        if (pending.size() > MAX_HEADER_BYTES) {
+            return false;
+        }
+        if (!read_some(client_socket, pending, deadline)) {
+            return false;
+        }
+    }
+
+    size_t content_length;
+    if (!parse_content_length(pending.substr(0, header_end + 2), content_length)) {
+        return false;
+    }
+    size_t total = header_end + 4 + content_length;
+    while (pending.size() < total) {
+        if (!read_some(client_socket, pending, deadline)) {
+            return false;
+        }
+    }
+
+    request = pending.substr(0, total);
+    pending.erase(0, total);
+    return true;
+}
+
+// Strips "?network=..." off a path tail, returning the network (mainnet
+// when absent)
+static std::string take_network_query(std::string& target) {
+    std::string network = "mainnet";
+    size_t query_pos = target.find('?');
+    if (query_pos != std::string::npos) {
+        size_t network_pos = target.find("network=", query_pos);
+        if (network_pos != std::string::npos) {
+            network = target.substr(network_pos + 8);
+        }
+        target = target.substr(0, query_pos);
+    }
+    return network;
+}
+
 void WebServer::handle_client(int client_socket) {
-    char buffer[4096] = {0};
-    int valread = read(client_socket, buffer, 4096);
+    // Bytes read past the current request, e.g. a pipelined next request
+    std::string pending;
+    std::string request;
     
-    if (valread > 0) {
-        std::string request(buffer);
+    // Serve requests until the client closes the connection or opts out of
+    // HTTP/1.1 keep-alive
+    while (running_) {
+        if (!read_request(client_socket, pending, request)) {
+            break;
+        }
+        
         std::string response;
         
         // Parse HTTP request
@@ -125,28 +268,28 @@ void WebServer::handle_client(int client_socket) {
         
         // Simple routing
         if (path == "/health") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n{\"status\":\"ok\"}";
+            response = create_json_response("{\"status\":\"ok\"}");
         } else if (path == "/trading/pairs") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_get_trading_pairs();
+            response = handle_get_trading_pairs();
         } else if (path.find("/trading/market/") == 0) {
             std::string symbol = path.substr(16); // Remove "/trading/market/"
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_get_market_data(symbol);
+            response = handle_get_market_data(symbol);
         } else if (path == "/auth/login" && method == "POST") {
             // Extract request body from the HTTP request
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_auth_login(body);
+            response = handle_auth_login(body);
         } else if (path == "/auth/register" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_auth_register(body);
+            response = handle_auth_register(body);
         } else if (path == "/auth/forgot-password" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_auth_forgot_password(body);
+            response = handle_auth_forgot_password(body);
         } else if (path == "/auth/reset-password" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_auth_reset_password(body);
+            response = handle_auth_reset_password(body);
         } else if (path == "/auth/change-password" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_auth_change_password(body);
+            response = handle_auth_change_password(body);
         } else if (path.find("/auth/verify-email") == 0 && method == "GET") {
             // Extract token from query string
             size_t token_pos = path.find("token=");
@@ -154,52 +297,99 @@ void WebServer::handle_client(int client_socket) {
             if (token_pos != std::string::npos) {
                 token = path.substr(token_pos + 6);
             }
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_auth_verify_email(token);
+            response = handle_auth_verify_email(token);
         } else if (path == "/admin/users" && method == "GET") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_get_users();
+            response = handle_admin_get_users();
         } else if (path == "/admin/users" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_create_user(body);
+            response = handle_admin_create_user(body);
         } else if (path.find("/admin/users/") == 0 && method == "PUT") {
             std::string user_id = path.substr(13); // Remove "/admin/users/"
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_update_user(user_id, body);
+            response = handle_admin_update_user(user_id, body);
         } else if (path.find("/admin/users/") == 0 && method == "DELETE") {
             std::string user_id = path.substr(13); // Remove "/admin/users/"
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_delete_user(user_id);
+            response = handle_admin_delete_user(user_id);
         } else if (path == "/admin/settings" && method == "GET") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_get_settings();
+            response = handle_admin_get_settings();
         } else if (path == "/admin/settings" && method == "PUT") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_update_settings(body);
+            response = handle_admin_update_settings(body);
         } else if (path == "/admin/compliance" && method == "GET") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_get_compliance();
+            response = handle_admin_get_compliance();
         } else if (path == "/admin/compliance" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_create_compliance_rule(body);
+            response = handle_admin_create_compliance_rule(body);
         } else if (path == "/admin/incidents" && method == "GET") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_get_incidents();
+            response = handle_admin_get_incidents();
         } else if (path == "/admin/incidents" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_create_incident(body);
+            response = handle_admin_create_incident(body);
         } else if (path.find("/admin/incidents/") == 0 && method == "PUT") {
             std::string incident_id = path.substr(17); // Remove "/admin/incidents/"
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_resolve_incident(incident_id, body);
+            response = handle_admin_resolve_incident(incident_id, body);
         } else if (path == "/admin/audit" && method == "GET") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_get_audit_logs();
+            response = handle_admin_get_audit_logs();
         } else if (path == "/admin/system/status" && method == "GET") {
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_get_system_status();
+            response = handle_admin_get_system_status();
         } else if (path == "/admin/system/maintenance" && method == "POST") {
             std::string body = extract_request_body(request);
-            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + handle_admin_toggle_maintenance(body);
+            response = handle_admin_toggle_maintenance(body);
+        } else if (path.find("/balance/") == 0 && method == "GET") {
+            std::string wallet_name = path.substr(9); // Remove "/balance/"
+            std::string network = take_network_query(wallet_name);
+            response = handle_get_balance(wallet_name, network);
+        } else if (path.find("/addresses/") == 0 && method == "GET") {
+            std::string wallet_name = path.substr(11); // Remove "/addresses/"
+            response = handle_get_addresses(wallet_name);
+        } else if (path == "/wallets/cache-stats" && method == "GET") {
+            response = handle_get_wallet_cache_stats();
+        } else if (path == "/network/cache-stats" && method == "GET") {
+            response = handle_get_network_cache_stats();
+        } else if (path == "/network/upstreams" && method == "GET") {
+            response = handle_get_network_upstreams();
+        } else if (path == "/send" && method == "POST") {
+            std::string body = extract_request_body(request);
+            response = handle_send_transaction(body);
+        } else if (path == "/wallets/unlock" && method == "POST") {
+            std::string body = extract_request_body(request);
+            response = handle_unlock_wallet(body);
+        } else if (path == "/wallets/lock" && method == "POST") {
+            std::string body = extract_request_body(request);
+            response = handle_lock_wallet(body);
+        } else if (path.find("/transactions/") == 0 && method == "GET") {
+            std::string wallet_name = path.substr(14); // Remove "/transactions/"
+            std::string network = take_network_query(wallet_name);
+            response = handle_get_transaction_history(wallet_name, network);
+        } else if (path == "/trading/orders" && method == "POST") {
+            std::string body = extract_request_body(request);
+            response = handle_place_order(body);
+        } else if (path.find("/trading/orders/") == 0 && method == "DELETE") {
+            std::string order_id = path.substr(16); // Remove "/trading/orders/"
+            response = handle_cancel_order(order_id);
+        } else if (path.find("/trading/orders/") == 0 && method == "GET") {
+            std::string wallet_name = path.substr(16); // Remove "/trading/orders/"
+            response = handle_get_orders(wallet_name);
+        } else if (path.find("/trading/orderbook/") == 0) {
+            std::string pair = path.substr(19); // Remove "/trading/orderbook/"
+            response = handle_get_order_book(pair);
         } else {
-            response = "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\n\r\n{\"error\":\"Not Found\"}";
+            response = "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\nContent-Length: 21\r\n\r\n{\"error\":\"Not Found\"}";
+        }
+        
+        if (send(client_socket, response.c_str(), response.length(), MSG_NOSIGNAL) < 0) {
+            break;
         }
         
-        send(client_socket, response.c_str(), response.length(), 0);
+        if (version != "HTTP/1.1" ||
+            request.find("Connection: close") != std::string::npos ||
+            request.find("connection: close") != std::string::npos) {
+            break;
+        }
     }
     close(client_socket);
+    --active_connections_;
 }
 
 std::string WebServer::extract_request_body(const std::string& request) {
@@ -1224,8 +1414,8 @@ std::string WebServer::handle_admin_toggle_maintenance(const std::string& reques
 
 std::string WebServer::handle_get_balance(const std::string& wallet_name, const std::string& network) {
     try {
-        auto wallet = Wallet::load(wallet_name);
-        auto balance = wallet.get_balance(network);
+        auto wallet = WalletCache::shared().get(wallet_name);
+        auto balance = wallet->get_balance(network);
         
         nlohmann::json response;
         response["balance"] = balance;
@@ -1238,20 +1428,43 @@ std::string WebServer::handle_get_balance(const std::string& wallet_name, const
     }
 }
 
-std::string WebServer::handle_send_transaction(
-    const std::string& wallet_name, 
-    const std::string& to_address, 
-    double amount
-) {
+std::string WebServer::handle_send_transaction(const std::string& request_body) {
     try {
-        auto wallet = Wallet::load(wallet_name);
-        auto tx_hash = wallet.send_transaction(to_address, amount, "mainnet");
+        auto request = nlohmann::json::parse(request_body);
+        std::string wallet_name = request["wallet"];
+        std::string network = request.value("network", "mainnet");
+        uint32_t confirmation_target = request.value("confirmation_target", Wallet::DEFAULT_CONFIRMATION_TARGET);
+        
+        // Either one "to"/"amount" pair or a "payouts" list paid by a
+        // single transaction; amounts are BTC
+        std::vector<Payout> payouts;
+        auto add_payout = [&payouts](const nlohmann::json& entry, const char* address_key) {
+            double amount = entry.at("amount").get<double>();
+            if (!(amount > 0)) {
+                throw WalletError::invalid_amount(std::to_string(amount));
+            }
+            payouts.push_back(Payout{entry.at(address_key).get<std::string>(),
+                                     static_cast<uint64_t>(std::llround(amount * 100000000.0))});
+        };
+        if (request.contains("payouts")) {
+            for (const auto& entry : request["payouts"]) {
+                add_payout(entry, "address");
+            }
+        } else {
+            add_payout(request, "to");
+        }
+        
+        auto wallet = WalletCache::shared().get(wallet_name);
+        auto tx_hash = wallet->send_payouts(payouts, network, confirmation_target);
         
         nlohmann::json response;
         response["tx_hash"] = tx_hash;
+        response["payouts"] = payouts.size();
         response["status"] = "success";
         
         return create_json_response(response.dump());
+    } catch (const nlohmann::json::exception& e) {
+        return create_error_response("Invalid request: " + std::string(e.what()));
     } catch (const WalletError& e) {
         return create_error_response(e.what());
     }
@@ -1259,8 +1472,8 @@ std::string WebServer::handle_send_transaction(
 
 std::string WebServer::handle_get_addresses(const std::string& wallet_name) {
     try {
-        auto wallet = Wallet::load(wallet_name);
-        auto addresses = wallet.get_addresses();
+        auto wallet = WalletCache::shared().get(wallet_name);
+        const auto& addresses = wallet->get_addresses();
         
         nlohmann::json response;
         response["addresses"] = addresses;
@@ -1272,30 +1485,142 @@ std::string WebServer::handle_get_addresses(const std::string& wallet_name) {
     }
 }
 
-std::string WebServer::handle_get_transaction_history(const std::string& wallet_name) {
+std::string WebServer::handle_get_transaction_history(const std::string& wallet_name, const std::string& network) {
     try {
-        auto wallet = Wallet::load(wallet_name);
-        auto addresses = wallet.get_addresses();
+        if (!Wallet::supports_network(network)) {
+            return create_error_response("Network '" + network + "' is not supported");
+        }
+        auto wallet = WalletCache::shared().get(wallet_name);
+        // Change addresses too, as the balance counts them
+        auto addresses = wallet->all_addresses();
+        
+        // Fetches only what is newer than the local index holds
+        auto client = NetworkClient::create(network);
+        auto& index = UtxoIndex::for_network(network);
+        index.sync(*client, addresses);
         
-        // Get transaction history for all addresses
         std::vector<nlohmann::json> all_transactions;
         for (const auto& address : addresses) {
-            // In a real implementation, you'd get actual transaction history
             nlohmann::json tx;
             tx["address"] = address;
             tx["transactions"] = nlohmann::json::array();
+            for (const auto& entry : index.transactions(address)) {
+                nlohmann::json item;
+                item["txid"] = entry.txid;
+                item["amount"] = entry.amount / 100000000.0;
+                item["confirmed"] = entry.block_height != 0;
+                item["block_height"] = entry.block_height;
+                item["block_time"] = entry.block_time;
+                tx["transactions"].push_back(item);
+            }
             all_transactions.push_back(tx);
         }
         
         nlohmann::json response;
         response["transactions"] = all_transactions;
+        response["network"] = network;
         
         return create_json_response(response.dump());
-    } catch (const WalletError& e) {
+    } catch (const std::exception& e) {
         return create_error_response(e.what());
     }
 }
 
+std::string WebServer::handle_get_wallet_cache_stats() {
+    auto stats = WalletCache::shared().stats();
+    
+    nlohmann::json response;
+    response["size"] = stats.size;
+    response["capacity"] = stats.capacity;
+    response["hits"] = stats.hits;
+    response["misses"] = stats.misses;
+    response["hit_rate"] = stats.hit_rate();
+    response["evictions"] = stats.evictions;
+    response["invalidations"] = stats.invalidations;
+    
+    return create_json_response(response.dump());
+}
+
+std::string WebServer::handle_get_network_cache_stats() {
+    auto cache = ResponseCache::shared().stats();
+    auto http = HttpClient::shared().stats();
+    
+    nlohmann::json response;
+    response["size"] = cache.size;
+    response["hits"] = cache.hits;
+    response["stale_hits"] = cache.stale_hits;
+    response["misses"] = cache.misses;
+    response["coalesced"] = cache.coalesced;
+    response["refreshes"] = cache.refreshes;
+    response["errors"] = cache.errors;
+    response["hit_rate"] = cache.hit_rate();
+    response["upstream_requests"] = http.requests;
+    response["connections_opened"] = http.connections_opened;
+    
+    return create_json_response(response.dump());
+}
+
+std::string WebServer::handle_get_network_upstreams() {
+    static const char* const STATE_NAMES[] = {"closed", "open", "half_open"};
+    auto http = HttpClient::shared().stats();
+    
+    nlohmann::json upstreams = nlohmann::json::array();
+    for (const auto& upstream : HttpClient::shared().upstream_stats()) {
+        nlohmann::json entry;
+        entry["base_url"] = upstream.base_url;
+        entry["state"] = STATE_NAMES[static_cast<int>(upstream.state)];
+        entry["p95_ms"] = upstream.p95_ms;
+        entry["attempts"] = upstream.attempts;
+        entry["failures"] = upstream.failures;
+        upstreams.push_back(entry);
+    }
+    
+    nlohmann::json response;
+    response["upstreams"] = upstreams;
+    response["hedges"] = http.hedges;
+    response["hedge_wins"] = http.hedge_wins;
+    response["failovers"] = http.failovers;
+    response["rejected"] = http.rejected;
+    
+    return create_json_response(response.dump());
+}
+
+std::string WebServer::handle_unlock_wallet(const std::string& request_body) {
+    try {
+        auto request = nlohmann::json::parse(request_body);
+        std::string wallet_name = request["wallet"];
+        std::string password = request["password"];
+        
+        // Runs the key derivation once; later requests use the cached key
+        WalletStorage::unlock(wallet_name, password);
+        
+        nlohmann::json response;
+        response["wallet"] = wallet_name;
+        response["status"] = "unlocked";
+        
+        return create_json_response(response.dump());
+    } catch (const std::exception& e) {
+        return create_error_response("Unlock failed: " + std::string(e.what()));
+    }
+}
+
+std::string WebServer::handle_lock_wallet(const std::string& request_body) {
+    try {
+        auto request = nlohmann::json::parse(request_body);
+        std::string wallet_name = request["wallet"];
+        
+        WalletStorage::lock(wallet_name);
+        
+        nlohmann::json response;
+        response["wallet"] = wallet_name;
+        response["status"] = "locked";
+        
+        return create_json_response(response.dump());
+    } catch (const std::exception& e) {
+        return create_error_response("Lock failed: " + std::string(e.what()));
+    }
+}
+
 std::string WebServer::create_json_response(const std::string& data) {
     std::stringstream response;
     response << "HTTP/1.1 200 OK\r\n";
@@ -1344,10 +1669,16 @@ std::string WebServer::handle_place_order(const std::string& request_body) {
         order.price = json.value("price", 0.0);
         
         std::string order_id = trading_engine_->place_order(order);
+        auto placed = trading_engine_->get_order(order_id);
         
         nlohmann::json response;
         response["order_id"] = order_id;
-        response["status"] = "success";
+        if (placed.status == OrderStatus::REJECTED) {
+            response["status"] = "rejected";
+            response["error_message"] = placed.error_message;
+        } else {
+            response["status"] = "success";
+        }
         
         return create_json_response(response.dump());
     } catch (const std::exception& e) {
@@ -1401,6 +1732,9 @@ std::string WebServer::handle_get_orders(const std::string& wallet_name) {
                 order.created_at.time_since_epoch()).count();
             order_json["updated_at"] = std::chrono::duration_cast<std::chrono::seconds>(
                 order.updated_at.time_since_epoch()).count();
+            if (!order.error_message.empty()) {
+                order_json["error_message"] = order.error_message;
+            }
             
             orders_json.push_back(order_json);
         }
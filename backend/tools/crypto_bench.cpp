@@ -0,0 +1,225 @@
+// crypto_bench - signature verification and hashing throughput
+//
+// verify mode signs a set of random digests, then times verifying them one
+// by one through Crypto::verify_hash / Crypto::schnorr_verify against a
+// single Crypto::verify_batch call, and checks that both agree (including
+// on a few deliberately corrupted signatures).
+//
+// sha256 mode times Crypto::sha256 in a loop against every
+// Crypto::sha256_many kernel the CPU supports (and AUTO's pick) on
+// same-sized messages.
+
+#include "crypto.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace crypto_wallet;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string mode = "verify";   // verify | sha256
+    size_t count = 1000;
+    int iterations = 3;
+    std::string scheme = "mixed";  // ecdsa | schnorr | mixed
+    size_t size = 33;              // sha256 message size
+};
+
+void print_usage() {
+    std::cout << "Usage: crypto_bench [--mode verify|sha256] [--count N] [--iterations N]\n"
+              << "                    [--scheme ecdsa|schnorr|mixed] [--size BYTES]\n";
+}
+
+bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--mode") {
+            if (value != "verify" && value != "sha256") {
+                return false;
+            }
+            options.mode = value;
+        } else if (arg == "--count") {
+            options.count = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--iterations") {
+            options.iterations = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--scheme") {
+            if (value != "ecdsa" && value != "schnorr" && value != "mixed") {
+                return false;
+            }
+            options.scheme = value;
+        } else if (arg == "--size") {
+            options.size = std::strtoul(value.c_str(), nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return options.count > 0;
+}
+
+std::vector<VerifyItem> make_items(const Options& options) {
+    std::mt19937_64 rng(42);
+    std::vector<VerifyItem> items(options.count);
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        VerifyItem& item = items[i];
+        auto keypair = Crypto::generate_keypair();
+        for (auto& byte : item.hash) {
+            byte = static_cast<uint8_t>(rng());
+        }
+
+        bool schnorr = options.scheme == "schnorr" || (options.scheme == "mixed" && i % 2 == 1);
+        if (schnorr) {
+            item.scheme = SignatureScheme::SCHNORR;
+            item.signature = Crypto::schnorr_sign(item.hash, keypair.first);
+            auto xonly = Crypto::schnorr_public_key(keypair.first);
+            item.public_key.fill(0);
+            std::copy(xonly.begin(), xonly.end(), item.public_key.begin());
+        } else {
+            item.scheme = SignatureScheme::ECDSA;
+            item.signature = Crypto::sign_hash(item.hash, keypair.first);
+            std::copy(keypair.second.begin(), keypair.second.end(), item.public_key.begin());
+        }
+    }
+
+    // Corrupt a handful so both paths have failures to report
+    for (size_t i = 7; i < items.size(); i += 97) {
+        items[i].signature[40] ^= 0x01;
+    }
+    return items;
+}
+
+bool verify_one(const VerifyItem& item) {
+    if (item.scheme == SignatureScheme::SCHNORR) {
+        std::array<uint8_t, 32> xonly;
+        std::copy(item.public_key.begin(), item.public_key.begin() + 32, xonly.begin());
+        return Crypto::schnorr_verify(item.hash, item.signature, xonly);
+    }
+    std::vector<uint8_t> public_key(item.public_key.begin(), item.public_key.end());
+    return Crypto::verify_hash(item.hash, item.signature, public_key);
+}
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int run_sha256(const Options& options) {
+    std::mt19937_64 rng(42);
+    std::vector<uint8_t> buffer(options.count * options.size);
+    for (auto& byte : buffer) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    std::vector<const uint8_t*> data(options.count);
+    std::vector<size_t> sizes(options.count, options.size);
+    for (size_t i = 0; i < options.count; ++i) {
+        data[i] = buffer.data() + i * options.size;
+    }
+
+    std::vector<std::array<uint8_t, 32>> expected(options.count);
+    std::vector<std::array<uint8_t, 32>> digests(options.count);
+
+    double best_loop = 1e30;
+    for (int iteration = 0; iteration < options.iterations; ++iteration) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < options.count; ++i) {
+            expected[i] = Crypto::sha256(data[i], sizes[i]);
+        }
+        best_loop = std::min(best_loop, seconds_since(start));
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "sha256 loop:   " << (best_loop * 1e9 / options.count) << " ns/message\n";
+
+    const std::pair<Sha256Kernel, const char*> kernels[] = {
+        {Sha256Kernel::AUTO, "auto"}, {Sha256Kernel::SCALAR, "scalar"},
+        {Sha256Kernel::AVX2, "avx2"}, {Sha256Kernel::SHA_NI, "sha-ni"}};
+    int status = 0;
+    for (const auto& kernel : kernels) {
+        if (!Crypto::sha256_kernel_supported(kernel.first)) {
+            std::cout << "sha256_many " << kernel.second << ": not supported\n";
+            continue;
+        }
+
+        double best = 1e30;
+        for (int iteration = 0; iteration < options.iterations; ++iteration) {
+            auto start = Clock::now();
+            Crypto::sha256_many(data.data(), sizes.data(), options.count, digests.data(), kernel.first);
+            best = std::min(best, seconds_since(start));
+        }
+
+        bool match = digests == expected;
+        if (!match) {
+            status = 2;
+        }
+        std::cout << "sha256_many " << kernel.second << ": " << std::setprecision(1)
+                  << (best * 1e9 / options.count) << " ns/message, " << std::setprecision(2)
+                  << (best_loop / best) << "x" << (match ? "" : " (MISMATCH)") << "\n";
+    }
+    return status;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    if (options.mode == "sha256") {
+        return run_sha256(options);
+    }
+
+    std::cout << "Signing " << options.count << " " << options.scheme << " items..." << std::endl;
+    auto items = make_items(options);
+
+    double best_loop = 1e30;
+    double best_batch = 1e30;
+    std::vector<bool> expected(items.size());
+    BatchVerifyResult batch;
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < items.size(); ++i) {
+            expected[i] = verify_one(items[i]);
+        }
+        best_loop = std::min(best_loop, seconds_since(start));
+
+        start = Clock::now();
+        batch = Crypto::verify_batch(items);
+        best_batch = std::min(best_batch, seconds_since(start));
+    }
+
+    size_t mismatches = 0;
+    size_t invalid = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (batch.valid(i) != expected[i]) {
+            ++mismatches;
+        }
+        if (!expected[i]) {
+            ++invalid;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "one-by-one: " << (items.size() / best_loop) << " verifies/s ("
+              << (best_loop * 1e6 / items.size()) << " us each)\n";
+    std::cout << "batch:      " << (items.size() / best_batch) << " verifies/s ("
+              << (best_batch * 1e6 / items.size()) << " us each)\n";
+    std::cout << "speedup:    " << std::setprecision(2) << (best_loop / best_batch) << "x\n";
+    std::cout << "invalid:    " << invalid << ", mismatches: " << mismatches << std::endl;
+
+    return mismatches == 0 ? 0 : 2;
+}
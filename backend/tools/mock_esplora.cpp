@@ -0,0 +1,644 @@
+// mock_esplora - Esplora-compatible stand-in for offline network testing
+//
+// Serves the subset of the Esplora REST API the wallet uses, with synthetic
+// but self-consistent data: every address deterministically gets a history
+// derived from its name and --seed, so its stats, UTXOs and transaction
+// pages agree with each other and are the same on every run. Latency,
+// tail latency, error responses and connection resets can be injected to
+// exercise the client's batching, caching and failure handling.
+//
+// Point the wallet at it with `-n mock` or CRYPTO_WALLET_ESPLORA_URL.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+
+namespace {
+
+constexpr size_t PAGE_SIZE = 25;
+constexpr uint32_t TIP_HEIGHT = 900000;
+constexpr uint32_t FIRST_HEIGHT = 700000;
+constexpr size_t MODEL_CACHE_LIMIT = 100000;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 3002;
+    uint64_t seed = 1;
+    uint32_t txs = 20;          // Mean confirmed transactions per used address
+    // Addresses that were never used. High enough that gap-limit discovery
+    // meets 20 in a row within a few hundred addresses.
+    double empty_rate = 0.9;
+    double mempool_rate = 0.1;  // Addresses with an unconfirmed receive
+    double latency_ms = 0.0;
+    double jitter_ms = 0.0;
+    double tail_rate = 0.0;
+    double tail_ms = 0.0;
+    double error_rate = 0.0;    // Answered with 503
+    double reset_rate = 0.0;    // Connection closed without an answer
+};
+
+// SplitMix64: small, fast and the same everywhere, unlike std::hash
+struct SplitMix {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() { return static_cast<double>(next() >> 11) / 9007199254740992.0; }
+    uint64_t between(uint64_t low, uint64_t high) { return low + next() % (high - low + 1); }
+};
+
+uint64_t fnv1a(const std::string& text) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string hex64(SplitMix& rng) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(64, '0');
+    for (size_t i = 0; i < 64; i += 16) {
+        uint64_t word = rng.next();
+        for (size_t j = 0; j < 16; ++j) {
+            out[i + j] = digits[(word >> (4 * j)) & 0xf];
+        }
+    }
+    return out;
+}
+
+struct MockInput {
+    std::string txid;
+    uint32_t vout;
+    std::string address;
+    uint64_t value;
+};
+
+struct MockOutput {
+    std::string address;
+    uint64_t value;
+};
+
+struct MockTx {
+    std::string txid;
+    uint32_t height;  // 0 in the mempool
+    std::string block_hash;
+    std::vector<MockInput> inputs;
+    std::vector<MockOutput> outputs;
+    uint64_t fee;
+};
+
+struct MockUtxo {
+    std::string txid;
+    uint32_t vout;
+    uint64_t value;
+    uint32_t height;
+};
+
+struct SideStats {
+    uint64_t funded_count = 0;
+    uint64_t funded_sum = 0;
+    uint64_t spent_count = 0;
+    uint64_t spent_sum = 0;
+    uint64_t tx_count = 0;
+};
+
+// Everything served for one address
+struct AddressModel {
+    std::vector<MockTx> confirmed;  // Newest first
+    std::vector<MockTx> mempool;
+    std::vector<MockUtxo> utxos;
+    SideStats chain;
+    SideStats pending;
+};
+
+void account(const std::string& address, const MockTx& tx, SideStats& stats) {
+    ++stats.tx_count;
+    for (const auto& input : tx.inputs) {
+        if (input.address == address) {
+            ++stats.spent_count;
+            stats.spent_sum += input.value;
+        }
+    }
+    for (const auto& output : tx.outputs) {
+        if (output.address == address) {
+            ++stats.funded_count;
+            stats.funded_sum += output.value;
+        }
+    }
+}
+
+std::shared_ptr<const AddressModel> build_model(const std::string& address, const Options& options) {
+    auto model = std::make_shared<AddressModel>();
+    SplitMix rng{fnv1a(address) ^ (options.seed * 0x9e3779b97f4a7c15ULL)};
+    std::string external = "bc1qmockexternal" + std::to_string(rng.next() % 100000);
+
+    size_t count = 0;
+    if (rng.uniform() >= options.empty_rate) {
+        count = static_cast<size_t>(rng.between(1, std::max<uint64_t>(1, 2ULL * options.txs - 1)));
+    }
+
+    struct Unspent {
+        std::string txid;
+        uint32_t vout;
+        uint64_t value;
+        uint32_t height;
+    };
+    std::vector<Unspent> unspent;
+    uint32_t height = FIRST_HEIGHT + static_cast<uint32_t>(rng.between(0, 1000));
+    uint32_t step = std::max<uint32_t>(1, (TIP_HEIGHT - height) / static_cast<uint32_t>(count + 1));
+
+    // Oldest first, so spends only touch outputs that already exist
+    std::vector<MockTx> history;
+    for (size_t k = 0; k < count; ++k) {
+        height += static_cast<uint32_t>(rng.between(1, step));
+        MockTx tx;
+        tx.txid = hex64(rng);
+        tx.height = height;
+        tx.block_hash = hex64(rng);
+        tx.fee = rng.between(200, 5000);
+
+        if (!unspent.empty() && rng.uniform() < 0.35) {
+            size_t pick = rng.next() % unspent.size();
+            Unspent spent = unspent[pick];
+            unspent.erase(unspent.begin() + static_cast<std::ptrdiff_t>(pick));
+            tx.inputs.push_back(MockInput{spent.txid, spent.vout, address, spent.value});
+            uint64_t available = spent.value > tx.fee ? spent.value - tx.fee : 0;
+            uint64_t sent = available * rng.between(10, 90) / 100;
+            tx.outputs.push_back(MockOutput{external, sent});
+            if (available - sent > 546) {
+                tx.outputs.push_back(MockOutput{address, available - sent});
+                unspent.push_back(Unspent{tx.txid, 1, available - sent, height});
+            }
+        } else {
+            uint64_t value = rng.between(10000, 5000000);
+            tx.inputs.push_back(MockInput{hex64(rng), 0, external, value + tx.fee + 10000});
+            tx.outputs.push_back(MockOutput{address, value});
+            tx.outputs.push_back(MockOutput{external, 10000});
+            unspent.push_back(Unspent{tx.txid, 0, value, height});
+        }
+        account(address, tx, model->chain);
+        history.push_back(std::move(tx));
+    }
+    model->confirmed.assign(history.rbegin(), history.rend());
+
+    if (count > 0 && rng.uniform() < options.mempool_rate) {
+        MockTx tx;
+        tx.txid = hex64(rng);
+        tx.height = 0;
+        tx.fee = rng.between(200, 5000);
+        uint64_t value = rng.between(10000, 1000000);
+        tx.inputs.push_back(MockInput{hex64(rng), 0, external, value + tx.fee});
+        tx.outputs.push_back(MockOutput{address, value});
+        account(address, tx, model->pending);
+        unspent.push_back(Unspent{tx.txid, 0, value, 0});
+        model->mempool.push_back(std::move(tx));
+    }
+
+    for (const auto& output : unspent) {
+        model->utxos.push_back(MockUtxo{output.txid, output.vout, output.value, output.height});
+    }
+    return model;
+}
+
+class ModelCache {
+public:
+    explicit ModelCache(const Options& options) : options_(options) {}
+
+    std::shared_ptr<const AddressModel> get(const std::string& address) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = models_.find(address);
+            if (it != models_.end()) {
+                return it->second;
+            }
+        }
+        auto model = build_model(address, options_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Models are cheap to rebuild; just keep memory bounded
+        if (models_.size() >= MODEL_CACHE_LIMIT) {
+            models_.clear();
+        }
+        models_.emplace(address, model);
+        return model;
+    }
+
+private:
+    const Options& options_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const AddressModel>> models_;
+};
+
+uint32_t block_time(uint32_t height) {
+    return 1231006505 + height * 600;
+}
+
+void write_status(std::ostringstream& out, uint32_t height, const std::string& block_hash) {
+    if (height == 0) {
+        out << "{\"confirmed\":false}";
+        return;
+    }
+    out << "{\"confirmed\":true,\"block_height\":" << height << ",\"block_hash\":\"" << block_hash
+        << "\",\"block_time\":" << block_time(height) << "}";
+}
+
+void write_script(std::ostringstream& out, const std::string& address, uint64_t value) {
+    // A P2WPKH script derived from the address so it stays stable
+    uint64_t hash = fnv1a(address);
+    char program[41];
+    for (int i = 0; i < 40; ++i) {
+        program[i] = "0123456789abcdef"[(hash >> ((i % 16) * 4)) & 0xf];
+    }
+    program[40] = '\0';
+    out << "{\"scriptpubkey\":\"0014" << program << "\",\"scriptpubkey_asm\":\"OP_0 OP_PUSHBYTES_20 " << program
+        << "\",\"scriptpubkey_type\":\"v0_p2wpkh\",\"scriptpubkey_address\":\"" << address
+        << "\",\"value\":" << value << "}";
+}
+
+void write_tx(std::ostringstream& out, const MockTx& tx) {
+    static const std::string signature(144, 'a');
+    static const std::string pubkey = "02" + std::string(64, 'b');
+
+    out << "{\"txid\":\"" << tx.txid << "\",\"version\":2,\"locktime\":0,\"vin\":[";
+    for (size_t i = 0; i < tx.inputs.size(); ++i) {
+        const auto& input = tx.inputs[i];
+        out << (i ? "," : "") << "{\"txid\":\"" << input.txid << "\",\"vout\":" << input.vout << ",\"prevout\":";
+        write_script(out, input.address, input.value);
+        out << ",\"scriptsig\":\"\",\"scriptsig_asm\":\"\",\"witness\":[\"" << signature << "\",\"" << pubkey
+            << "\"],\"is_coinbase\":false,\"sequence\":4294967293}";
+    }
+    out << "],\"vout\":[";
+    for (size_t i = 0; i < tx.outputs.size(); ++i) {
+        out << (i ? "," : "");
+        write_script(out, tx.outputs[i].address, tx.outputs[i].value);
+    }
+    size_t vsize = 11 + 68 * tx.inputs.size() + 31 * tx.outputs.size();
+    out << "],\"size\":" << vsize + 2 + 108 * tx.inputs.size() / 4 << ",\"weight\":" << vsize * 4
+        << ",\"fee\":" << tx.fee << ",\"status\":";
+    write_status(out, tx.height, tx.block_hash);
+    out << "}";
+}
+
+void write_side(std::ostringstream& out, const SideStats& stats) {
+    out << "{\"funded_txo_count\":" << stats.funded_count << ",\"funded_txo_sum\":" << stats.funded_sum
+        << ",\"spent_txo_count\":" << stats.spent_count << ",\"spent_txo_sum\":" << stats.spent_sum
+        << ",\"tx_count\":" << stats.tx_count << "}";
+}
+
+struct Response {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string body;
+};
+
+Response text(int status, const std::string& body) {
+    return Response{status, "text/plain", body};
+}
+
+// txid of a raw transaction: double SHA-256, byte-reversed
+bool txid_of(const std::string& hex, std::string& txid) {
+    if (hex.empty() || hex.size() % 2 != 0) {
+        return false;
+    }
+    std::vector<unsigned char> raw(hex.size() / 2);
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char pair[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        char* end = nullptr;
+        raw[i] = static_cast<unsigned char>(std::strtoul(pair, &end, 16));
+        if (end != pair + 2) {
+            return false;
+        }
+    }
+
+    unsigned char first[EVP_MAX_MD_SIZE];
+    unsigned char second[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    EVP_Digest(raw.data(), raw.size(), first, &size, EVP_sha256(), nullptr);
+    EVP_Digest(first, size, second, &size, EVP_sha256(), nullptr);
+
+    static const char digits[] = "0123456789abcdef";
+    txid.clear();
+    for (unsigned int i = size; i-- > 0;) {
+        txid += digits[second[i] >> 4];
+        txid += digits[second[i] & 0xf];
+    }
+    return true;
+}
+
+Response route(const std::string& method, const std::string& path, const std::string& body, ModelCache& models) {
+    if (method == "GET" && path == "/blocks/tip/height") {
+        return text(200, std::to_string(TIP_HEIGHT));
+    }
+    if (method == "GET" && path == "/fee-estimates") {
+        return Response{200, "application/json",
+                        "{\"1\":25.0,\"2\":20.0,\"3\":15.0,\"6\":10.0,\"12\":6.0,\"25\":3.0,"
+                        "\"144\":1.5,\"504\":1.0,\"1008\":1.0}"};
+    }
+    if (method == "POST" && path == "/tx") {
+        std::string hex = body;
+        hex.erase(std::remove_if(hex.begin(), hex.end(), ::isspace), hex.end());
+        std::string txid;
+        if (!txid_of(hex, txid)) {
+            return text(400, "sendrawtransaction RPC error: {\"code\":-22,\"message\":\"TX decode failed\"}");
+        }
+        return text(200, txid);
+    }
+    if (method != "GET" || path.compare(0, 9, "/address/") != 0) {
+        return text(404, "Not Found");
+    }
+
+    // /address/<addr>[/utxo | /txs | /txs/chain[/<last_txid>]]
+    std::string rest = path.substr(9);
+    size_t slash = rest.find('/');
+    std::string address = rest.substr(0, slash);
+    std::string tail = slash == std::string::npos ? "" : rest.substr(slash);
+    if (address.empty()) {
+        return text(400, "Invalid Bitcoin address");
+    }
+    auto model = models.get(address);
+    std::ostringstream out;
+
+    if (tail.empty()) {
+        out << "{\"address\":\"" << address << "\",\"chain_stats\":";
+        write_side(out, model->chain);
+        out << ",\"mempool_stats\":";
+        write_side(out, model->pending);
+        out << "}";
+    } else if (tail == "/utxo") {
+        out << "[";
+        for (size_t i = 0; i < model->utxos.size(); ++i) {
+            const auto& utxo = model->utxos[i];
+            out << (i ? "," : "") << "{\"txid\":\"" << utxo.txid << "\",\"vout\":" << utxo.vout << ",\"status\":";
+            write_status(out, utxo.height, std::string(64, '0'));
+            out << ",\"value\":" << utxo.value << "}";
+        }
+        out << "]";
+    } else if (tail == "/txs" || tail == "/txs/chain" || tail.compare(0, 11, "/txs/chain/") == 0) {
+        size_t start = 0;
+        bool first_page = tail == "/txs";
+        if (tail.size() > 11) {
+            std::string last = tail.substr(11);
+            auto it = std::find_if(model->confirmed.begin(), model->confirmed.end(),
+                [&last](const MockTx& tx) { return tx.txid == last; });
+            if (it == model->confirmed.end()) {
+                return text(400, "Transaction not found");
+            }
+            start = static_cast<size_t>(it - model->confirmed.begin()) + 1;
+        }
+
+        out << "[";
+        bool any = false;
+        if (first_page) {
+            for (const auto& tx : model->mempool) {
+                out << (any ? "," : "");
+                write_tx(out, tx);
+                any = true;
+            }
+        }
+        size_t end = std::min(model->confirmed.size(), start + PAGE_SIZE);
+        for (size_t i = start; i < end; ++i) {
+            out << (any ? "," : "");
+            write_tx(out, model->confirmed[i]);
+            any = true;
+        }
+        out << "]";
+    } else {
+        return text(404, "Not Found");
+    }
+    return Response{200, "application/json", out.str()};
+}
+
+const char* reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+bool send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void serve_connection(int fd, uint64_t connection, const Options& options, ModelCache& models) {
+    std::mt19937_64 rng(options.seed ^ (connection * 0x9e3779b97f4a7c15ULL));
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::string buffer;
+    char chunk[16384];
+
+    while (true) {
+        size_t header_end;
+        while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                close(fd);
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+
+        std::istringstream request_line(buffer.substr(0, buffer.find("\r\n")));
+        std::string method, target, version;
+        request_line >> method >> target >> version;
+
+        std::string headers = buffer.substr(0, header_end);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        size_t length = 0;
+        size_t length_pos = headers.find("content-length:");
+        if (length_pos != std::string::npos) {
+            length = std::strtoul(headers.c_str() + length_pos + 15, nullptr, 10);
+        }
+        bool close_after = version != "HTTP/1.1" || headers.find("connection: close") != std::string::npos;
+
+        size_t body_start = header_end + 4;
+        while (buffer.size() < body_start + length) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                close(fd);
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+        std::string body = buffer.substr(body_start, length);
+        buffer.erase(0, body_start + length);
+
+        double delay = options.latency_ms;
+        if (options.jitter_ms > 0) {
+            delay += (chance(rng) * 2.0 - 1.0) * options.jitter_ms;
+        }
+        if (options.tail_rate > 0 && chance(rng) < options.tail_rate) {
+            delay += options.tail_ms;
+        }
+        if (delay > 0) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay));
+        }
+
+        if (options.reset_rate > 0 && chance(rng) < options.reset_rate) {
+            close(fd);
+            return;
+        }
+
+        Response response;
+        if (options.error_rate > 0 && chance(rng) < options.error_rate) {
+            response = text(503, "Service Unavailable");
+        } else {
+            response = route(method, target.substr(0, target.find('?')), body, models);
+        }
+
+        std::ostringstream out;
+        out << "HTTP/1.1 " << response.status << " " << reason(response.status) << "\r\n";
+        out << "Content-Type: " << response.content_type << "\r\n";
+        out << "Content-Length: " << response.body.size() << "\r\n";
+        if (close_after) {
+            out << "Connection: close\r\n";
+        }
+        out << "\r\n" << response.body;
+        if (!send_all(fd, out.str()) || close_after) {
+            close(fd);
+            return;
+        }
+    }
+}
+
+void print_usage() {
+    std::cout << "Usage: mock_esplora [options]\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --host <host>          Address to listen on (default 127.0.0.1)\n";
+    std::cout << "  --port <port>          Port to listen on (default 3002)\n";
+    std::cout << "  --seed <n>             Seed for the synthetic chain (default 1)\n";
+    std::cout << "  --txs <n>              Mean confirmed transactions per used address (default 20)\n";
+    std::cout << "  --empty-rate <p>       Fraction of addresses never used (default 0.9)\n";
+    std::cout << "  --mempool-rate <p>     Fraction of used addresses with a mempool receive (default 0.1)\n";
+    std::cout << "  --latency-ms <ms>      Added to every response (default 0)\n";
+    std::cout << "  --jitter-ms <ms>       Uniform +/- variation on the latency (default 0)\n";
+    std::cout << "  --tail-rate <p>        Fraction of responses delayed a further --tail-ms (default 0)\n";
+    std::cout << "  --tail-ms <ms>         Extra delay for tail responses (default 0)\n";
+    std::cout << "  --error-rate <p>       Fraction of requests answered with 503 (default 0)\n";
+    std::cout << "  --reset-rate <p>       Fraction of requests whose connection is dropped (default 0)\n";
+}
+
+bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "-h" || flag == "--help") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (flag == "--host") {
+            options.host = value;
+        } else if (flag == "--port") {
+            options.port = std::stoi(value);
+        } else if (flag == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (flag == "--txs") {
+            options.txs = static_cast<uint32_t>(std::stoul(value));
+        } else if (flag == "--empty-rate") {
+            options.empty_rate = std::stod(value);
+        } else if (flag == "--mempool-rate") {
+            options.mempool_rate = std::stod(value);
+        } else if (flag == "--latency-ms") {
+            options.latency_ms = std::stod(value);
+        } else if (flag == "--jitter-ms") {
+            options.jitter_ms = std::stod(value);
+        } else if (flag == "--tail-rate") {
+            options.tail_rate = std::stod(value);
+        } else if (flag == "--tail-ms") {
+            options.tail_ms = std::stod(value);
+        } else if (flag == "--error-rate") {
+            options.error_rate = std::stod(value);
+        } else if (flag == "--reset-rate") {
+            options.reset_rate = std::stod(value);
+        } else {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            return false;
+        }
+    }
+
+    if (options.txs == 0) {
+        std::cerr << "--txs must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        std::cerr << "Socket creation failed" << std::endl;
+        return 1;
+    }
+    int one = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Invalid listen address: " << options.host << std::endl;
+        return 1;
+    }
+    if (bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(server_fd, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on " << options.host << ":" << options.port << std::endl;
+        return 1;
+    }
+
+    std::cout << "🧪 Mock Esplora on http://" << options.host << ":" << options.port << " (seed " << options.seed
+              << ", " << options.txs << " txs/address, " << options.latency_ms << "ms latency, "
+              << options.error_rate * 100.0 << "% errors)" << std::endl;
+
+    ModelCache models(options);
+    for (uint64_t connection = 0;; ++connection) {
+        int fd = accept(server_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(serve_connection, fd, connection, std::cref(options), std::ref(models)).detach();
+    }
+}
@@ -0,0 +1,547 @@
+// wallet_loadgen - HTTP load generator for `crypto_wallet server`
+//
+// Drives a configurable endpoint mix over persistent keep-alive connections
+// and reports latency percentiles and error rates. Orders the risk engine
+// rejects come back as 200 with "status":"rejected"; they are counted and
+// timed apart from accepted responses. In open-loop mode every
+// request has an intended start time on a fixed schedule and latency is
+// measured from that time, so a stalled server is charged for the requests
+// that queued up behind the stall (coordinated-omission correction).
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Endpoint { LOGIN, ORDER, ORDER_BOOK, BALANCE, ENDPOINT_COUNT };
+
+const char* ENDPOINT_NAMES[ENDPOINT_COUNT] = {"login", "order", "orderbook", "balance"};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    double rps = 1000.0;
+    double duration = 10.0;
+    double warmup = 1.0;
+    int connections = 16;
+    bool open_loop = true;
+    std::string wallet = "loadgen";
+    double weights[ENDPOINT_COUNT] = {1.0, 4.0, 4.0, 1.0};
+};
+
+// Log-linear latency histogram in microseconds, ~0.1% relative precision
+class Histogram {
+public:
+    static constexpr uint64_t LINEAR_LIMIT = 2048;
+    static constexpr size_t BUCKETS = LINEAR_LIMIT + 40 * 1024;
+
+    Histogram() : counts_(BUCKETS, 0) {}
+
+    void record(uint64_t micros) {
+        ++counts_[bucket_of(micros)];
+        ++total_;
+        max_ = std::max(max_, micros);
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t percentile(double p) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total_));
+        target = std::max<uint64_t>(1, std::min(target, total_));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return std::min(value_of(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t total() const { return total_; }
+    uint64_t max() const { return max_; }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+
+    static size_t bucket_of(uint64_t v) {
+        if (v < LINEAR_LIMIT) {
+            return static_cast<size_t>(v);
+        }
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - 10;
+        size_t index = LINEAR_LIMIT + static_cast<size_t>(shift - 1) * 1024 + ((v >> shift) - 1024);
+        return std::min(index, BUCKETS - 1);
+    }
+
+    static uint64_t value_of(size_t index) {
+        if (index < LINEAR_LIMIT) {
+            return index;
+        }
+        size_t shift = (index - LINEAR_LIMIT) / 1024 + 1;
+        uint64_t mantissa = (index - LINEAR_LIMIT) % 1024 + 1024;
+        // Upper edge of the bucket so percentiles never under-report
+        return ((mantissa + 1) << shift) - 1;
+    }
+};
+
+struct WorkerStats {
+    Histogram endpoint_latency[ENDPOINT_COUNT];
+    uint64_t requests[ENDPOINT_COUNT] = {};
+    uint64_t errors[ENDPOINT_COUNT] = {};
+    uint64_t rejections[ENDPOINT_COUNT] = {};  // Also in requests, not in endpoint_latency
+    Histogram rejected_latency;
+    uint64_t reconnects = 0;
+};
+
+class Connection {
+public:
+    Connection(const sockaddr_in& addr) : addr_(addr) {}
+    ~Connection() { disconnect(); }
+
+    bool connected() const { return fd_ >= 0; }
+
+    bool connect_to() {
+        disconnect();
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) {
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd_, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_)) < 0) {
+            disconnect();
+            return false;
+        }
+        buffer_.clear();
+        return true;
+    }
+
+    void disconnect() {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    // Sends one request and reads the full response into body; returns the
+    // HTTP status or -1 on a transport error
+    int round_trip(const std::string& request, std::string& body) {
+        size_t sent = 0;
+        while (sent < request.size()) {
+            ssize_t n = send(fd_, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                disconnect();
+                return -1;
+            }
+            sent += static_cast<size_t>(n);
+        }
+
+        size_t header_end;
+        while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                disconnect();
+                return -1;
+            }
+        }
+
+        int status = 0;
+        if (buffer_.compare(0, 9, "HTTP/1.1 ") == 0 || buffer_.compare(0, 9, "HTTP/1.0 ") == 0) {
+            status = std::atoi(buffer_.c_str() + 9);
+        }
+
+        std::string headers = buffer_.substr(0, header_end);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        bool close_after = headers.find("connection: close") != std::string::npos;
+        size_t body_start = header_end + 4;
+
+        size_t length_pos = headers.find("content-length:");
+        if (length_pos == std::string::npos) {
+            // Unframed body: the server ends it by closing the connection
+            while (fill()) {
+            }
+            body = buffer_.substr(body_start);
+            disconnect();
+            return status;
+        }
+
+        size_t length = std::strtoul(headers.c_str() + length_pos + 15, nullptr, 10);
+        while (buffer_.size() < body_start + length) {
+            if (!fill()) {
+                disconnect();
+                return -1;
+            }
+        }
+        body = buffer_.substr(body_start, length);
+        buffer_.erase(0, body_start + length);
+
+        if (close_after) {
+            disconnect();
+        }
+        return status;
+    }
+
+private:
+    sockaddr_in addr_;
+    int fd_ = -1;
+    std::string buffer_;
+
+    bool fill() {
+        char chunk[16384];
+        ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+};
+
+std::string build_request(Endpoint endpoint, const Options& options, int worker, uint64_t sequence) {
+    std::string host = options.host + ":" + std::to_string(options.port);
+    std::string wallet = options.wallet + "-" + std::to_string(worker);
+    std::string method = "GET";
+    std::string path;
+    std::string body;
+
+    switch (endpoint) {
+        case LOGIN:
+            method = "POST";
+            path = "/auth/login";
+            body = "{\"email\":\"" + wallet + "@loadgen.local\",\"password\":\"password\"}";
+            break;
+        case ORDER:
+            // Alternate sides so the simulated balances stay roughly flat
+            method = "POST";
+            path = "/trading/orders";
+            body = "{\"wallet_name\":\"" + wallet + "\",\"pair\":\"BTC/USDT\",\"type\":\"market\",\"side\":\"" +
+                   std::string(sequence % 2 == 0 ? "buy" : "sell") + "\",\"amount\":0.001}";
+            break;
+        case ORDER_BOOK:
+            path = "/trading/orderbook/BTC/USDT";
+            break;
+        case BALANCE:
+            path = "/balance/" + options.wallet;
+            break;
+        default:
+            break;
+    }
+
+    std::ostringstream request;
+    request << method << " " << path << " HTTP/1.1\r\n";
+    request << "Host: " << host << "\r\n";
+    request << "Connection: keep-alive\r\n";
+    if (!body.empty()) {
+        request << "Content-Type: application/json\r\n";
+        request << "Content-Length: " << body.size() << "\r\n";
+    }
+    request << "\r\n" << body;
+    return request.str();
+}
+
+void run_worker(int worker, const Options& options, const sockaddr_in& addr,
+                Clock::time_point start, Clock::time_point measure_from,
+                Clock::time_point end, WorkerStats& stats) {
+    Connection connection(addr);
+    std::mt19937_64 rng(0x9e3779b97f4a7c15ULL ^ static_cast<uint64_t>(worker));
+    std::discrete_distribution<int> pick(options.weights, options.weights + ENDPOINT_COUNT);
+
+    // Each connection carries an equal share of the target rate, offset so
+    // connections do not fire in lockstep
+    auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.connections / options.rps));
+    auto intended = start + interval * worker / options.connections;
+
+    for (uint64_t sequence = 0;; ++sequence) {
+        auto now = Clock::now();
+        if (options.open_loop) {
+            if (intended >= end) {
+                break;
+            }
+            if (intended > now) {
+                std::this_thread::sleep_until(intended);
+            }
+        } else if (now >= end) {
+            break;
+        }
+
+        Endpoint endpoint = static_cast<Endpoint>(pick(rng));
+        std::string request = build_request(endpoint, options, worker, sequence);
+
+        auto sent_at = Clock::now();
+        auto latency_from = options.open_loop ? intended : sent_at;
+
+        int status = -1;
+        std::string body;
+        for (int attempt = 0; attempt < 2 && status < 0; ++attempt) {
+            if (!connection.connected()) {
+                if (sequence > 0 || attempt > 0) {
+                    ++stats.reconnects;
+                }
+                if (!connection.connect_to()) {
+                    continue;
+                }
+            }
+            status = connection.round_trip(request, body);
+        }
+
+        auto done = Clock::now();
+        if (latency_from >= measure_from) {
+            uint64_t micros = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(done - latency_from).count());
+            ++stats.requests[endpoint];
+            bool ok = status >= 200 && status < 300;
+            if (ok && body.find("\"status\":\"rejected\"") != std::string::npos) {
+                stats.rejected_latency.record(micros);
+                ++stats.rejections[endpoint];
+            } else {
+                stats.endpoint_latency[endpoint].record(micros);
+                if (!ok) {
+                    ++stats.errors[endpoint];
+                }
+            }
+        }
+
+        intended += interval;
+    }
+}
+
+bool parse_mix(const std::string& mix, double* weights) {
+    std::fill(weights, weights + ENDPOINT_COUNT, 0.0);
+    std::istringstream stream(mix);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        auto eq = item.find('=');
+        if (eq == std::string::npos) {
+            return false;
+        }
+        std::string name = item.substr(0, eq);
+        double weight = std::stod(item.substr(eq + 1));
+        auto it = std::find_if(ENDPOINT_NAMES, ENDPOINT_NAMES + ENDPOINT_COUNT,
+            [&name](const char* endpoint) { return name == endpoint; });
+        if (it == ENDPOINT_NAMES + ENDPOINT_COUNT || weight < 0) {
+            return false;
+        }
+        weights[it - ENDPOINT_NAMES] = weight;
+    }
+    return std::any_of(weights, weights + ENDPOINT_COUNT, [](double w) { return w > 0; });
+}
+
+void print_usage() {
+    std::cout << "Usage: wallet_loadgen [options]\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --host <host>          Server host (default 127.0.0.1)\n";
+    std::cout << "  --port <port>          Server port (default 8080)\n";
+    std::cout << "  --rps <n>              Target requests per second (default 1000)\n";
+    std::cout << "  --duration <s>         Measured run time in seconds (default 10)\n";
+    std::cout << "  --warmup <s>           Unmeasured warmup in seconds (default 1)\n";
+    std::cout << "  --connections <n>      Keep-alive connections, one thread each (default 16)\n";
+    std::cout << "  --mode <open|closed>   Open-loop fixed schedule or closed-loop (default open)\n";
+    std::cout << "  --mix <name=w,...>     Endpoint weights for login, order, orderbook, balance\n";
+    std::cout << "                         (default login=1,order=4,orderbook=4,balance=1)\n";
+    std::cout << "  --wallet <name>        Wallet used for balance and order requests (default loadgen)\n";
+}
+
+bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "-h" || flag == "--help") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (flag == "--host") {
+            options.host = value;
+        } else if (flag == "--port") {
+            options.port = std::stoi(value);
+        } else if (flag == "--rps") {
+            options.rps = std::stod(value);
+        } else if (flag == "--duration") {
+            options.duration = std::stod(value);
+        } else if (flag == "--warmup") {
+            options.warmup = std::stod(value);
+        } else if (flag == "--connections") {
+            options.connections = std::stoi(value);
+        } else if (flag == "--mode") {
+            if (value != "open" && value != "closed") {
+                std::cerr << "Unknown mode: " << value << std::endl;
+                return false;
+            }
+            options.open_loop = value == "open";
+        } else if (flag == "--mix") {
+            if (!parse_mix(value, options.weights)) {
+                std::cerr << "Invalid endpoint mix: " << value << std::endl;
+                return false;
+            }
+        } else if (flag == "--wallet") {
+            options.wallet = value;
+        } else {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            return false;
+        }
+    }
+
+    if (options.rps <= 0 || options.connections <= 0 || options.duration <= 0) {
+        std::cerr << "--rps, --connections and --duration must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void print_latency_row(const std::string& label, const Histogram& h) {
+    auto ms = [](uint64_t micros) { return static_cast<double>(micros) / 1000.0; };
+    std::cout << std::left << std::setw(12) << label << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << ms(h.percentile(50))
+              << std::setw(10) << ms(h.percentile(90))
+              << std::setw(10) << ms(h.percentile(99))
+              << std::setw(10) << ms(h.percentile(99.9))
+              << std::setw(10) << ms(h.percentile(99.99))
+              << std::setw(10) << ms(h.max()) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* resolved = nullptr;
+    if (getaddrinfo(options.host.c_str(), nullptr, &hints, &resolved) != 0 || !resolved) {
+        std::cerr << "Failed to resolve host: " << options.host << std::endl;
+        return 1;
+    }
+    sockaddr_in addr = *reinterpret_cast<sockaddr_in*>(resolved->ai_addr);
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    freeaddrinfo(resolved);
+
+    std::cout << "🔥 " << (options.open_loop ? "Open-loop" : "Closed-loop") << " load against "
+              << options.host << ":" << options.port << " with " << options.connections
+              << " connections";
+    if (options.open_loop) {
+        std::cout << " at " << options.rps << " req/s";
+    }
+    std::cout << " for " << options.duration << "s (+" << options.warmup << "s warmup)" << std::endl;
+
+    auto start = Clock::now() + std::chrono::milliseconds(100);
+    auto measure_from = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.warmup));
+    auto end = measure_from + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.duration));
+
+    std::vector<WorkerStats> stats(options.connections);
+    std::vector<std::thread> workers;
+    workers.reserve(options.connections);
+    for (int i = 0; i < options.connections; ++i) {
+        workers.emplace_back(run_worker, i, std::cref(options), std::cref(addr),
+                             start, measure_from, end, std::ref(stats[i]));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - measure_from).count();
+
+    WorkerStats total;
+    Histogram all_latency;
+    for (const auto& s : stats) {
+        for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+            total.endpoint_latency[e].merge(s.endpoint_latency[e]);
+            total.requests[e] += s.requests[e];
+            total.errors[e] += s.errors[e];
+            total.rejections[e] += s.rejections[e];
+        }
+        total.rejected_latency.merge(s.rejected_latency);
+        total.reconnects += s.reconnects;
+    }
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        all_latency.merge(total.endpoint_latency[e]);
+    }
+
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t rejections = 0;
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        requests += total.requests[e];
+        errors += total.errors[e];
+        rejections += total.rejections[e];
+    }
+    uint64_t accepted = requests - errors - rejections;
+    auto percent = [requests](uint64_t count) {
+        return requests ? 100.0 * static_cast<double>(count) / static_cast<double>(requests) : 0.0;
+    };
+
+    std::cout << "\nRequests:   " << requests << " (" << std::fixed << std::setprecision(1)
+              << static_cast<double>(requests) / elapsed << " req/s achieved)\n";
+    std::cout << "Accepted:   " << accepted << " (" << static_cast<double>(accepted) / elapsed
+              << " req/s)\n";
+    std::cout << "Rejected:   " << rejections << " (" << std::setprecision(2) << percent(rejections)
+              << "%, by the risk engine)\n";
+    std::cout << "Errors:     " << errors << " (" << percent(errors) << "%)\n";
+    std::cout << "Reconnects: " << total.reconnects << "\n\n";
+
+    // Rejections are answered before any work is done, so they get their
+    // own row rather than flattering the accepted latencies
+    std::cout << "Latency (ms)     p50       p90       p99     p99.9    p99.99       max\n";
+    print_latency_row("all", all_latency);
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        if (total.endpoint_latency[e].total() > 0) {
+            print_latency_row(ENDPOINT_NAMES[e], total.endpoint_latency[e]);
+        }
+    }
+    if (rejections > 0) {
+        print_latency_row("rejected", total.rejected_latency);
+    }
+
+    std::cout << "\nEndpoint      requests  rejected    errors  error %\n";
+    for (int e = 0; e < ENDPOINT_COUNT; ++e) {
+        if (total.requests[e] == 0) {
+            continue;
+        }
+        std::cout << std::left << std::setw(12) << ENDPOINT_NAMES[e] << std::right
+                  << std::setw(10) << total.requests[e]
+                  << std::setw(10) << total.rejections[e]
+                  << std::setw(10) << total.errors[e]
+                  << std::setw(9) << std::setprecision(2)
+                  << 100.0 * static_cast<double>(total.errors[e]) / static_cast<double>(total.requests[e])
+                  << "\n";
+    }
+
+    return 0;
+}